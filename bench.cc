@@ -0,0 +1,307 @@
+// micro benchmark of the codec and index without v8
+//
+//   build/default/bypass_bench [ops] [shapes] [profile]
+//
+// encodes synthetic documents through the same ValueSource interface the
+// addon uses and reports ns/op and heap allocations/op for each phase.
+// with profile the store's codec costs by type and phase are printed too
+
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "value.h"
+#include "store.h"
+#include "clock.h"
+
+using namespace boost;
+using namespace bypass;
+
+namespace {
+
+size_t g_allocs = 0;
+
+/// synthetic document tree
+struct Doc
+{
+    ValueSource::Type type;
+    double num;
+    std::string str;
+
+    // member names for objects, same length as items
+    std::vector<std::string> keys;
+    std::vector<Doc> items;
+};
+
+Doc number(double d)
+{
+    Doc out;
+    out.type = d == int32_t(d) ? ValueSource::INT32 : ValueSource::NUMBER;
+    out.num = d;
+    return out;
+}
+
+Doc string(const std::string& s)
+{
+    Doc out;
+    out.type = ValueSource::STRING;
+    out.num = 0;
+    out.str = s;
+    return out;
+}
+
+Doc container(ValueSource::Type type)
+{
+    Doc out;
+    out.type = type;
+    out.num = 0;
+    return out;
+}
+
+void member(Doc& obj, const std::string& key, const Doc& val)
+{
+    obj.keys.push_back(key);
+    obj.items.push_back(val);
+}
+
+/// a document shaped like the ones in test.js
+/// shape selects one of several member name sets
+Doc make_doc(int id, int shape, int depth)
+{
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "s%d_", shape);
+
+    Doc doc = container(ValueSource::OBJECT);
+    member(doc, "index", number(id));
+    member(doc, std::string(prefix) + "name", string("sadasdadsfadfasfasff"));
+    member(doc, "score", number(id * 0.25 + 0.1));
+
+    Doc arr = container(ValueSource::ARRAY);
+    for (int i=0 ; i<8 ; ++i)
+        arr.items.push_back(number(i * 123));
+    member(doc, "test", arr);
+
+    if (depth > 0)
+        member(doc, "inner", make_doc(id, shape, depth - 1));
+
+    return doc;
+}
+
+class DocSource : public ValueSource
+{
+    std::vector<const Doc*> m_stack;
+
+public:
+    DocSource(const Doc& doc)
+    {
+        m_stack.push_back(&doc);
+    }
+
+    virtual Type type() { return m_stack.back()->type; }
+    virtual double number() { return m_stack.back()->num; }
+    virtual size_t string_length() { return m_stack.back()->str.size(); }
+
+    virtual void string_write(char* out)
+    {
+        const std::string& s = m_stack.back()->str;
+        s.copy(out, s.size());
+    }
+
+    virtual uint32_t size() { return m_stack.back()->items.size(); }
+    virtual std::string key(uint32_t i) { return m_stack.back()->keys[i]; }
+
+    virtual void enter(uint32_t i)
+    {
+        m_stack.push_back(&m_stack.back()->items[i]);
+    }
+
+    virtual void enter(const RecordLayout& layout, uint32_t field)
+    {
+        static const Doc missing = container(UNDEFINED);
+
+        const Doc* d = m_stack.back();
+        const std::string& name = layout.fields()[field].name;
+        for (size_t i=0 ; i<d->keys.size() ; ++i)
+        {
+            if (d->keys[i] == name)
+            {
+                m_stack.push_back(&d->items[i]);
+                return;
+            }
+        }
+        m_stack.push_back(&missing);
+    }
+
+    virtual void leave()
+    {
+        m_stack.pop_back();
+    }
+};
+
+/// touches everything it is given so decoding cannot be skipped
+class CountSink : public ValueSink
+{
+public:
+    size_t nodes;
+    size_t bytes;
+
+    CountSink()
+        : nodes(0)
+        , bytes(0)
+    {}
+
+    virtual void undefined() { ++nodes; }
+    virtual void number(double) { ++nodes; bytes += 8; }
+    virtual void int32(int32_t) { ++nodes; bytes += 4; }
+    virtual void string(const char*, size_t length) { ++nodes; bytes += length; }
+    virtual void begin_array(uint32_t) { ++nodes; }
+    virtual void end_array() {}
+    virtual void begin_object(uint32_t) { ++nodes; }
+    virtual void key(const char*, size_t length) { bytes += length; }
+    virtual void key(const RecordLayout&, uint32_t) { bytes += 8; }
+    virtual void end_object() {}
+};
+
+struct Timer
+{
+    const char* name;
+    size_t ops;
+    uint64_t start;
+    size_t allocs;
+
+    Timer(const char* n, size_t count)
+        : name(n)
+        , ops(count)
+        , start(now_ns())
+        , allocs(g_allocs)
+    {}
+
+    ~Timer()
+    {
+        const double ns = double(now_ns() - start) / ops;
+        const double a = double(g_allocs - allocs) / ops;
+        printf("%-8s %12.1f ns/op %10.2f allocs/op\n", name, ns, a);
+    }
+};
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    ++g_allocs;
+    void* p = malloc(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) throw()
+{
+    free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+    free(p);
+}
+
+#if __cplusplus >= 201402L
+void operator delete(void* p, size_t) throw()
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) throw()
+{
+    free(p);
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    const size_t ops = argc > 1 ? strtoul(argv[1], 0, 10) : 200000;
+    const int shapes = argc > 2 ? atoi(argv[2]) : 4;
+    const bool profile = argc > 3 && std::string(argv[3]) == "profile";
+
+    std::vector<Doc> docs;
+    for (int i=0 ; i<1024 ; ++i)
+        docs.push_back(make_doc(i, i % shapes, 2));
+
+    Store store;
+    store.enable_profile(profile);
+    std::vector<shared_ptr<JsValue> > vals(ops);
+
+    printf("%lu ops, %d shapes\n", (unsigned long)ops, shapes);
+
+    {
+        Timer t("encode", ops);
+        for (size_t i=0 ; i<ops ; ++i)
+        {
+            DocSource in(docs[i % docs.size()]);
+            vals[i] = store.encode(in);
+        }
+    }
+
+    {
+        Timer t("insert", ops);
+        for (size_t i=0 ; i<ops ; ++i)
+            store.set(int64_t(i * 2654435761u % ops), vals[i]);
+    }
+
+    CountSink sink;
+    {
+        Timer t("decode", store.size());
+        for (Store::Cursor c(store) ; c.next() ; )
+            store.emit(c.entry(), sink);
+    }
+
+    size_t found = 0;
+    {
+        Timer t("lookup", ops);
+        for (size_t i=0 ; i<ops ; ++i)
+            found += store.find(int64_t(i * 40503u % ops)) != 0;
+    }
+
+    {
+        Timer t("del", ops);
+        Footprint removed;
+        for (size_t i=0 ; i<ops ; ++i)
+            store.del(int64_t(i), removed);
+    }
+
+    printf("(%lu nodes, %lu bytes decoded, %lu found)\n",
+           (unsigned long)sink.nodes, (unsigned long)sink.bytes, (unsigned long)found);
+
+    if (const CodecProfile* p = store.profile())
+    {
+        static const char* types[] = { "undefined", "int32", "number", "string", "array", "object" };
+
+        printf("\n%-14s %12s %12s %12s %12s %12s\n", "type", "enc calls", "enc ns/call",
+               "dec calls", "dec ns/call", "bytes");
+        for (int i=0 ; i<CodecProfile::kTypes ; ++i)
+        {
+            const Cost& e = p->encode[i];
+            const Cost& d = p->decode[i];
+            printf("%-14s %12llu %12.1f %12llu %12.1f %12llu\n", types[i],
+                   (unsigned long long)e.calls, e.calls ? double(e.ns) / e.calls : 0,
+                   (unsigned long long)d.calls, d.calls ? double(d.ns) / d.calls : 0,
+                   (unsigned long long)e.bytes);
+        }
+
+        printf("\n%-14s %12s %12s\n", "phase", "calls", "ms");
+        for (int i=0 ; i<CodecProfile::PHASE_COUNT ; ++i)
+        {
+            const Cost& c = p->phases[i];
+            printf("%-14s %12llu %12.1f\n", CodecProfile::phase_name(CodecProfile::Phase(i)),
+                   (unsigned long long)c.calls, c.ns / 1e6);
+        }
+    }
+    return 0;
+}
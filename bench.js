@@ -0,0 +1,247 @@
+// compare BypassStore against keeping the same documents on the v8 heap
+//
+//   node bench.js [--keys 100000] [--ops 200000] [--reads 0.9] [--zipf 0.99]
+//                 [--fields 8] [--depth 2] [--shapes 4] [--stores bypass,heap]
+//
+// every store runs in its own child process started with --trace_gc so
+// the gc pauses of one run do not leak into the other
+
+var spawn = require('child_process').spawn;
+
+var defaults = {
+    keys: 100000,     // documents loaded before the timed run, up to 1e8
+    ops: 200000,      // timed operations
+    reads: 0.9,       // fraction of ops that are gets, the rest are sets
+    zipf: 0.99,       // key skew, 0 for uniform
+    fields: 8,        // scalar members per object
+    depth: 2,         // levels of nested objects
+    shapes: 4,        // distinct member name sets
+    stores: 'bypass,heap'
+};
+
+function parse_args(argv) {
+    var opts = {};
+    Object.keys(defaults).forEach(function(k) {
+        opts[k] = defaults[k];
+    });
+
+    for (var i=0 ; i<argv.length ; ++i) {
+        var m = /^--(.*)$/.exec(argv[i]);
+        if (!m)
+            continue;
+        var v = argv[++i];
+        opts[m[1]] = (typeof defaults[m[1]] === 'number') ? Number(v) : v;
+    }
+
+    return opts;
+}
+
+/// zipfian generator over [0, n) after Gray et al., as used by YCSB
+/// O(n) setup to compute zeta(n), O(1) per sample
+function Zipf(n, theta) {
+    this.n = n;
+    this.theta = theta;
+
+    if (theta <= 0)
+        return;
+
+    var zetan = 0;
+    for (var i=1 ; i<=n ; ++i)
+        zetan += 1 / Math.pow(i, theta);
+
+    var zeta2 = 1 + 1 / Math.pow(2, theta);
+    this.zetan = zetan;
+    this.alpha = 1 / (1 - theta);
+    this.eta = (1 - Math.pow(2 / n, 1 - theta)) / (1 - zeta2 / zetan);
+}
+
+Zipf.prototype.next = function() {
+    if (this.theta <= 0)
+        return Math.floor(Math.random() * this.n);
+
+    var u = Math.random();
+    var uz = u * this.zetan;
+    if (uz < 1)
+        return 0;
+    if (uz < 1 + Math.pow(0.5, this.theta))
+        return 1;
+
+    var k = Math.floor(this.n * Math.pow(this.eta * u - this.eta + 1, this.alpha));
+    return k < this.n ? k : this.n - 1;
+};
+
+/// a document with the requested number of fields and nesting
+function make_doc(opts, id) {
+    var shape = id % opts.shapes;
+    var doc = { index: id };
+    for (var i=0 ; i<opts.fields ; ++i) {
+        var name = 's' + shape + '_f' + i;
+        doc[name] = (i % 2) ? 'value ' + id + ' ' + i : id * 0.5 + i;
+    }
+
+    doc.list = [id, id + 1, id + 2, 'x' + id];
+
+    var outer = doc;
+    for (var d=0 ; d<opts.depth ; ++d) {
+        var inner = { level: d, name: 'inner ' + d, values: [d, d * 1.5] };
+        outer.inner = inner;
+        outer = inner;
+    }
+
+    return doc;
+}
+
+/// on heap baseline with the same interface as BypassStore
+function HeapStore() {
+    this.map = (typeof Map === 'function') ? new Map() : null;
+    this.obj = {};
+}
+
+HeapStore.prototype.set = function(k, v) {
+    if (this.map)
+        this.map.set(k, v);
+    else
+        this.obj[k] = v;
+};
+
+HeapStore.prototype.get = function(k) {
+    return this.map ? this.map.get(k) : this.obj[k];
+};
+
+/// high resolution clock in microseconds where node has one
+var now_us = process.hrtime ?
+    function() { var t = process.hrtime(); return t[0] * 1e6 + t[1] / 1e3; } :
+    function() { return Date.now() * 1e3; };
+
+function percentile(sorted, p) {
+    if (sorted.length === 0)
+        return 0;
+    return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+/// runs the workload inside the child and prints a RESULT line
+function child(kind, opts) {
+    var store;
+    if (kind === 'bypass') {
+        var bypass = require('./build/default/bypass');
+        store = new bypass.BypassStore();
+    }
+    else {
+        store = new HeapStore();
+    }
+
+    for (var i=0 ; i<opts.keys ; ++i)
+        store.set(i, make_doc(opts, i));
+
+    var zipf = new Zipf(opts.keys, opts.zipf);
+    var lat = [];
+
+    // without hrtime single ops are below the clock resolution so time
+    // batches and report the per op average of each batch instead
+    var batch = process.hrtime ? 1 : 100;
+
+    var start = now_us();
+    for (var done=0 ; done<opts.ops ; done+=batch) {
+        var t0 = now_us();
+        for (var b=0 ; b<batch ; ++b) {
+            var k = zipf.next();
+            if (Math.random() < opts.reads)
+                store.get(k);
+            else
+                store.set(k, make_doc(opts, k));
+        }
+        lat.push((now_us() - t0) / batch);
+    }
+    var elapsed = now_us() - start;
+
+    lat.sort(function(a, b) { return a - b; });
+    var mem = process.memoryUsage();
+
+    console.log('RESULT ' + JSON.stringify({
+        store: kind,
+        ops_per_sec: Math.round(opts.ops / (elapsed / 1e6)),
+        p50_us: percentile(lat, 0.5),
+        p99_us: percentile(lat, 0.99),
+        rss_mb: mem.rss / 1048576,
+        heap_mb: mem.heapUsed / 1048576
+    }));
+}
+
+/// start one child per store and collect its result and gc pauses
+function run(kinds, opts, results) {
+    if (kinds.length === 0)
+        return report(opts, results);
+
+    var kind = kinds.shift();
+    var args = ['--trace_gc', __filename, '--child', kind];
+    Object.keys(defaults).forEach(function(k) {
+        args.push('--' + k, String(opts[k]));
+    });
+
+    var proc = spawn(process.execPath, args);
+    var out = '';
+    proc.stdout.on('data', function(d) { out += d; });
+    proc.stderr.on('data', function(d) { process.stderr.write(d); });
+    proc.on('exit', function(code) {
+        var result = null;
+        var gc_ms = 0;
+        var gc_count = 0;
+
+        out.split('\n').forEach(function(line) {
+            if (line.indexOf('RESULT ') === 0) {
+                result = JSON.parse(line.substr(7));
+                return;
+            }
+
+            // Scavenge 1.1 -> 0.9 MB, 2 ms.  or  ... MB, 0.8 / 0.0 ms ...
+            var m = /(Scavenge|Mark-sweep|Mark-compact).*MB, ([\d.]+)/.exec(line);
+            if (m) {
+                gc_ms += Number(m[2]);
+                ++gc_count;
+            }
+        });
+
+        if (!result) {
+            console.error(kind + ' run failed with code ' + code);
+        }
+        else {
+            result.gc_ms = gc_ms;
+            result.gc_count = gc_count;
+            results.push(result);
+        }
+
+        run(kinds, opts, results);
+    });
+}
+
+function pad(s, n) {
+    s = String(s);
+    while (s.length < n)
+        s = ' ' + s;
+    return s;
+}
+
+function report(opts, results) {
+    console.log('keys=' + opts.keys + ' ops=' + opts.ops + ' reads=' + opts.reads +
+                ' zipf=' + opts.zipf + ' fields=' + opts.fields + ' depth=' + opts.depth +
+                ' shapes=' + opts.shapes);
+
+    var cols = ['store', 'ops_per_sec', 'p50_us', 'p99_us', 'rss_mb', 'heap_mb', 'gc_ms', 'gc_count'];
+    console.log(cols.map(function(c) { return pad(c, 12); }).join(''));
+
+    results.forEach(function(r) {
+        console.log(cols.map(function(c) {
+            var v = r[c];
+            return pad(typeof v === 'number' && v % 1 ? v.toFixed(2) : v, 12);
+        }).join(''));
+    });
+}
+
+var argv = process.argv.slice(2);
+var opts = parse_args(argv);
+var child_at = argv.indexOf('--child');
+
+if (child_at >= 0)
+    child(argv[child_at + 1], opts);
+else
+    run(opts.stores.split(','), opts, []);
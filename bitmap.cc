@@ -0,0 +1,380 @@
+#include <iterator>
+#include <algorithm>
+
+#include "bitmap.h"
+
+using namespace boost;
+
+namespace bypass {
+
+namespace {
+
+typedef JsBitmap::Container Container;
+typedef std::vector<uint16_t> Array;
+typedef std::vector<uint64_t> Bits;
+
+inline bool test(const Bits& bits, uint16_t low)
+{
+    return (bits[low >> 6] >> (low & 63)) & 1;
+}
+
+inline void set(Bits& bits, uint16_t low)
+{
+    bits[low >> 6] |= uint64_t(1) << (low & 63);
+}
+
+inline void clear(Bits& bits, uint16_t low)
+{
+    bits[low >> 6] &= ~(uint64_t(1) << (low & 63));
+}
+
+uint32_t count(const Bits& bits)
+{
+    uint32_t card = 0;
+    for (uint32_t i=0 ; i<JsBitmap::kWords ; ++i)
+        card += __builtin_popcountll(bits[i]);
+    return card;
+}
+
+void to_bits(const Array& array, Bits& out)
+{
+    out.assign(JsBitmap::kWords, 0);
+    for (size_t i=0 ; i<array.size() ; ++i)
+        set(out, array[i]);
+}
+
+void to_array(const Bits& bits, Array& out)
+{
+    out.clear();
+    for (uint32_t i=0 ; i<JsBitmap::kWords ; ++i)
+    {
+        // visit only the set bits of each word
+        uint64_t w = bits[i];
+        while (w)
+        {
+            out.push_back(uint16_t(i * 64 + __builtin_ctzll(w)));
+            w &= w - 1;
+        }
+    }
+}
+
+/// pick the smaller form for the cardinality of c
+void normalize(Container& c)
+{
+    if (c.dense() && c.card <= JsBitmap::kMaxArray)
+    {
+        to_array(c.bits, c.array);
+        Bits().swap(c.bits);
+    }
+    else if (!c.dense() && c.card > JsBitmap::kMaxArray)
+    {
+        to_bits(c.array, c.bits);
+        Array().swap(c.array);
+    }
+}
+
+/// first position in a at or after from with a value >= val
+/// gallops ahead so a small array can be intersected with a large one
+/// in O(small * log large)
+size_t advance(const Array& a, size_t from, uint16_t val)
+{
+    size_t step = 1;
+    size_t hi = from;
+    while (hi < a.size() && a[hi] < val)
+    {
+        from = hi + 1;
+        hi += step;
+        step <<= 1;
+    }
+    if (hi > a.size())
+        hi = a.size();
+    return std::lower_bound(a.begin() + from, a.begin() + hi, val) - a.begin();
+}
+
+void intersect(const Array& a, const Array& b, Array& out)
+{
+    // gallop through the larger one when the sizes are far apart
+    const Array& small = a.size() <= b.size() ? a : b;
+    const Array& large = a.size() <= b.size() ? b : a;
+    if (small.size() * 64 < large.size())
+    {
+        size_t j = 0;
+        for (size_t i=0 ; i<small.size() && j<large.size() ; ++i)
+        {
+            j = advance(large, j, small[i]);
+            if (j < large.size() && large[j] == small[i])
+                out.push_back(small[i]);
+        }
+        return;
+    }
+
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out));
+}
+
+/// x op y into out, both forms of each side are handled
+void combine(JsBitmap::SetOp op, const Container& x, const Container& y, Container& out)
+{
+    out.key = x.key;
+
+    if (!x.dense() && !y.dense())
+    {
+        if (op == JsBitmap::AND)
+            intersect(x.array, y.array, out.array);
+        else if (op == JsBitmap::OR)
+            std::set_union(x.array.begin(), x.array.end(), y.array.begin(), y.array.end(),
+                           std::back_inserter(out.array));
+        else
+            std::set_difference(x.array.begin(), x.array.end(), y.array.begin(), y.array.end(),
+                                std::back_inserter(out.array));
+        out.card = out.array.size();
+        normalize(out);
+        return;
+    }
+
+    if (op == JsBitmap::AND && (!x.dense() || !y.dense()))
+    {
+        // keep the array values the bitset has
+        const Container& sparse = x.dense() ? y : x;
+        const Container& dense = x.dense() ? x : y;
+        for (size_t i=0 ; i<sparse.array.size() ; ++i)
+        {
+            if (test(dense.bits, sparse.array[i]))
+                out.array.push_back(sparse.array[i]);
+        }
+        out.card = out.array.size();
+        return;
+    }
+
+    if (op == JsBitmap::ANDNOT && !x.dense())
+    {
+        for (size_t i=0 ; i<x.array.size() ; ++i)
+        {
+            if (!test(y.bits, x.array[i]))
+                out.array.push_back(x.array[i]);
+        }
+        out.card = out.array.size();
+        return;
+    }
+
+    // the result starts as a bitset of x, y is folded in word by word or
+    // value by value. the word loops are plain so the compiler can
+    // vectorize them
+    if (x.dense())
+        out.bits = x.bits;
+    else
+        to_bits(x.array, out.bits);
+
+    uint64_t* w = &out.bits[0];
+    if (y.dense())
+    {
+        const uint64_t* v = &y.bits[0];
+        if (op == JsBitmap::AND)
+            for (uint32_t i=0 ; i<JsBitmap::kWords ; ++i)
+                w[i] &= v[i];
+        else if (op == JsBitmap::OR)
+            for (uint32_t i=0 ; i<JsBitmap::kWords ; ++i)
+                w[i] |= v[i];
+        else
+            for (uint32_t i=0 ; i<JsBitmap::kWords ; ++i)
+                w[i] &= ~v[i];
+    }
+    else
+    {
+        for (size_t i=0 ; i<y.array.size() ; ++i)
+        {
+            if (op == JsBitmap::OR)
+                set(out.bits, y.array[i]);
+            else
+                clear(out.bits, y.array[i]);
+        }
+    }
+
+    out.card = count(out.bits);
+    normalize(out);
+}
+
+} // namespace
+
+size_t JsBitmap::position(uint16_t key) const
+{
+    size_t lo = 0;
+    size_t hi = m_containers.size();
+    while (lo < hi)
+    {
+        const size_t mid = (lo + hi) / 2;
+        if (m_containers[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+bool JsBitmap::add(uint32_t val)
+{
+    const uint16_t key = uint16_t(val >> 16);
+    const uint16_t low = uint16_t(val);
+
+    const size_t pos = position(key);
+    if (pos == m_containers.size() || m_containers[pos].key != key)
+    {
+        Container c;
+        c.key = key;
+        c.card = 0;
+        m_containers.insert(m_containers.begin() + pos, c);
+    }
+
+    Container& c = m_containers[pos];
+    if (c.dense())
+    {
+        if (test(c.bits, low))
+            return false;
+        set(c.bits, low);
+    }
+    else
+    {
+        Array::iterator iter = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (iter != c.array.end() && *iter == low)
+            return false;
+        c.array.insert(iter, low);
+    }
+
+    ++c.card;
+    ++m_card;
+    normalize(c);
+    return true;
+}
+
+bool JsBitmap::remove(uint32_t val)
+{
+    const uint16_t key = uint16_t(val >> 16);
+    const uint16_t low = uint16_t(val);
+
+    const size_t pos = position(key);
+    if (pos == m_containers.size() || m_containers[pos].key != key)
+        return false;
+
+    Container& c = m_containers[pos];
+    if (c.dense())
+    {
+        if (!test(c.bits, low))
+            return false;
+        clear(c.bits, low);
+    }
+    else
+    {
+        Array::iterator iter = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (iter == c.array.end() || *iter != low)
+            return false;
+        c.array.erase(iter);
+    }
+
+    --c.card;
+    --m_card;
+    if (c.card == 0)
+        m_containers.erase(m_containers.begin() + pos);
+    else
+        normalize(c);
+    return true;
+}
+
+bool JsBitmap::contains(uint32_t val) const
+{
+    const uint16_t key = uint16_t(val >> 16);
+    const uint16_t low = uint16_t(val);
+
+    const size_t pos = position(key);
+    if (pos == m_containers.size() || m_containers[pos].key != key)
+        return false;
+
+    const Container& c = m_containers[pos];
+    if (c.dense())
+        return test(c.bits, low);
+    return std::binary_search(c.array.begin(), c.array.end(), low);
+}
+
+void JsBitmap::values(uint32_t* out) const
+{
+    Array scratch;
+    for (size_t i=0 ; i<m_containers.size() ; ++i)
+    {
+        const Container& c = m_containers[i];
+        const uint32_t high = uint32_t(c.key) << 16;
+
+        const Array* low = &c.array;
+        if (c.dense())
+        {
+            to_array(c.bits, scratch);
+            low = &scratch;
+        }
+
+        for (size_t j=0 ; j<low->size() ; ++j)
+            *out++ = high | (*low)[j];
+    }
+}
+
+shared_ptr<JsBitmap> JsBitmap::combine(SetOp op, const JsBitmap& a, const JsBitmap& b)
+{
+    shared_ptr<JsBitmap> out(new JsBitmap());
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.m_containers.size() || j < b.m_containers.size())
+    {
+        const Container* x = i < a.m_containers.size() ? &a.m_containers[i] : 0;
+        const Container* y = j < b.m_containers.size() ? &b.m_containers[j] : 0;
+
+        // containers only one side has are kept by OR and by ANDNOT from a
+        if (x && (!y || x->key < y->key))
+        {
+            if (op != AND)
+                out->m_containers.push_back(*x);
+            ++i;
+        }
+        else if (!x || y->key < x->key)
+        {
+            if (op == OR)
+                out->m_containers.push_back(*y);
+            ++j;
+        }
+        else
+        {
+            Container c;
+            bypass::combine(op, *x, *y, c);
+            if (c.card)
+                out->m_containers.push_back(c);
+            ++i;
+            ++j;
+        }
+    }
+
+    for (size_t k=0 ; k<out->m_containers.size() ; ++k)
+        out->m_card += out->m_containers[k].card;
+    return out;
+}
+
+void JsBitmap::emit(ValueSink& out) const
+{
+    std::vector<uint32_t> vals(m_card);
+    if (m_card)
+        values(&vals[0]);
+
+    out.begin_array(vals.size());
+    for (size_t i=0 ; i<vals.size() ; ++i)
+        out.number(vals[i]);
+    out.end_array();
+}
+
+void JsBitmap::measure(Footprint& out) const
+{
+    out.bytes += sizeof(*this) + m_containers.capacity() * sizeof(Container);
+    ++out.nodes;
+
+    for (size_t i=0 ; i<m_containers.size() ; ++i)
+    {
+        const Container& c = m_containers[i];
+        out.bytes += c.array.capacity() * sizeof(uint16_t) + c.bits.capacity() * sizeof(uint64_t);
+    }
+}
+
+} // namespace bypass
@@ -0,0 +1,85 @@
+#ifndef BYPASS_BITMAP_H
+#define BYPASS_BITMAP_H
+
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include "value.h"
+
+namespace bypass {
+
+/// set of 32 bit integers as a roaring bitmap
+/// values are split by their high 16 bits into containers of at most 65536
+/// values. sparse containers are sorted arrays of the low 16 bits, dense
+/// ones a 65536 bit bitset, so a container never takes more than 8kB and
+/// set operations run per container on whichever pair of forms they meet.
+/// emits as an ascending array of numbers
+class JsBitmap : public JsValue
+{
+public:
+    enum SetOp
+    {
+        AND,
+        OR,
+        ANDNOT
+    };
+
+    struct Container
+    {
+        uint16_t key;
+        uint32_t card;
+
+        // sorted low bits while card <= kMaxArray
+        std::vector<uint16_t> array;
+
+        // kWords words once larger
+        std::vector<uint64_t> bits;
+
+        bool dense() const { return !bits.empty(); }
+    };
+
+    /// past this a bitset is smaller than an array
+    static const uint32_t kMaxArray = 4096;
+    static const uint32_t kWords = 65536 / 64;
+
+private:
+    std::vector<Container> m_containers;
+    uint64_t m_card;
+
+    /// index of the container for key or where it would go
+    size_t position(uint16_t key) const;
+
+public:
+    virtual Kind kind() const { return KIND_BITMAP; }
+
+    JsBitmap()
+        : m_card(0)
+    {}
+
+    /// true if val was not there
+    bool add(uint32_t val);
+
+    /// true if val was there
+    bool remove(uint32_t val);
+
+    bool contains(uint32_t val) const;
+
+    uint64_t cardinality() const { return m_card; }
+
+    /// write cardinality() values in ascending order to out
+    void values(uint32_t* out) const;
+
+    /// a op b as a new bitmap
+    static boost::shared_ptr<JsBitmap> combine(SetOp op, const JsBitmap& a, const JsBitmap& b);
+
+    virtual void emit(ValueSink& out) const;
+
+    virtual void measure(Footprint& out) const;
+};
+
+} // namespace bypass
+
+#endif
@@ -1,269 +1,699 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <limits>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <v8.h>
 #include <node.h>
+#include <v8-profiler.h>
+
+#include "value.h"
+#include "timeseries.h"
+#include "list.h"
+#include "hash.h"
+#include "zset.h"
+#include "bitmap.h"
+#include "sketch.h"
+#include "textindex.h"
+#include "vectorindex.h"
+#include "stringindex.h"
+#include "store.h"
+#include "clock.h"
+#include "metrics.h"
+#include "probes.h"
 
 using namespace v8;
 using namespace boost;
 using namespace node;
+using namespace bypass;
 
 namespace {
-class JsValue
-{
-public:
-    /// process the local value into a JsValue object
-    //virtual shared_ptr<JsValue> from_v8(const Local<Value> val) = 0;
 
-    /// return a v8 value to be passed back to the VM
-    virtual Handle<Value> to_v8() const = 0;
-
-    virtual ~JsValue() {}
-};
+/// persistent v8 strings for the field names of each RecordLayout
+/// so records are read and written without creating key strings
+class SymbolTable
+{
+    typedef std::vector<Persistent<String> > Symbols;
+    typedef std::map<uint32_t, Symbols> SymbolMap;
 
-/// main processing method for turning a v8 object into cache
-shared_ptr<JsValue> from_v8(const Handle<Value> val);
+    static SymbolMap& symbols()
+    {
+        static SymbolMap map;
+        return map;
+    }
 
-/// when the type is not supported
-class JsUndefined : public JsValue
-{
 public:
-    virtual Handle<Value> to_v8() const
+    static const Symbols& get(const RecordLayout& layout)
     {
-        return Undefined();
+        Symbols& s = symbols()[layout.id()];
+        if (s.empty())
+        {
+            const std::vector<RecordLayout::Field>& fields = layout.fields();
+            for (size_t i=0 ; i<fields.size() ; ++i)
+            {
+                const std::string& name = fields[i].name;
+                s.push_back(Persistent<String>::New(
+                    String::NewSymbol(name.data(), name.size())));
+            }
+        }
+
+        return s;
     }
 };
 
-class JsString : public JsValue
+/// reads a v8 value for the encoder
+class V8Source : public ValueSource
 {
-    char* m_buff;
-    int m_size;
+    struct Frame
+    {
+        Local<Value> val;
+
+        // property names of an object, fetched on first use
+        Local<Array> names;
+    };
+
+    std::vector<Frame> m_stack;
+
+    Frame& top() { return m_stack.back(); }
+
+    Local<Array> names()
+    {
+        Frame& f = top();
+        if (f.names.IsEmpty())
+            f.names = f.val->ToObject()->GetPropertyNames();
+        return f.names;
+    }
+
+    void push(const Local<Value> val)
+    {
+        m_stack.push_back(Frame());
+        top().val = val;
+    }
 
 public:
-    static shared_ptr<JsValue> from_v8(const Local<String> val)
+    V8Source(const Handle<Value> val)
     {
-        shared_ptr<JsString> s(new JsString());
+        push(Local<Value>::New(val));
+    }
 
-        s->m_size = val->Utf8Length();
-        s->m_buff = new char[s->m_size];
-        val->WriteUtf8(s->m_buff, s->m_size);
+    virtual Type type()
+    {
+        const Local<Value>& v = top().val;
+        if (v->IsNumber())
+            return v->IsInt32() ? INT32 : NUMBER;
+        if (v->IsString())
+            return STRING;
+        if (v->IsArray())
+            return ARRAY;
+        if (v->IsObject())
+            return OBJECT;
+        return UNDEFINED;
+    }
 
-        return s;
+    virtual double number()
+    {
+        return top().val->NumberValue();
     }
 
-    virtual Handle<Value> to_v8() const
+    virtual size_t string_length()
     {
-        return String::New(m_buff, m_size);
+        return top().val->ToString()->Utf8Length();
     }
 
-    JsString()
-        : m_buff(0)
-    {}
+    virtual void string_write(char* out)
+    {
+        Local<String> s = top().val->ToString();
+        s->WriteUtf8(out, s->Utf8Length());
+    }
 
-    ~JsString()
+    virtual uint32_t size()
     {
-        if (m_buff)
-            delete[] m_buff;
+        const Local<Value>& v = top().val;
+        if (v->IsArray())
+            return Local<Array>::Cast(v)->Length();
+        return names()->Length();
     }
-};
 
-/// v8::Number
-class JsNumber : public JsValue
-{
-    double m_val;
+    virtual std::string key(uint32_t i)
+    {
+        String::Utf8Value k(names()->Get(i));
+        return std::string(*k, k.length());
+    }
 
-public:
-    static shared_ptr<JsValue> from_v8(const Local<Number> val)
+    virtual void enter(uint32_t i)
     {
-        return shared_ptr<JsNumber>(new JsNumber(val->NumberValue()));
+        const Local<Value> v = top().val;
+        if (v->IsArray())
+            push(Local<Array>::Cast(v)->Get(i));
+        else
+            push(v->ToObject()->Get(names()->Get(i)));
     }
 
-    virtual Handle<Value> to_v8() const
+    virtual void enter(const RecordLayout& layout, uint32_t field)
     {
-        return Number::New(m_val);
+        const Local<Value> v = top().val;
+        push(v->ToObject()->Get(SymbolTable::get(layout)[field]));
     }
 
-    // don't use directly, only use from_v8 instead
-    // this is here for the shared pointer
-    JsNumber(double val)
-        : m_val(val)
-    {}
+    virtual void leave()
+    {
+        m_stack.pop_back();
+    }
 
+    virtual bool matches(const RecordLayout& layout)
+    {
+        const std::vector<Persistent<String> >& symbols = SymbolTable::get(layout);
+
+        Local<Array> n = names();
+        if (n->Length() != symbols.size())
+            return false;
+
+        for (uint32_t i=0 ; i<symbols.size() ; ++i)
+        {
+            if (!n->Get(i)->StrictEquals(symbols[i]))
+                return false;
+        }
+
+        return true;
+    }
 };
 
-/// v8::Int32
-class JsInt32 : public JsValue
+/// builds v8 values from decoded values
+class V8Sink : public ValueSink
 {
-    int32_t m_val;
+    struct Frame
+    {
+        Local<Object> obj;
+        bool array;
+        uint32_t index;
+        Handle<Value> key;
+    };
+
+    std::vector<Frame> m_stack;
+    Handle<Value> m_result;
+
+    void put(const Handle<Value> val)
+    {
+        if (m_stack.empty())
+        {
+            m_result = val;
+            return;
+        }
+
+        Frame& f = m_stack.back();
+        if (f.array)
+            f.obj->Set(f.index++, val);
+        else
+            f.obj->Set(f.key, val);
+    }
+
+    void push(const Local<Object> obj, bool array)
+    {
+        Frame f;
+        f.obj = obj;
+        f.array = array;
+        f.index = 0;
+        m_stack.push_back(f);
+    }
+
+    void pop()
+    {
+        const Local<Object> obj = m_stack.back().obj;
+        m_stack.pop_back();
+        put(obj);
+    }
 
 public:
-    static shared_ptr<JsValue> from_v8(const Local<Number> val)
+    /// the value built, valid once the top level value is complete
+    Handle<Value> result() const { return m_result; }
+
+    virtual void undefined()
     {
-        return shared_ptr<JsInt32>(new JsInt32(val->Int32Value()));
+        put(Undefined());
     }
 
-    virtual Handle<Value> to_v8() const
+    virtual void number(double val)
     {
-        return Int32::New(m_val);
+        put(Number::New(val));
     }
 
-    JsInt32(int32_t val)
-        : m_val(val)
-    {}
-};
+    virtual void int32(int32_t val)
+    {
+        put(Int32::New(val));
+    }
 
-/// v8::Uint32
-class JsUint32 : public JsValue
-{
-    uint32_t m_val;
+    virtual void string(const char* data, size_t length)
+    {
+        put(String::New(data, length));
+    }
 
-public:
-    static shared_ptr<JsValue> from_v8(const Local<Number> val)
+    virtual void begin_array(uint32_t size)
     {
-        return shared_ptr<JsUint32>(new JsUint32(val->Uint32Value()));
+        push(Array::New(size), true);
     }
 
-    virtual Handle<Value> to_v8() const
+    virtual void end_array()
     {
-        return Uint32::New(m_val);
+        pop();
     }
 
-    JsUint32(uint32_t val)
-        : m_val(val)
-    {}
+    virtual void begin_object(uint32_t)
+    {
+        push(Object::New(), false);
+    }
+
+    virtual void key(const char* name, size_t length)
+    {
+        m_stack.back().key = String::New(name, length);
+    }
+
+    virtual void key(const RecordLayout& layout, uint32_t field)
+    {
+        m_stack.back().key = SymbolTable::get(layout)[field];
+    }
+
+    virtual void end_object()
+    {
+        pop();
+    }
 };
 
-/// v8::Array
-class JsArray : public JsValue
+/// builds a v8 value over several turns of the event loop
+/// like V8Sink but the handles are persistent and every container is set
+/// on its parent as soon as it starts, so the partial tree survives the
+/// handle scope of each turn
+class PersistentSink : public ValueSink
 {
-    // store other JsValue objects
-    std::vector<shared_ptr<JsValue> > m_vals;
+    struct Frame
+    {
+        Persistent<Object> obj;
+        bool array;
+        uint32_t index;
+        Persistent<Value> key;
+    };
+
+    std::vector<Frame> m_stack;
+    Persistent<Value> m_result;
+
+    void put(const Handle<Value> val)
+    {
+        if (m_stack.empty())
+        {
+            m_result = Persistent<Value>::New(val);
+            return;
+        }
+
+        Frame& f = m_stack.back();
+        if (f.array)
+            f.obj->Set(f.index++, val);
+        else
+            f.obj->Set(f.key, val);
+    }
+
+    void push(const Local<Object> obj, bool array)
+    {
+        put(obj);
+
+        Frame f;
+        f.obj = Persistent<Object>::New(obj);
+        f.array = array;
+        f.index = 0;
+        m_stack.push_back(f);
+    }
+
+    void pop()
+    {
+        Frame& f = m_stack.back();
+        f.obj.Dispose();
+        f.key.Dispose();
+        m_stack.pop_back();
+    }
+
+    void set_key(const Handle<Value> key)
+    {
+        Frame& f = m_stack.back();
+        f.key.Dispose();
+        f.key = Persistent<Value>::New(key);
+    }
 
 public:
+    ~PersistentSink()
+    {
+        while (!m_stack.empty())
+            pop();
+        m_result.Dispose();
+    }
 
-    static shared_ptr<JsValue> from_v8(const Local<Object> val)
+    /// the value built, valid once the top level value is complete
+    Local<Value> result() const { return Local<Value>::New(m_result); }
+
+    virtual void undefined()
     {
-        shared_ptr<JsArray> out(new JsArray());
+        put(Undefined());
+    }
 
-        Local<Array> arr = Local<Array>::Cast(val);
+    virtual void number(double val)
+    {
+        put(Number::New(val));
+    }
 
-        uint32_t length = arr->Length();
-        for (uint32_t i=0 ; i<length ; ++i)
-        {
-            Local<Value> v = arr->Get(i);
-            out->m_vals.push_back(::from_v8(v));
-        }
+    virtual void int32(int32_t val)
+    {
+        put(Int32::New(val));
+    }
 
-        return out;
+    virtual void string(const char* data, size_t length)
+    {
+        put(String::New(data, length));
     }
 
-    virtual Handle<Value> to_v8() const
+    virtual void begin_array(uint32_t size)
     {
-        // result object
-        const size_t size = m_vals.size();
-        Local<Array> out = Array::New(size);
+        push(Array::New(size), true);
+    }
 
-        for (size_t i=0 ; i<size ; ++i)
-        {
-            const shared_ptr<JsValue>& val = m_vals[i];
-            if (val)
-                out->Set(i, val->to_v8());
-        }
+    virtual void end_array()
+    {
+        pop();
+    }
+
+    virtual void begin_object(uint32_t)
+    {
+        push(Object::New(), false);
+    }
+
+    virtual void key(const char* name, size_t length)
+    {
+        set_key(String::New(name, length));
+    }
+
+    virtual void key(const RecordLayout& layout, uint32_t field)
+    {
+        set_key(SymbolTable::get(layout)[field]);
+    }
 
-        return Handle<Value>(out);
+    virtual void end_object()
+    {
+        pop();
     }
 };
 
-/// v8::Object
-class JsObj : public JsValue
+/// drops everything, for the start of a container read member by member
+class NullSink : public ValueSink
 {
-    // values of the javascript object
-    typedef std::map<std::string, shared_ptr<JsValue> > MemberMap;
-    MemberMap m_values;
-
 public:
+    virtual void undefined() {}
+    virtual void number(double) {}
+    virtual void int32(int32_t) {}
+    virtual void string(const char*, size_t) {}
+    virtual void begin_array(uint32_t) {}
+    virtual void end_array() {}
+    virtual void begin_object(uint32_t) {}
+    virtual void key(const char*, size_t) {}
+    virtual void end_object() {}
+};
+
+/// a read that decodes a slice at a time and yields to the event loop
+/// between slices with setTimeout(0) so a huge value does not stall other
+/// callbacks. deletes itself once finished
+class SlicedRead
+{
+    /// shared by all reads, each is passed to it as an argument. made once
+    /// since instantiated function templates are never collected
+    static Persistent<Function>& tick()
+    {
+        static Persistent<Function> fn;
+        return fn;
+    }
 
-    static shared_ptr<JsValue> from_v8(const Local<Object> val)
+    static Handle<Value> Tick(const Arguments& args)
     {
-        shared_ptr<JsObj> out(new JsObj());
+        HandleScope scope;
 
-        Local<Object> o = val;
-        Local<Array> a = o->GetPropertyNames();
+        SlicedRead* read = static_cast<SlicedRead*>(External::Unwrap(args[0]));
 
-        const uint32_t length = a->Length();
-        for (uint32_t i=0 ; i<length ; ++i)
+        TryCatch try_catch;
+        const bool done = read->slice(now_ns() + read->m_budget);
+        if (try_catch.HasCaught())
+        {
+            delete read;
+            FatalException(try_catch);
+        }
+        else if (done)
         {
-            Local<Value> k = a->Get(i);
+            delete read;
+        }
+        else
+        {
+            read->schedule();
+        }
 
-            String::AsciiValue key(k);
-            std::string s(key.operator *(), key.length());
+        return Undefined();
+    }
 
-            // need to use the global from_v8 here
-            out->m_values[s] = ::from_v8(o->Get(k));
-        }
+protected:
+    Persistent<Function> m_callback;
+    uint64_t m_budget;
 
-        return out;
+    /// decode until the deadline, true when there is nothing left
+    virtual bool slice(uint64_t deadline) = 0;
+
+    void call(int argc, Handle<Value> argv[])
+    {
+        m_callback->Call(Context::GetCurrent()->Global(), argc, argv);
     }
 
-    // convert yourself into a v8 object
-    Handle<Value> to_v8() const
+public:
+    /// call once from Init before any read is scheduled
+    static void init()
     {
-        // result object
-        Local<Object> obj = Object::New();
+        tick() = Persistent<Function>::New(FunctionTemplate::New(Tick)->GetFunction());
+    }
 
-        MemberMap::const_iterator iter = m_values.begin();
+    SlicedRead(const Local<Function> callback, uint64_t budget_ns)
+        : m_callback(Persistent<Function>::New(callback))
+        , m_budget(budget_ns)
+    {}
 
-        for (; iter != m_values.end() ; ++iter)
-        {
-            Local<String> key = String::New(iter->first.c_str());
+    virtual ~SlicedRead()
+    {
+        m_callback.Dispose();
+    }
 
-            const shared_ptr<JsValue> val = iter->second;
-            if (val)
-                obj->Set(key, val->to_v8());
-        }
+    /// setTimeout(tick, 0, this)
+    void schedule()
+    {
+        const Local<Object> global = Context::GetCurrent()->Global();
+        const Local<Function> set_timeout =
+            Local<Function>::Cast(global->Get(String::NewSymbol("setTimeout")));
 
-        return Handle<Value>(obj);
+        Handle<Value> argv[3] = { tick(), Integer::New(0), External::New(this) };
+        set_timeout->Call(global, 3, argv);
     }
 };
 
-/// process the v8 value and return it wrapped in a JsValue object
-/// generic callout
-shared_ptr<JsValue> from_v8(const Handle<Value> v8obj)
+/// the whole value, rebuilt with a DecodeCursor
+/// calls back (null, value) once done
+class IncrementalRead : public SlicedRead
 {
-    if (v8obj->IsNumber())
+    DecodeCursor m_cursor;
+    PersistentSink m_out;
+
+protected:
+    virtual bool slice(uint64_t deadline)
     {
-        if (v8obj->IsInt32())
+        // the clock is read once per batch of values
+        do
         {
-            return JsInt32::from_v8(v8obj->ToNumber());
+            if (m_cursor.step(m_out, 256))
+            {
+                Handle<Value> argv[2] = { Null(), m_out.result() };
+                call(2, argv);
+                return true;
+            }
         }
-        else
+        while (now_ns() < deadline);
+
+        return false;
+    }
+
+public:
+    IncrementalRead(const shared_ptr<JsValue>& value, const Local<Function> callback,
+                    uint64_t budget_ns)
+        : SlicedRead(callback, budget_ns)
+        , m_cursor(value)
+    {}
+};
+
+/// the elements of a top level array in batches
+/// calls back (null, elements, done) once per slice, a missing value
+/// reads as an empty array
+class StreamRead : public SlicedRead
+{
+    shared_ptr<JsValue> m_value;
+    scoped_ptr<JsValue::Walk> m_walk;
+    uint32_t m_batch;
+
+protected:
+    virtual bool slice(uint64_t deadline)
+    {
+        V8Sink out;
+        out.begin_array(0);
+
+        bool done = !m_walk;
+        for (uint32_t n=0 ; !done && n<m_batch ; ++n)
         {
-            return JsNumber::from_v8(v8obj->ToNumber());
+            const JsValue* child = 0;
+            if (!m_walk->next(out, child))
+            {
+                // the walk closed the batch along with the array
+                done = true;
+                break;
+            }
+            if (child)
+                child->emit(out);
+
+            if ((n & 63) == 63 && now_ns() >= deadline)
+                break;
         }
+
+        if (!done || !m_walk)
+            out.end_array();
+
+        Handle<Value> argv[3] = { Null(), out.result(), Boolean::New(done) };
+        call(3, argv);
+        return done;
     }
-    else if (v8obj->IsString())
+
+public:
+    StreamRead(const shared_ptr<JsValue>& value, const Local<Function> callback,
+               uint64_t budget_ns, uint32_t batch)
+        : SlicedRead(callback, budget_ns)
+        , m_value(value)
+        , m_batch(batch)
     {
-        return JsString::from_v8(v8obj->ToString());
+        NullSink start;
+        if (m_value)
+            m_walk.reset(m_value->walk(start));
     }
-    else if (v8obj->IsArray())
+};
+
+/// times one call into its latency histogram, the slowlog, the trace and
+/// the usdt probes when any of them is on. the operation fills in size
+/// with the footprint of the value
+class OpScope
+{
+    Histogram* m_hist;
+    SlowLog* m_log;
+    TraceWriter* m_trace;
+    Store::Op m_op;
+    int64_t m_key;
+    bool m_timed;
+    uint64_t m_start;
+
+public:
+    Footprint size;
+
+    OpScope(const Store& store, Store::Op op, int64_t key, Histogram OpLatency::*hist = 0)
+        : m_hist((store.latency() && hist) ? &(store.latency()->*hist) : 0)
+        , m_log(store.slowlog())
+        , m_trace(store.trace())
+        , m_op(op)
+        , m_key(key)
+        , m_timed(m_hist || m_log || m_trace || BYPASS_PROBE_ENABLED(op__done))
+        , m_start(m_timed ? now_ns() : 0)
     {
-        return JsArray::from_v8(v8obj->ToObject());
+        if (BYPASS_PROBE_ENABLED(op__start))
+            BYPASS_PROBE2(op__start, Store::op_name(m_op), m_key);
     }
-    else if (v8obj->IsObject())
+
+    ~OpScope()
     {
-        return JsObj::from_v8(v8obj->ToObject());
+        if (!m_timed)
+            return;
+
+        const uint64_t end = now_ns();
+        const uint64_t duration = end - m_start;
+        if (m_hist)
+            m_hist->record(duration);
+        if (m_log && m_log->wants(duration, size))
+            m_log->record(Store::op_name(m_op), m_key, size, duration);
+        if (m_trace)
+            m_trace->record(m_op, m_key, size.bytes, end);
+
+        if (BYPASS_PROBE_ENABLED(op__done))
+            BYPASS_PROBE5(op__done, Store::op_name(m_op), m_key, size.bytes, size.nodes, duration);
     }
+};
 
-    return shared_ptr<JsUndefined>(new JsUndefined());
-}
+/// class id of BypassStore wrappers for the heap profiler
+const uint16_t kStoreClassId = 0xb1a5;
+
+/// native memory behind a BypassStore wrapper as seen in heap snapshots
+/// the label breaks the size down by kind of top level value
+class StoreInfo : public RetainedObjectInfo
+{
+    const Store* m_store;
+    std::string m_label;
+    intptr_t m_bytes;
+    intptr_t m_count;
+
+public:
+    StoreInfo(const Store& store)
+        : m_store(&store)
+        , m_bytes(store.bytes() + store.index_bytes() + store.secondary_bytes())
+        , m_count(store.size())
+    {
+        char buff[64];
+        m_label = "BypassStore " + store.name() + " (";
+        snprintf(buff, sizeof(buff), "index %lu", (unsigned long)store.index_bytes());
+        m_label += buff;
+
+        if (const size_t secondary = store.secondary_bytes())
+        {
+            snprintf(buff, sizeof(buff), ", secondary %lu", (unsigned long)secondary);
+            m_label += buff;
+        }
+
+        for (int k=0 ; k<JsValue::KIND_COUNT ; ++k)
+        {
+            const JsValue::Kind kind = JsValue::Kind(k);
+            if (!store.count(kind))
+                continue;
+
+            snprintf(buff, sizeof(buff), ", %lu %s %lu", (unsigned long)store.count(kind),
+                     JsValue::kind_name(kind), (unsigned long)store.bytes(kind));
+            m_label += buff;
+        }
+        m_label += " bytes)";
+    }
+
+    virtual void Dispose()
+    {
+        delete this;
+    }
+
+    virtual bool IsEquivalent(RetainedObjectInfo* other)
+    {
+        return GetHash() == other->GetHash() && !strcmp(GetLabel(), other->GetLabel());
+    }
+
+    virtual intptr_t GetHash() { return intptr_t(m_store); }
+    virtual const char* GetLabel() { return m_label.c_str(); }
+    virtual const char* GetGroupLabel() { return "BypassStore"; }
+    virtual intptr_t GetElementCount() { return m_count; }
+    virtual intptr_t GetSizeInBytes() { return m_bytes; }
+};
 
 class BypassStore : ObjectWrap
 {
-    typedef std::map<int64_t, shared_ptr<JsValue> > CacheMap;
-    CacheMap m_cache;
+    Store m_store;
 
 public:
     static void Init(Handle<Object> target)
@@ -272,6 +702,8 @@ public:
 
         HandleScope scope;
 
+        SlicedRead::init();
+
         Local<FunctionTemplate> t = FunctionTemplate::New(New);
 
         ft = Persistent<FunctionTemplate>::New(t);
@@ -280,21 +712,227 @@ public:
 
         NODE_SET_PROTOTYPE_METHOD(ft, "set", Set);
         NODE_SET_PROTOTYPE_METHOD(ft, "get", Get);
+        NODE_SET_PROTOTYPE_METHOD(ft, "getIncremental", GetIncremental);
+        NODE_SET_PROTOTYPE_METHOD(ft, "getStream", GetStream);
         NODE_SET_PROTOTYPE_METHOD(ft, "del", Del);
         NODE_SET_PROTOTYPE_METHOD(ft, "list", List);
+        NODE_SET_PROTOTYPE_METHOD(ft, "append", Append);
+        NODE_SET_PROTOTYPE_METHOD(ft, "rpush", Append);
+        NODE_SET_PROTOTYPE_METHOD(ft, "lpush", LPush);
+        NODE_SET_PROTOTYPE_METHOD(ft, "lpop", LPop);
+        NODE_SET_PROTOTYPE_METHOD(ft, "rpop", RPop);
+        NODE_SET_PROTOTYPE_METHOD(ft, "hset", HSet);
+        NODE_SET_PROTOTYPE_METHOD(ft, "hget", HGet);
+        NODE_SET_PROTOTYPE_METHOD(ft, "hdel", HDel);
+        NODE_SET_PROTOTYPE_METHOD(ft, "zadd", ZAdd);
+        NODE_SET_PROTOTYPE_METHOD(ft, "zrem", ZRem);
+        NODE_SET_PROTOTYPE_METHOD(ft, "zrank", ZRank);
+        NODE_SET_PROTOTYPE_METHOD(ft, "zscore", ZScore);
+        NODE_SET_PROTOTYPE_METHOD(ft, "zrange", ZRange);
+        NODE_SET_PROTOTYPE_METHOD(ft, "bitmapAdd", BitmapAdd);
+        NODE_SET_PROTOTYPE_METHOD(ft, "bitmapRemove", BitmapRemove);
+        NODE_SET_PROTOTYPE_METHOD(ft, "bitmapContains", BitmapContains);
+        NODE_SET_PROTOTYPE_METHOD(ft, "bitmapCount", BitmapCount);
+        NODE_SET_PROTOTYPE_METHOD(ft, "bitmapToArray", BitmapToArray);
+        NODE_SET_PROTOTYPE_METHOD(ft, "bitmapAnd", BitmapAnd);
+        NODE_SET_PROTOTYPE_METHOD(ft, "bitmapOr", BitmapOr);
+        NODE_SET_PROTOTYPE_METHOD(ft, "bitmapAndNot", BitmapAndNot);
+        NODE_SET_PROTOTYPE_METHOD(ft, "pfadd", PfAdd);
+        NODE_SET_PROTOTYPE_METHOD(ft, "pfcount", PfCount);
+        NODE_SET_PROTOTYPE_METHOD(ft, "pfmerge", PfMerge);
+        NODE_SET_PROTOTYPE_METHOD(ft, "cmsInit", CmsInit);
+        NODE_SET_PROTOTYPE_METHOD(ft, "cmsIncr", CmsIncr);
+        NODE_SET_PROTOTYPE_METHOD(ft, "cmsQuery", CmsQuery);
+        NODE_SET_PROTOTYPE_METHOD(ft, "cmsMerge", CmsMerge);
+        NODE_SET_PROTOTYPE_METHOD(ft, "createTextIndex", CreateTextIndex);
+        NODE_SET_PROTOTYPE_METHOD(ft, "search", Search);
+        NODE_SET_PROTOTYPE_METHOD(ft, "createVectorIndex", CreateVectorIndex);
+        NODE_SET_PROTOTYPE_METHOD(ft, "nearest", Nearest);
+        NODE_SET_PROTOTYPE_METHOD(ft, "createStringIndex", CreateStringIndex);
+        NODE_SET_PROTOTYPE_METHOD(ft, "lookup", Lookup);
+        NODE_SET_PROTOTYPE_METHOD(ft, "scanPrefix", ScanPrefix);
+        NODE_SET_PROTOTYPE_METHOD(ft, "scanRange", ScanRange);
+        NODE_SET_PROTOTYPE_METHOD(ft, "dropIndex", DropIndex);
+        NODE_SET_PROTOTYPE_METHOD(ft, "appendPoints", AppendPoints);
+        NODE_SET_PROTOTYPE_METHOD(ft, "range", Range);
+        NODE_SET_PROTOTYPE_METHOD(ft, "latency", Latency);
+        NODE_SET_PROTOTYPE_METHOD(ft, "slowlog", Slowlog);
+        NODE_SET_PROTOTYPE_METHOD(ft, "bigKeys", BigKeys);
+        NODE_SET_PROTOTYPE_METHOD(ft, "hotKeys", HotKeysList);
+        NODE_SET_PROTOTYPE_METHOD(ft, "stats", Stats);
+        NODE_SET_PROTOTYPE_METHOD(ft, "trace", Trace);
+        NODE_SET_PROTOTYPE_METHOD(ft, "metrics", Metrics);
+        NODE_SET_PROTOTYPE_METHOD(ft, "freeze", Freeze);
+        NODE_SET_PROTOTYPE_METHOD(ft, "close", Close);
 
         target->Set(String::NewSymbol("BypassStore"), ft->GetFunction());
+        HeapProfiler::DefineWrapperClass(kStoreClassId, WrapperInfo);
+        NODE_SET_METHOD(target, "metrics", AllMetrics);
     }
 
 private:
+    BypassStore(const shared_ptr<const RecordLayout>& layout, Store::KeyMode key_mode)
+        : m_store(layout, key_mode)
+    {}
+
     static Handle<Value> New(const Arguments& args)
     {
         HandleScope scope;
-        BypassStore* store = new BypassStore();
+
+        shared_ptr<RecordLayout> layout;
+        if (args[0]->IsObject())
+        {
+            Local<Value> schema = args[0]->ToObject()->Get(String::NewSymbol("schema"));
+            if (schema->IsObject())
+            {
+                layout = schema_layout(schema->ToObject());
+                if (!layout)
+                    return ThrowException(Exception::TypeError(
+                        String::New("schema field types must be 'number' or 'string'")));
+            }
+        }
+
+        // keys: 'auto' (default) switches to a directly indexed array once
+        // the keys are found to be mostly 0..n, 'dense' starts with it
+        Store::KeyMode key_mode = Store::KEYS_AUTO;
+        if (args[0]->IsObject())
+        {
+            const Local<Value> keys = args[0]->ToObject()->Get(String::NewSymbol("keys"));
+            if (!keys->IsUndefined())
+            {
+                const std::string mode = utf8(keys);
+                if (mode == "dense")
+                    key_mode = Store::KEYS_DENSE;
+                else if (mode == "sparse")
+                    key_mode = Store::KEYS_SPARSE;
+                else if (mode != "auto")
+                    return ThrowException(Exception::TypeError(
+                        String::New("keys must be 'auto', 'dense' or 'sparse'")));
+            }
+        }
+
+        // hotKeys: true or the number of counters to keep
+        size_t hot_keys = 0;
+
+        // mrc: true or {rate, maxKeys}
+        double mrc_rate = 0;
+        size_t mrc_keys = 0;
+
+        if (args[0]->IsObject())
+        {
+            const Local<Object> opts = args[0]->ToObject();
+
+            const Local<Value> hot = opts->Get(String::NewSymbol("hotKeys"));
+            if (hot->IsNumber())
+            {
+                const double n = hot->NumberValue();
+                if (!(n >= 1 && n <= double(HotKeys::kMaxCapacity)))
+                    return ThrowException(Exception::RangeError(
+                        String::New("hotKeys must be between 1 and 16777216")));
+                hot_keys = size_t(n);
+            }
+            else if (hot->BooleanValue())
+            {
+                hot_keys = 1024;
+            }
+
+            const Local<Value> mrc = opts->Get(String::NewSymbol("mrc"));
+            if (mrc->IsObject())
+            {
+                const Local<Object> o = mrc->ToObject();
+                const Local<Value> rate = o->Get(String::NewSymbol("rate"));
+                const Local<Value> max_keys = o->Get(String::NewSymbol("maxKeys"));
+                mrc_rate = rate->IsUndefined() ? 0.01 : rate->NumberValue();
+                const double n = max_keys->IsUndefined() ? 8192 : max_keys->NumberValue();
+                if (!(mrc_rate > 0 && mrc_rate <= 1))
+                    return ThrowException(Exception::RangeError(
+                        String::New("mrc.rate must be above 0 and at most 1")));
+                if (!(n >= 1 && n <= double(MissRatioCurve::kMaxKeys)))
+                    return ThrowException(Exception::RangeError(
+                        String::New("mrc.maxKeys must be between 1 and 4194304")));
+                mrc_keys = size_t(n);
+            }
+            else if (mrc->BooleanValue())
+            {
+                mrc_rate = 0.01;
+                mrc_keys = 8192;
+            }
+        }
+
+        BypassStore* store = new BypassStore(layout, key_mode);
+        if (args[0]->IsObject())
+        {
+            const Local<Object> opts = args[0]->ToObject();
+            store->m_store.enable_latency(opts->Get(String::NewSymbol("latency"))->BooleanValue());
+
+            Local<Value> name = opts->Get(String::NewSymbol("name"));
+            if (name->IsString())
+            {
+                String::Utf8Value n(name);
+                store->m_store.set_name(std::string(*n, n.length()));
+            }
+
+            Local<Value> slowlog = opts->Get(String::NewSymbol("slowlog"));
+            if (slowlog->IsObject())
+                store->configure_slowlog(slowlog->ToObject());
+            else if (slowlog->BooleanValue())
+                store->m_store.enable_slowlog(true);
+
+            store->m_store.enable_profile(opts->Get(String::NewSymbol("profile"))->BooleanValue());
+
+            if (hot_keys)
+                store->m_store.enable_hot_keys(hot_keys);
+            if (mrc_keys)
+                store->m_store.enable_mrc(mrc_rate, mrc_keys);
+        }
         store->Wrap(args.This());
+        store->handle_.SetWrapperClassId(kStoreClassId);
         return args.This();
     }
 
+    /// called by the heap profiler for every wrapper with kStoreClassId
+    static RetainedObjectInfo* WrapperInfo(uint16_t class_id, Handle<Value> wrapper)
+    {
+        if (class_id != kStoreClassId)
+            return 0;
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(wrapper->ToObject());
+        return new StoreInfo(store->m_store);
+    }
+
+    /// build the layout from {field: 'number' | 'string', ...}
+    /// returns an empty pointer if a field has an unknown type
+    static shared_ptr<RecordLayout> schema_layout(const Local<Object> schema)
+    {
+        shared_ptr<RecordLayout> out = RecordLayout::create();
+
+        Local<Array> names = schema->GetPropertyNames();
+        const uint32_t length = names->Length();
+        for (uint32_t i=0 ; i<length ; ++i)
+        {
+            Local<Value> k = names->Get(i);
+
+            String::Utf8Value name(k);
+            String::AsciiValue type(schema->Get(k));
+            const std::string t(*type, type.length());
+
+            if (t == "number")
+                out->add(std::string(*name, name.length()), RecordLayout::NUMBER);
+            else if (t == "string")
+                out->add(std::string(*name, name.length()), RecordLayout::STRING);
+            else
+                return shared_ptr<RecordLayout>();
+        }
+
+        return out;
+    }
+
+    /// thrown by writes to a store after freeze()
+    static Handle<Value> frozen_error()
+    {
+        return ThrowException(Exception::Error(String::New("store is frozen")));
+    }
+
     /// load data infor your buffer
     static Handle<Value> Set(const Arguments& args)
     {
@@ -306,7 +944,17 @@ private:
         const int64_t k = key->IntegerValue();
 
         BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
-        store->m_cache[k] = from_v8(val);
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_SET, k, &OpLatency::set);
+        store->m_store.touch(k);
+
+        V8Source in(val);
+        const Store::Entry& e = store->m_store.set(k, store->m_store.encode(in));
+        op.size = e.size;
+
+        if (OpLatency* latency = store->m_store.latency())
+            latency->encode_bytes.record(e.size.bytes);
 
         return scope.Close(Handle<Value>());
     }
@@ -320,38 +968,1875 @@ private:
         const int64_t k = key->IntegerValue();
 
         BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
-        CacheMap::const_iterator iter = store->m_cache.find(k);
+        OpScope op(store->m_store, Store::OP_GET, k, &OpLatency::get);
+        store->m_store.touch(k);
+
+        const Store::Entry* e = store->m_store.lookup(k);
 
-        if (iter == store->m_cache.end())
+        if (!e)
             return Undefined();
 
-        return scope.Close(iter->second->to_v8());
+        op.size = e->size;
+
+        V8Sink out;
+        store->m_store.emit(*e, out);
+
+        if (OpLatency* latency = store->m_store.latency())
+            latency->decode_bytes.record(e->size.bytes);
+
+        return scope.Close(out.result());
     }
 
-    static Handle<Value> Del(const Arguments& args)
+    /// reads the optional {budgetMs, batchSize} in front of the callback
+    /// returns an empty handle when the last argument is not a function
+    static Local<Function> sliced_args(const Arguments& args, uint64_t& budget_ns, uint32_t& batch)
     {
-        HandleScope scope;
-
-        const Handle<Value> key = args[0];
-        const int64_t k = key->IntegerValue();
+        budget_ns = 4000000;
+        batch = 1024;
 
-        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
-        store->m_cache.erase(k);
+        if (args.Length() > 2 && args[1]->IsObject())
+        {
+            const Local<Object> opts = args[1]->ToObject();
+            const Local<Value> budget = opts->Get(String::NewSymbol("budgetMs"));
+            if (budget->IsNumber() && budget->NumberValue() > 0)
+                budget_ns = uint64_t(budget->NumberValue() * 1e6);
+
+            const Local<Value> size = opts->Get(String::NewSymbol("batchSize"));
+            if (size->IsNumber() && size->Uint32Value() > 0)
+                batch = size->Uint32Value();
+        }
 
-        return scope.Close(Handle<Value>());
+        const Local<Value> cb = args[args.Length() - 1];
+        if (args.Length() < 2 || !cb->IsFunction())
+            return Local<Function>();
+        return Local<Function>::Cast(cb);
     }
 
-    static Handle<Value> List(const Arguments& args)
+    /// get without blocking the event loop on huge values
+    /// getIncremental(key, [{budgetMs}], cb)
+    /// decodes for at most budgetMs per turn and calls cb(null, value) when
+    /// done. the value read is the one stored at the call, later sets and
+    /// dels of the key do not affect it
+    static Handle<Value> GetIncremental(const Arguments& args)
     {
         HandleScope scope;
 
-        Local<Array> arr = Array::New();
+        uint64_t budget;
+        uint32_t batch;
+        const Local<Function> cb = sliced_args(args, budget, batch);
+        if (cb.IsEmpty())
+            return ThrowException(Exception::TypeError(String::New("callback required")));
+
+        const int64_t k = args[0]->IntegerValue();
 
         BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
-        CacheMap::const_iterator iter = store->m_cache.begin();
-        for (uint32_t i=0; iter != store->m_cache.end() ; ++iter, ++i)
+        OpScope op(store->m_store, Store::OP_GET, k);
+        store->m_store.touch(k);
+
+        shared_ptr<JsValue> value;
+        if (const Store::Entry* e = store->m_store.lookup(k))
+        {
+            op.size = e->size;
+            value = e->value;
+        }
+
+        (new IncrementalRead(value, cb, budget))->schedule();
+        return Undefined();
+    }
+
+    /// the elements of an array value in batches
+    /// getStream(key, [{batchSize, budgetMs}], cb)
+    /// calls cb(null, elements, done) once per turn with up to batchSize
+    /// elements, stopping a batch early once budgetMs is spent
+    static Handle<Value> GetStream(const Arguments& args)
+    {
+        HandleScope scope;
+
+        uint64_t budget;
+        uint32_t batch;
+        const Local<Function> cb = sliced_args(args, budget, batch);
+        if (cb.IsEmpty())
+            return ThrowException(Exception::TypeError(String::New("callback required")));
+
+        const int64_t k = args[0]->IntegerValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        OpScope op(store->m_store, Store::OP_GET, k);
+        store->m_store.touch(k);
+
+        shared_ptr<JsValue> value;
+        if (const Store::Entry* e = store->m_store.lookup(k))
+        {
+            if (e->value->kind() != JsValue::KIND_ARRAY)
+                return ThrowException(Exception::TypeError(
+                    String::New("key does not hold an array")));
+
+            op.size = e->size;
+            value = e->value;
+        }
+
+        (new StreamRead(value, cb, budget, batch))->schedule();
+        return Undefined();
+    }
+
+    static Handle<Value> Del(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const Handle<Value> key = args[0];
+        const int64_t k = key->IntegerValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_DEL, k, &OpLatency::del);
+
+        store->m_store.del(k, op.size);
+
+        return scope.Close(Handle<Value>());
+    }
+
+    static Handle<Value> List(const Arguments& args)
+    {
+        HandleScope scope;
+
+        Local<Array> arr = Array::New();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        OpScope op(store->m_store, Store::OP_LIST, 0, &OpLatency::list);
+
+        Store::Cursor c(store->m_store);
+        for (uint32_t i=0 ; c.next() ; ++i)
+        {
+            arr->Set(i, Int32::New(c.key()));
+        }
+
+        return scope.Close(arr);
+    }
+
+    /// the value of type T at key, ready to be changed in place
+    /// entry is the key's entry or 0 to create a new T. a value a sliced
+    /// read still holds is copied first so the read sees it unchanged.
+    /// empty when the key holds another type
+    template <class T>
+    shared_ptr<T> writable(int64_t k, Store::Entry*& entry)
+    {
+        if (!entry)
+        {
+            const shared_ptr<T> out(new T());
+            entry = &m_store.set(k, out);
+            return out;
+        }
+
+        const bool shared = !entry->value.unique();
+        shared_ptr<T> out = dynamic_pointer_cast<T>(entry->value);
+        if (out && shared)
+        {
+            out.reset(new T(*out));
+            entry = &m_store.set(k, out);
+        }
+        return out;
+    }
+
+    /// the value at key as a T for reading, 0 when missing
+    /// wrong is set when the key holds something else
+    template <class T>
+    static const T* typed(Store& store, int64_t k, OpScope& op, bool& wrong)
+    {
+        store.touch(k);
+
+        wrong = false;
+        const Store::Entry* e = store.lookup(k);
+        if (!e)
+            return 0;
+
+        op.size = e->size;
+        const T* out = dynamic_cast<const T*>(e->value.get());
+        wrong = !out;
+        return out;
+    }
+
+    /// same as writable<JsList> but an array stored by set is turned into
+    /// a list, after that it grows and shrinks in place
+    shared_ptr<JsList> writable_list(int64_t k, Store::Entry*& entry)
+    {
+        shared_ptr<JsList> out = writable<JsList>(k, entry);
+        if (!out && entry->value->kind() == JsValue::KIND_ARRAY)
+        {
+            out = JsList::from(*entry->value);
+            entry = &m_store.set(k, out);
+        }
+        return out;
+    }
+
+    /// field names and members are strings
+    static std::string utf8(const Handle<Value> val)
+    {
+        String::Utf8Value s(val);
+        return std::string(*s, s.length());
+    }
+
+    /// extend the array stored at key without rewriting it
+    /// append(key, [items...], [{maxLength}])
+    /// creates the array if missing and drops elements from the front past
+    /// maxLength so the array can serve as a ring buffer. returns the length
+    static Handle<Value> Append(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        if (!args[1]->IsArray())
+            return ThrowException(Exception::TypeError(String::New("items must be an array")));
+
+        bool capped = false;
+        size_t max_length = 0;
+        if (args[2]->IsObject())
+        {
+            const Local<Value> max = args[2]->ToObject()->Get(String::NewSymbol("maxLength"));
+            if (!max->IsUndefined())
+            {
+                if (!max->IsNumber() || max->IntegerValue() < 0)
+                    return ThrowException(Exception::RangeError(
+                        String::New("maxLength must be a non-negative number")));
+                capped = true;
+                max_length = size_t(max->IntegerValue());
+            }
+        }
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_APPEND, k);
+        store->m_store.touch(k);
+
+        Store::Entry* entry = store->m_store.find(k);
+        const shared_ptr<JsList> list = store->writable_list(k, entry);
+        if (!list)
+            return ThrowException(Exception::TypeError(String::New("key does not hold an array")));
+
+        V8Source in(args[1]);
+        const shared_ptr<JsArray> items = dynamic_pointer_cast<JsArray>(store->m_store.encode(in));
+
+        Footprint added;
+        Footprint removed;
+        for (size_t i=0 ; i<items->elements().size() ; ++i)
+            list->push_back(items->elements()[i], added);
+        if (capped)
+            list->trim_front(max_length, removed);
+
+        store->m_store.resized(*entry, added, removed);
+        store->m_store.changed(k, *entry);
+        op.size = entry->size;
+
+        return scope.Close(Integer::NewFromUnsigned(list->size()));
+    }
+
+    /// add items to the front of the array at key keeping their order
+    /// lpush(key, [items...]) returns the length, rpush is append
+    static Handle<Value> LPush(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        if (!args[1]->IsArray())
+            return ThrowException(Exception::TypeError(String::New("items must be an array")));
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_MODIFY, k);
+        store->m_store.touch(k);
+
+        Store::Entry* entry = store->m_store.find(k);
+        const shared_ptr<JsList> list = store->writable_list(k, entry);
+        if (!list)
+            return ThrowException(Exception::TypeError(String::New("key does not hold an array")));
+
+        V8Source in(args[1]);
+        const shared_ptr<JsArray> items = dynamic_pointer_cast<JsArray>(store->m_store.encode(in));
+
+        Footprint added;
+        for (size_t i=items->elements().size() ; i>0 ; --i)
+            list->push_front(items->elements()[i - 1], added);
+
+        store->m_store.resized(*entry, added, Footprint());
+        store->m_store.changed(k, *entry);
+        op.size = entry->size;
+
+        return scope.Close(Integer::NewFromUnsigned(list->size()));
+    }
+
+    /// remove and return the first or last element of the array at key
+    /// undefined when the array is empty or missing
+    static Handle<Value> pop(const Arguments& args, bool front)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_MODIFY, k);
+        store->m_store.touch(k);
+
+        Store::Entry* entry = store->m_store.lookup(k);
+        if (!entry)
+            return Undefined();
+
+        const shared_ptr<JsList> list = store->writable_list(k, entry);
+        if (!list)
+            return ThrowException(Exception::TypeError(String::New("key does not hold an array")));
+        if (list->size() == 0)
+            return Undefined();
+
+        Footprint removed;
+        const shared_ptr<JsValue> val = front ? list->pop_front(removed) : list->pop_back(removed);
+        store->m_store.resized(*entry, Footprint(), removed);
+        store->m_store.changed(k, *entry);
+        op.size = entry->size;
+
+        V8Sink out;
+        val->emit(out);
+        return scope.Close(out.result());
+    }
+
+    /// lpop(key)
+    static Handle<Value> LPop(const Arguments& args)
+    {
+        return pop(args, true);
+    }
+
+    /// rpop(key)
+    static Handle<Value> RPop(const Arguments& args)
+    {
+        return pop(args, false);
+    }
+
+    /// set one field of the hash at key, creating the hash if missing
+    /// hset(key, field, value) returns true if the field is new
+    static Handle<Value> HSet(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_MODIFY, k);
+        store->m_store.touch(k);
+
+        Store::Entry* entry = store->m_store.find(k);
+        const shared_ptr<JsHash> hash = store->writable<JsHash>(k, entry);
+        if (!hash)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a hash")));
+
+        V8Source in(args[2]);
+        const bool created = hash->set(utf8(args[1]), store->m_store.encode(in));
+
+        store->m_store.resized(*entry);
+        store->m_store.changed(k, *entry);
+        op.size = entry->size;
+
+        return scope.Close(Boolean::New(created));
+    }
+
+    /// value of one field of the hash at key
+    /// hget(key, field) returns undefined if the key or field is missing
+    static Handle<Value> HGet(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        OpScope op(store->m_store, Store::OP_READ, k);
+        store->m_store.touch(k);
+
+        const Store::Entry* e = store->m_store.lookup(k);
+        if (!e)
+            return Undefined();
+
+        const JsHash* hash = dynamic_cast<const JsHash*>(e->value.get());
+        if (!hash)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a hash")));
+
+        const JsValue* val = hash->get(utf8(args[1]));
+        if (!val)
+            return Undefined();
+
+        val->measure(op.size);
+
+        V8Sink out;
+        val->emit(out);
+        return scope.Close(out.result());
+    }
+
+    /// remove one field of the hash at key
+    /// hdel(key, field) returns true if the field was there
+    static Handle<Value> HDel(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_MODIFY, k);
+        store->m_store.touch(k);
+
+        Store::Entry* entry = store->m_store.find(k);
+        if (!entry)
+            return scope.Close(False());
+
+        const shared_ptr<JsHash> hash = store->writable<JsHash>(k, entry);
+        if (!hash)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a hash")));
+
+        const bool removed = hash->del(utf8(args[1]));
+
+        store->m_store.resized(*entry);
+        store->m_store.changed(k, *entry);
+        op.size = entry->size;
+
+        return scope.Close(Boolean::New(removed));
+    }
+
+    /// add a member to the sorted set at key or change its score
+    /// zadd(key, score, member) returns true if the member is new
+    static Handle<Value> ZAdd(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        if (!args[1]->IsNumber())
+            return ThrowException(Exception::TypeError(String::New("score must be a number")));
+
+        const double score = args[1]->NumberValue();
+        if (score != score)
+            return ThrowException(Exception::RangeError(String::New("score must not be NaN")));
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_MODIFY, k);
+        store->m_store.touch(k);
+
+        Store::Entry* entry = store->m_store.find(k);
+        const shared_ptr<JsSortedSet> set = store->writable<JsSortedSet>(k, entry);
+        if (!set)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a sorted set")));
+
+        const bool created = set->add(utf8(args[2]), score);
+
+        store->m_store.resized(*entry);
+        store->m_store.changed(k, *entry);
+        op.size = entry->size;
+
+        return scope.Close(Boolean::New(created));
+    }
+
+    /// zrem(key, member) returns true if the member was there
+    static Handle<Value> ZRem(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_MODIFY, k);
+        store->m_store.touch(k);
+
+        Store::Entry* entry = store->m_store.find(k);
+        if (!entry)
+            return scope.Close(False());
+
+        const shared_ptr<JsSortedSet> set = store->writable<JsSortedSet>(k, entry);
+        if (!set)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a sorted set")));
+
+        const bool removed = set->remove(utf8(args[1]));
+
+        store->m_store.resized(*entry);
+        store->m_store.changed(k, *entry);
+        op.size = entry->size;
+
+        return scope.Close(Boolean::New(removed));
+    }
+
+    /// 0 based position of member in score order
+    /// zrank(key, member) returns undefined if the key or member is missing
+    static Handle<Value> ZRank(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        OpScope op(store->m_store, Store::OP_READ, k);
+
+        bool wrong;
+        const JsSortedSet* set = typed<JsSortedSet>(store->m_store, k, op, wrong);
+        if (wrong)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a sorted set")));
+
+        uint32_t rank;
+        if (!set || !set->rank(utf8(args[1]), rank))
+            return Undefined();
+
+        return scope.Close(Integer::NewFromUnsigned(rank));
+    }
+
+    /// zscore(key, member) returns undefined if the key or member is missing
+    static Handle<Value> ZScore(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        OpScope op(store->m_store, Store::OP_READ, k);
+
+        bool wrong;
+        const JsSortedSet* set = typed<JsSortedSet>(store->m_store, k, op, wrong);
+        if (wrong)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a sorted set")));
+
+        double score;
+        if (!set || !set->score(utf8(args[1]), score))
+            return Undefined();
+
+        return scope.Close(Number::New(score));
+    }
+
+    /// members by rank in score order, negative ranks count from the end
+    /// zrange(key, start, stop, [{withScores}]) includes stop, with scores
+    /// the result is [member, score, member, score, ...]
+    static Handle<Value> ZRange(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+        const int64_t start = args[1]->IsUndefined() ? 0 : args[1]->IntegerValue();
+        const int64_t stop = args[2]->IsUndefined() ? -1 : args[2]->IntegerValue();
+        const bool with_scores = args[3]->IsObject() &&
+            args[3]->ToObject()->Get(String::NewSymbol("withScores"))->BooleanValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        OpScope op(store->m_store, Store::OP_READ, k);
+
+        bool wrong;
+        const JsSortedSet* set = typed<JsSortedSet>(store->m_store, k, op, wrong);
+        if (wrong)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a sorted set")));
+        if (!set)
+            return scope.Close(Array::New());
+
+        V8Sink out;
+        set->range(start, stop, with_scores, out);
+        return scope.Close(out.result());
+    }
+
+    /// 32 bit ids from an array of numbers or a Uint32Array
+    /// false if one of them is not an unsigned 32 bit integer
+    static bool read_ids(const Handle<Value> val, std::vector<uint32_t>& out)
+    {
+        if (!val->IsObject())
+            return false;
+
+        const Local<Object> obj = val->ToObject();
+        if (obj->HasIndexedPropertiesInExternalArrayData() &&
+            obj->GetIndexedPropertiesExternalArrayDataType() == kExternalUnsignedIntArray)
+        {
+            const uint32_t* data = static_cast<const uint32_t*>(
+                obj->GetIndexedPropertiesExternalArrayData());
+            out.assign(data, data + obj->GetIndexedPropertiesExternalArrayDataLength());
+            return true;
+        }
+
+        if (!val->IsArray())
+            return false;
+
+        const Local<Array> arr = Local<Array>::Cast(val);
+        const uint32_t length = arr->Length();
+        out.reserve(length);
+        for (uint32_t i=0 ; i<length ; ++i)
+        {
+            const Local<Value> id = arr->Get(i);
+            if (!id->IsUint32())
+                return false;
+            out.push_back(id->Uint32Value());
+        }
+        return true;
+    }
+
+    /// the values of a bitmap as a Uint32Array, or an array where node has
+    /// no typed arrays
+    static Local<Value> ids_to_v8(const JsBitmap* bitmap)
+    {
+        const uint32_t length = bitmap ? uint32_t(bitmap->cardinality()) : 0;
+
+        const Local<Value> ctor = Context::GetCurrent()->Global()->Get(String::NewSymbol("Uint32Array"));
+        if (!ctor->IsFunction())
+        {
+            if (!bitmap)
+                return Array::New();
+
+            V8Sink out;
+            bitmap->emit(out);
+            return Local<Value>::New(out.result());
+        }
+
+        Handle<Value> argv[1] = { Integer::NewFromUnsigned(length) };
+        const Local<Object> out = Local<Function>::Cast(ctor)->NewInstance(1, argv);
+        if (length)
+            bitmap->values(static_cast<uint32_t*>(out->GetIndexedPropertiesExternalArrayData()));
+        return out;
+    }
+
+    /// add or remove ids of the bitmap at key, creating it if missing
+    static Handle<Value> change_ids(const Arguments& args, bool add)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        std::vector<uint32_t> ids;
+        if (!read_ids(args[1], ids))
+            return ThrowException(Exception::TypeError(
+                String::New("ids must be an array of unsigned 32 bit integers or a Uint32Array")));
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_MODIFY, k);
+        store->m_store.touch(k);
+
+        Store::Entry* entry = store->m_store.find(k);
+        if (!entry && !add)
+            return scope.Close(Integer::New(0));
+
+        const shared_ptr<JsBitmap> bitmap = store->writable<JsBitmap>(k, entry);
+        if (!bitmap)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a bitmap")));
+
+        uint32_t changed = 0;
+        for (size_t i=0 ; i<ids.size() ; ++i)
+            changed += add ? bitmap->add(ids[i]) : bitmap->remove(ids[i]);
+
+        store->m_store.resized(*entry);
+        store->m_store.changed(k, *entry);
+        op.size = entry->size;
+
+        return scope.Close(Integer::NewFromUnsigned(changed));
+    }
+
+    /// bitmapAdd(key, ids) returns how many were not there
+    static Handle<Value> BitmapAdd(const Arguments& args)
+    {
+        return change_ids(args, true);
+    }
+
+    /// bitmapRemove(key, ids) returns how many were there
+    static Handle<Value> BitmapRemove(const Arguments& args)
+    {
+        return change_ids(args, false);
+    }
+
+    /// bitmapContains(key, id)
+    static Handle<Value> BitmapContains(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        OpScope op(store->m_store, Store::OP_READ, k);
+
+        bool wrong;
+        const JsBitmap* b = typed<JsBitmap>(store->m_store, k, op, wrong);
+        if (wrong)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a bitmap")));
+
+        return scope.Close(Boolean::New(b && args[1]->IsUint32() && b->contains(args[1]->Uint32Value())));
+    }
+
+    /// bitmapCount(key) returns the number of ids, 0 if missing
+    static Handle<Value> BitmapCount(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        OpScope op(store->m_store, Store::OP_READ, k);
+
+        bool wrong;
+        const JsBitmap* b = typed<JsBitmap>(store->m_store, k, op, wrong);
+        if (wrong)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a bitmap")));
+
+        return scope.Close(Number::New(b ? double(b->cardinality()) : 0));
+    }
+
+    /// bitmapToArray(key) returns the ids in ascending order as a Uint32Array
+    static Handle<Value> BitmapToArray(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        OpScope op(store->m_store, Store::OP_READ, k);
+
+        bool wrong;
+        const JsBitmap* b = typed<JsBitmap>(store->m_store, k, op, wrong);
+        if (wrong)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a bitmap")));
+
+        return scope.Close(ids_to_v8(b));
+    }
+
+    /// a op b of the bitmaps at two keys, a missing key is an empty bitmap
+    /// with a dest key the result is stored there and its size returned,
+    /// otherwise the ids are returned as a Uint32Array
+    static Handle<Value> combine_bitmaps(const Arguments& args, JsBitmap::SetOp op_kind)
+    {
+        HandleScope scope;
+
+        const int64_t ka = args[0]->IntegerValue();
+        const int64_t kb = args[1]->IntegerValue();
+        const bool store_result = args[2]->IsNumber();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store_result && store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, store_result ? Store::OP_SET : Store::OP_READ,
+                   store_result ? args[2]->IntegerValue() : ka);
+
+        bool wrong_a;
+        bool wrong_b;
+        const JsBitmap* a = typed<JsBitmap>(store->m_store, ka, op, wrong_a);
+        const JsBitmap* b = typed<JsBitmap>(store->m_store, kb, op, wrong_b);
+        if (wrong_a || wrong_b)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a bitmap")));
+
+        const JsBitmap empty;
+        const shared_ptr<JsBitmap> result = JsBitmap::combine(op_kind, a ? *a : empty, b ? *b : empty);
+
+        if (!store_result)
+            return scope.Close(ids_to_v8(result.get()));
+
+        const int64_t dest = args[2]->IntegerValue();
+        store->m_store.touch(dest);
+        op.size = store->m_store.set(dest, result).size;
+        return scope.Close(Number::New(double(result->cardinality())));
+    }
+
+    /// bitmapAnd(a, b, [dest])
+    static Handle<Value> BitmapAnd(const Arguments& args)
+    {
+        return combine_bitmaps(args, JsBitmap::AND);
+    }
+
+    /// bitmapOr(a, b, [dest])
+    static Handle<Value> BitmapOr(const Arguments& args)
+    {
+        return combine_bitmaps(args, JsBitmap::OR);
+    }
+
+    /// bitmapAndNot(a, b, [dest]) the ids of a that are not in b
+    static Handle<Value> BitmapAndNot(const Arguments& args)
+    {
+        return combine_bitmaps(args, JsBitmap::ANDNOT);
+    }
+
+    /// sketches hash the string form of each item
+    static uint64_t item_hash(const Handle<Value> item)
+    {
+        String::Utf8Value s(item);
+        return sketch_hash(*s, s.length());
+    }
+
+    /// add items to the hyperloglog at key, creating it if missing
+    /// pfadd(key, [items...]) returns true if the estimate may have changed
+    static Handle<Value> PfAdd(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        if (!args[1]->IsArray())
+            return ThrowException(Exception::TypeError(String::New("items must be an array")));
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_MODIFY, k);
+        store->m_store.touch(k);
+
+        Store::Entry* entry = store->m_store.find(k);
+        const shared_ptr<JsHyperLogLog> hll = store->writable<JsHyperLogLog>(k, entry);
+        if (!hll)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a hyperloglog")));
+
+        const Local<Array> items = Local<Array>::Cast(args[1]);
+        bool changed = false;
+        for (uint32_t i=0 ; i<items->Length() ; ++i)
+            changed |= hll->add(item_hash(items->Get(i)));
+
+        op.size = entry->size;
+        return scope.Close(Boolean::New(changed));
+    }
+
+    /// fold the hyperloglogs at keys into out, false if one is something else
+    static bool union_hll(Store& store, const Local<Array> keys, OpScope& op, JsHyperLogLog& out)
+    {
+        for (uint32_t i=0 ; i<keys->Length() ; ++i)
+        {
+            bool wrong;
+            const JsHyperLogLog* hll = typed<JsHyperLogLog>(store, keys->Get(i)->IntegerValue(), op, wrong);
+            if (wrong)
+                return false;
+            if (hll)
+                out.merge(*hll);
+        }
+        return true;
+    }
+
+    /// distinct count estimate of one key or of the union of several
+    /// pfcount(key | [keys...])
+    static Handle<Value> PfCount(const Arguments& args)
+    {
+        HandleScope scope;
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+
+        if (args[0]->IsArray())
+        {
+            const Local<Array> keys = Local<Array>::Cast(args[0]);
+            OpScope op(store->m_store, Store::OP_READ, keys->Length() ? keys->Get(0)->IntegerValue() : 0);
+
+            JsHyperLogLog all;
+            if (!union_hll(store->m_store, keys, op, all))
+                return ThrowException(Exception::TypeError(String::New("key does not hold a hyperloglog")));
+            return scope.Close(Number::New(double(all.count())));
+        }
+
+        const int64_t k = args[0]->IntegerValue();
+        OpScope op(store->m_store, Store::OP_READ, k);
+
+        bool wrong;
+        const JsHyperLogLog* hll = typed<JsHyperLogLog>(store->m_store, k, op, wrong);
+        if (wrong)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a hyperloglog")));
+
+        return scope.Close(Number::New(hll ? double(hll->count()) : 0));
+    }
+
+    /// store the union of the hyperloglogs at keys and dest in dest
+    /// pfmerge(dest, [keys...])
+    static Handle<Value> PfMerge(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t dest = args[0]->IntegerValue();
+
+        if (!args[1]->IsArray())
+            return ThrowException(Exception::TypeError(String::New("keys must be an array")));
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_MODIFY, dest);
+
+        JsHyperLogLog all;
+        if (!union_hll(store->m_store, Local<Array>::Cast(args[1]), op, all))
+            return ThrowException(Exception::TypeError(String::New("key does not hold a hyperloglog")));
+
+        store->m_store.touch(dest);
+        Store::Entry* entry = store->m_store.find(dest);
+        const shared_ptr<JsHyperLogLog> hll = store->writable<JsHyperLogLog>(dest, entry);
+        if (!hll)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a hyperloglog")));
+
+        hll->merge(all);
+        op.size = entry->size;
+        return Undefined();
+    }
+
+    /// create a count-min sketch at key
+    /// cmsInit(key, {epsilon, delta} | {width, depth}) throws if key exists
+    static Handle<Value> CmsInit(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        if (!args[1]->IsObject())
+            return ThrowException(Exception::TypeError(String::New("options required")));
+
+        const Local<Object> opts = args[1]->ToObject();
+        const Local<Value> width = opts->Get(String::NewSymbol("width"));
+        const Local<Value> depth = opts->Get(String::NewSymbol("depth"));
+        const Local<Value> epsilon = opts->Get(String::NewSymbol("epsilon"));
+        const Local<Value> delta = opts->Get(String::NewSymbol("delta"));
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+
+        shared_ptr<JsCountMin> cms;
+        if (width->IsUint32() && depth->IsUint32() && width->Uint32Value() && depth->Uint32Value())
+        {
+            if (!JsCountMin::fits(width->Uint32Value(), depth->Uint32Value()))
+                return ThrowException(Exception::RangeError(
+                    String::New("width * depth must be at most 67108864")));
+            cms.reset(new JsCountMin(width->Uint32Value(), depth->Uint32Value()));
+        }
+        else if (epsilon->IsNumber() && delta->IsNumber())
+        {
+            const double e = epsilon->NumberValue();
+            const double d = delta->NumberValue();
+            if (!(e > 0 && e < 1) || !(d > 0 && d < 1))
+                return ThrowException(Exception::RangeError(
+                    String::New("epsilon and delta must be between 0 and 1")));
+            cms.reset(JsCountMin::create(e, d));
+            if (!cms)
+                return ThrowException(Exception::RangeError(
+                    String::New("epsilon and delta need more than 67108864 counters")));
+        }
+        else
+        {
+            return ThrowException(Exception::TypeError(
+                String::New("options need width and depth or epsilon and delta")));
+        }
+
+        if (store->m_store.find(k))
+            return ThrowException(Exception::Error(String::New("key already exists")));
+
+        OpScope op(store->m_store, Store::OP_SET, k);
+        store->m_store.touch(k);
+
+        op.size = store->m_store.set(k, cms).size;
+        return Undefined();
+    }
+
+    /// count items in the sketch at key, created with the defaults if missing
+    /// cmsIncr(key, [items...], [[counts...]]) counts default to 1
+    static Handle<Value> CmsIncr(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        if (!args[1]->IsArray())
+            return ThrowException(Exception::TypeError(String::New("items must be an array")));
+
+        const Local<Array> items = Local<Array>::Cast(args[1]);
+        const bool counted = args[2]->IsArray();
+        const Local<Array> counts = counted ? Local<Array>::Cast(args[2]) : Local<Array>();
+        if (counted && counts->Length() != items->Length())
+            return ThrowException(Exception::RangeError(
+                String::New("items and counts must have the same length")));
+        for (uint32_t i=0 ; counted && i<counts->Length() ; ++i)
+        {
+            if (!counts->Get(i)->IsUint32())
+                return ThrowException(Exception::RangeError(
+                    String::New("counts must be unsigned 32 bit integers")));
+        }
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_MODIFY, k);
+        store->m_store.touch(k);
+
+        Store::Entry* entry = store->m_store.find(k);
+        const shared_ptr<JsCountMin> cms = store->writable<JsCountMin>(k, entry);
+        if (!cms)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a count-min sketch")));
+
+        for (uint32_t i=0 ; i<items->Length() ; ++i)
+            cms->add(item_hash(items->Get(i)), counted ? counts->Get(i)->Uint32Value() : 1);
+
+        op.size = entry->size;
+        return Undefined();
+    }
+
+    /// frequency estimates of items, all 0 when the key is missing
+    /// cmsQuery(key, [items...])
+    static Handle<Value> CmsQuery(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        if (!args[1]->IsArray())
+            return ThrowException(Exception::TypeError(String::New("items must be an array")));
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        OpScope op(store->m_store, Store::OP_READ, k);
+
+        bool wrong;
+        const JsCountMin* cms = typed<JsCountMin>(store->m_store, k, op, wrong);
+        if (wrong)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a count-min sketch")));
+
+        const Local<Array> items = Local<Array>::Cast(args[1]);
+        Local<Array> out = Array::New(items->Length());
+        for (uint32_t i=0 ; i<items->Length() ; ++i)
+            out->Set(i, Integer::NewFromUnsigned(cms ? cms->estimate(item_hash(items->Get(i))) : 0));
+
+        return scope.Close(out);
+    }
+
+    /// add the sketches at keys to the one at dest, created like the first
+    /// cmsMerge(dest, [keys...]) all of them must have the same dimensions
+    static Handle<Value> CmsMerge(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t dest = args[0]->IntegerValue();
+
+        if (!args[1]->IsArray())
+            return ThrowException(Exception::TypeError(String::New("keys must be an array")));
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_MODIFY, dest);
+
+        // sum the sources first so a mismatch leaves dest untouched
+        const Local<Array> keys = Local<Array>::Cast(args[1]);
+        shared_ptr<JsCountMin> sum;
+        for (uint32_t i=0 ; i<keys->Length() ; ++i)
+        {
+            bool wrong;
+            const JsCountMin* cms = typed<JsCountMin>(store->m_store, keys->Get(i)->IntegerValue(), op, wrong);
+            if (wrong)
+                return ThrowException(Exception::TypeError(String::New("key does not hold a count-min sketch")));
+            if (!cms)
+                continue;
+
+            if (!sum)
+                sum.reset(new JsCountMin(cms->width(), cms->depth()));
+            if (!sum->merge(*cms))
+                return ThrowException(Exception::RangeError(String::New("sketch dimensions differ")));
+        }
+
+        store->m_store.touch(dest);
+        Store::Entry* entry = store->m_store.find(dest);
+        if (!entry && sum)
+        {
+            op.size = store->m_store.set(dest, sum).size;
+            return Undefined();
+        }
+
+        const shared_ptr<JsCountMin> cms = store->writable<JsCountMin>(dest, entry);
+        if (!cms)
+            return ThrowException(Exception::TypeError(String::New("key does not hold a count-min sketch")));
+        if (sum && !cms->merge(*sum))
+            return ThrowException(Exception::RangeError(String::New("sketch dimensions differ")));
+
+        op.size = entry->size;
+        return Undefined();
+    }
+
+    /// names or dotted paths from an array of strings or a single string
+    static void read_paths(const Handle<Value> val, std::vector<FieldPath>& out)
+    {
+        if (!val->IsArray())
+        {
+            out.push_back(parse_path(utf8(val)));
+            return;
+        }
+
+        const Local<Array> arr = Local<Array>::Cast(val);
+        for (uint32_t i=0 ; i<arr->Length() ; ++i)
+            out.push_back(parse_path(utf8(arr->Get(i))));
+    }
+
+    /// index the words of the strings at paths of every value
+    /// createTextIndex(name, paths, [{tokenizer: 'simple' | 'whitespace'}])
+    /// paths are member names or dotted paths like 'author.name', strings
+    /// in arrays at a path are indexed too
+    static Handle<Value> CreateTextIndex(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const std::string name = utf8(args[0]);
+
+        std::vector<FieldPath> paths;
+        read_paths(args[1], paths);
+
+        TextIndex::Tokenizer tokenizer = TextIndex::SIMPLE;
+        if (args[2]->IsObject())
+        {
+            const Local<Value> t = args[2]->ToObject()->Get(String::NewSymbol("tokenizer"));
+            if (!t->IsUndefined() && !TextIndex::tokenizer(utf8(t), tokenizer))
+                return ThrowException(Exception::TypeError(
+                    String::New("tokenizer must be 'simple' or 'whitespace'")));
+        }
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (!store->m_store.add_index(name, shared_ptr<StoreIndex>(new TextIndex(paths, tokenizer))))
+            return ThrowException(Exception::Error(String::New("index already exists")));
+
+        return Undefined();
+    }
+
+    /// keys of the values best matching any of the words of terms
+    /// search(name, terms, [{limit, withScores}]) terms is a string or an
+    /// array of them, limit defaults to 10. ranked by bm25, with scores the
+    /// result is [key, score, key, score, ...]
+    static Handle<Value> Search(const Arguments& args)
+    {
+        HandleScope scope;
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        const TextIndex* index = dynamic_cast<const TextIndex*>(store->m_store.index(utf8(args[0])));
+        if (!index)
+            return ThrowException(Exception::Error(String::New("no text index with that name")));
+
+        size_t limit = 10;
+        bool with_scores = false;
+        if (args[2]->IsObject())
+        {
+            const Local<Object> opts = args[2]->ToObject();
+            const Local<Value> l = opts->Get(String::NewSymbol("limit"));
+            if (l->IsNumber())
+                limit = size_t(std::max<int64_t>(0, l->IntegerValue()));
+            with_scores = opts->Get(String::NewSymbol("withScores"))->BooleanValue();
+        }
+
+        std::vector<std::string> terms;
+        if (args[1]->IsArray())
+        {
+            const Local<Array> arr = Local<Array>::Cast(args[1]);
+            for (uint32_t i=0 ; i<arr->Length() ; ++i)
+                index->terms(utf8(arr->Get(i)), terms);
+        }
+        else
+        {
+            index->terms(utf8(args[1]), terms);
+        }
+
+        const std::vector<TextIndex::Hit> hits = index->search(terms, limit);
+
+        Local<Array> out = Array::New(with_scores ? 2 * hits.size() : hits.size());
+        for (uint32_t i=0, n=0 ; i<hits.size() ; ++i)
+        {
+            out->Set(n++, Number::New(double(hits[i].key)));
+            if (with_scores)
+                out->Set(n++, Number::New(hits[i].score));
+        }
+        return scope.Close(out);
+    }
+
+    /// index the fixed length number arrays at path of every value
+    /// createVectorIndex(name, path, {dimensions, [metric], [hnsw]})
+    /// metric is 'l2' (default), 'dot' or 'cosine'. hnsw true or
+    /// {m, efConstruction} also builds a graph for approximate queries,
+    /// without it every query scans all vectors
+    static Handle<Value> CreateVectorIndex(const Arguments& args)
+    {
+        HandleScope scope;
+
+        if (!args[2]->IsObject())
+            return ThrowException(Exception::TypeError(String::New("options must be an object")));
+
+        const std::string name = utf8(args[0]);
+        const FieldPath path = parse_path(utf8(args[1]));
+        const Local<Object> opts = args[2]->ToObject();
+
+        const int64_t dims = opts->Get(String::NewSymbol("dimensions"))->IntegerValue();
+        if (dims < 1 || dims > 65536)
+            return ThrowException(Exception::RangeError(
+                String::New("dimensions must be between 1 and 65536")));
+
+        VectorIndex::Metric metric = VectorIndex::L2;
+        const Local<Value> m = opts->Get(String::NewSymbol("metric"));
+        if (!m->IsUndefined() && !VectorIndex::metric(utf8(m), metric))
+            return ThrowException(Exception::TypeError(
+                String::New("metric must be 'l2', 'dot' or 'cosine'")));
+
+        uint32_t graph_m = 0;
+        uint32_t ef_construction = 0;
+        const Local<Value> h = opts->Get(String::NewSymbol("hnsw"));
+        if (h->IsObject() || h->BooleanValue())
+        {
+            graph_m = 16;
+            ef_construction = 200;
+            if (h->IsObject())
+            {
+                const Local<Object> ho = h->ToObject();
+                const Local<Value> hm = ho->Get(String::NewSymbol("m"));
+                const Local<Value> ef = ho->Get(String::NewSymbol("efConstruction"));
+                if (hm->IsNumber())
+                    graph_m = uint32_t(std::min<int64_t>(std::max<int64_t>(2, hm->IntegerValue()), 256));
+                if (ef->IsNumber())
+                    ef_construction = uint32_t(std::min<int64_t>(std::max<int64_t>(1, ef->IntegerValue()), 65536));
+            }
+        }
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        const shared_ptr<StoreIndex> index(
+            new VectorIndex(path, uint32_t(dims), metric, graph_m, ef_construction));
+        if (!store->m_store.add_index(name, index))
+            return ThrowException(Exception::Error(String::New("index already exists")));
+
+        return Undefined();
+    }
+
+    /// keys of the values whose vectors are nearest to vector
+    /// nearest(name, vector, [{k, withScores, exact, ef}]) vector is an array
+    /// of numbers or a Float32Array, k defaults to 10. scores are distances
+    /// for l2 and inner products otherwise. exact scans every vector even
+    /// when there is a graph, ef widens the graph search (default 64)
+    static Handle<Value> Nearest(const Arguments& args)
+    {
+        HandleScope scope;
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        const VectorIndex* index = dynamic_cast<const VectorIndex*>(store->m_store.index(utf8(args[0])));
+        if (!index)
+            return ThrowException(Exception::Error(String::New("no vector index with that name")));
+
+        if (!args[1]->IsObject())
+            return ThrowException(Exception::TypeError(String::New("vector must be an array")));
+
+        std::vector<float> query;
+        const Local<Object> v = args[1]->ToObject();
+        if (v->HasIndexedPropertiesInExternalArrayData()
+            && v->GetIndexedPropertiesExternalArrayDataType() == kExternalFloatArray)
+        {
+            const float* data = static_cast<const float*>(v->GetIndexedPropertiesExternalArrayData());
+            query.assign(data, data + v->GetIndexedPropertiesExternalArrayDataLength());
+        }
+        else if (args[1]->IsArray())
+        {
+            const Local<Array> arr = Local<Array>::Cast(args[1]);
+            query.resize(arr->Length());
+            for (uint32_t i=0 ; i<query.size() ; ++i)
+                query[i] = float(arr->Get(i)->NumberValue());
+        }
+
+        if (query.size() != index->dimensions())
+            return ThrowException(Exception::RangeError(
+                String::New("vector length does not match the index dimensions")));
+
+        size_t k = 10;
+        size_t ef = 64;
+        bool exact = false;
+        bool with_scores = false;
+        if (args[2]->IsObject())
+        {
+            const Local<Object> opts = args[2]->ToObject();
+            const Local<Value> kv = opts->Get(String::NewSymbol("k"));
+            const Local<Value> efv = opts->Get(String::NewSymbol("ef"));
+            if (kv->IsNumber())
+                k = size_t(std::max<int64_t>(0, kv->IntegerValue()));
+            if (efv->IsNumber())
+                ef = size_t(std::max<int64_t>(1, efv->IntegerValue()));
+            exact = opts->Get(String::NewSymbol("exact"))->BooleanValue();
+            with_scores = opts->Get(String::NewSymbol("withScores"))->BooleanValue();
+        }
+
+        const std::vector<VectorIndex::Hit> hits = index->nearest(&query[0], k, exact, ef);
+
+        Local<Array> out = Array::New(with_scores ? 2 * hits.size() : hits.size());
+        for (uint32_t i=0, n=0 ; i<hits.size() ; ++i)
+        {
+            out->Set(n++, Number::New(double(hits[i].key)));
+            if (with_scores)
+                out->Set(n++, Number::New(hits[i].score));
+        }
+        return scope.Close(out);
+    }
+
+    /// index the strings at path of every value in byte order
+    /// createStringIndex(name, path) serves lookup, scanPrefix and scanRange
+    static Handle<Value> CreateStringIndex(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const std::string name = utf8(args[0]);
+        const FieldPath path = parse_path(utf8(args[1]));
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (!store->m_store.add_index(name, shared_ptr<StoreIndex>(new StringIndex(path))))
+            return ThrowException(Exception::Error(String::New("index already exists")));
+
+        return Undefined();
+    }
+
+    /// string index name of the first argument, 0 after throwing
+    static const StringIndex* string_index(const Arguments& args)
+    {
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        const StringIndex* index = dynamic_cast<const StringIndex*>(store->m_store.index(utf8(args[0])));
+        if (!index)
+            ThrowException(Exception::Error(String::New("no string index with that name")));
+        return index;
+    }
+
+    /// keys, or [string, key, ...] with withStrings, in string order
+    static Local<Array> matches_to_v8(const std::vector<StringIndex::Match>& matches, bool with_strings)
+    {
+        Local<Array> out = Array::New(with_strings ? 2 * matches.size() : matches.size());
+        for (uint32_t i=0, n=0 ; i<matches.size() ; ++i)
+        {
+            if (with_strings)
+                out->Set(n++, String::New(matches[i].value.data(), int(matches[i].value.size())));
+            out->Set(n++, Number::New(double(matches[i].key)));
+        }
+        return out;
+    }
+
+    /// limit and withStrings of a scan
+    static void scan_options(Handle<Value> arg, size_t& limit, bool& with_strings)
+    {
+        limit = size_t(-1);
+        with_strings = false;
+        if (!arg->IsObject())
+            return;
+
+        const Local<Object> opts = arg->ToObject();
+        const Local<Value> l = opts->Get(String::NewSymbol("limit"));
+        if (l->IsNumber())
+            limit = size_t(std::max<int64_t>(0, l->IntegerValue()));
+        with_strings = opts->Get(String::NewSymbol("withStrings"))->BooleanValue();
+    }
+
+    /// keys of the values holding exactly string at the indexed path
+    /// lookup(name, string)
+    static Handle<Value> Lookup(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const StringIndex* index = string_index(args);
+        if (!index)
+            return Undefined();
+
+        std::vector<StringIndex::Match> matches;
+        index->lookup(utf8(args[1]), matches);
+        return scope.Close(matches_to_v8(matches, false));
+    }
+
+    /// keys of the values holding strings starting with prefix
+    /// scanPrefix(name, prefix, [{limit, withStrings}])
+    static Handle<Value> ScanPrefix(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const StringIndex* index = string_index(args);
+        if (!index)
+            return Undefined();
+
+        size_t limit;
+        bool with_strings;
+        scan_options(args[2], limit, with_strings);
+
+        std::vector<StringIndex::Match> matches;
+        index->prefix(utf8(args[1]), limit, matches);
+        return scope.Close(matches_to_v8(matches, with_strings));
+    }
+
+    /// keys of the values holding strings from from up to but not including
+    /// to, to left out or null has no end
+    /// scanRange(name, from, [to], [{limit, withStrings}])
+    static Handle<Value> ScanRange(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const StringIndex* index = string_index(args);
+        if (!index)
+            return Undefined();
+
+        size_t limit;
+        bool with_strings;
+        scan_options(args[3], limit, with_strings);
+
+        const bool bounded = !args[2]->IsUndefined() && !args[2]->IsNull();
+        const std::string from = args[1]->IsUndefined() || args[1]->IsNull() ? std::string() : utf8(args[1]);
+        const std::string to = bounded ? utf8(args[2]) : std::string();
+
+        std::vector<StringIndex::Match> matches;
+        index->range(from, to, bounded, limit, matches);
+        return scope.Close(matches_to_v8(matches, with_strings));
+    }
+
+    /// dropIndex(name) returns true if there was an index by that name
+    static Handle<Value> DropIndex(const Arguments& args)
+    {
+        HandleScope scope;
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        return scope.Close(Boolean::New(store->m_store.drop_index(utf8(args[0]))));
+    }
+
+    /// add points to the end of a time series, creating it if needed
+    /// appendPoints(key, [timestamps...], [values...])
+    static Handle<Value> AppendPoints(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+
+        if (!args[1]->IsArray() || !args[2]->IsArray())
+            return ThrowException(Exception::TypeError(
+                String::New("timestamps and values must be arrays")));
+
+        Local<Array> ts = Local<Array>::Cast(args[1]);
+        Local<Array> vals = Local<Array>::Cast(args[2]);
+
+        const uint32_t length = ts->Length();
+        if (vals->Length() != length)
+            return ThrowException(Exception::RangeError(
+                String::New("timestamps and values must have the same length")));
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        if (store->m_store.frozen())
+            return frozen_error();
+        OpScope op(store->m_store, Store::OP_APPEND_POINTS, k);
+        store->m_store.touch(k);
+
+        shared_ptr<JsTimeSeries> series;
+        Store::Entry* entry = store->m_store.find(k);
+        if (entry)
+        {
+            series = dynamic_pointer_cast<JsTimeSeries>(entry->value);
+            if (!series)
+                return ThrowException(Exception::TypeError(
+                    String::New("key does not hold a time series")));
+        }
+
+        // validate everything first so a bad batch appends nothing
+        int64_t last = (series && series->size()) ? series->last_timestamp()
+                                                  : std::numeric_limits<int64_t>::min();
+        for (uint32_t i=0 ; i<length ; ++i)
+        {
+            const int64_t t = ts->Get(i)->IntegerValue();
+            if (t < last)
+                return ThrowException(Exception::RangeError(
+                    String::New("timestamps must not decrease")));
+            last = t;
+        }
+
+        if (!series)
+        {
+            series.reset(new JsTimeSeries());
+            entry = &store->m_store.set(k, series);
+        }
+
+        for (uint32_t i=0 ; i<length ; ++i)
+            series->append(ts->Get(i)->IntegerValue(), vals->Get(i)->NumberValue());
+
+        store->m_store.resized(*entry);
+        store->m_store.changed(k, *entry);
+        op.size = entry->size;
+
+        return scope.Close(Integer::NewFromUnsigned(series->size()));
+    }
+
+    /// decode the points of a time series with from <= timestamp <= to
+    /// range(key, from, to)
+    static Handle<Value> Range(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const int64_t k = args[0]->IntegerValue();
+        const int64_t from = args[1]->IsUndefined() ? std::numeric_limits<int64_t>::min()
+                                                    : args[1]->IntegerValue();
+        const int64_t to = args[2]->IsUndefined() ? std::numeric_limits<int64_t>::max()
+                                                  : args[2]->IntegerValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        OpScope op(store->m_store, Store::OP_RANGE, k);
+        store->m_store.touch(k);
+
+        const Store::Entry* e = store->m_store.lookup(k);
+
+        if (!e)
+            return Undefined();
+
+        op.size = e->size;
+
+        const shared_ptr<JsTimeSeries> series = dynamic_pointer_cast<JsTimeSeries>(e->value);
+        if (!series)
+            return ThrowException(Exception::TypeError(
+                String::New("key does not hold a time series")));
+
+        V8Sink out;
+        series->range(from, to, out);
+        return scope.Close(out.result());
+    }
+
+    static Local<Object> histogram_to_v8(const Histogram& h)
+    {
+        Local<Object> out = Object::New();
+        out->Set(String::NewSymbol("count"), Number::New(h.count()));
+        out->Set(String::NewSymbol("min"), Number::New(h.min()));
+        out->Set(String::NewSymbol("max"), Number::New(h.max()));
+        out->Set(String::NewSymbol("mean"), Number::New(h.mean()));
+        out->Set(String::NewSymbol("p50"), Number::New(h.percentile(0.5)));
+        out->Set(String::NewSymbol("p90"), Number::New(h.percentile(0.9)));
+        out->Set(String::NewSymbol("p99"), Number::New(h.percentile(0.99)));
+        out->Set(String::NewSymbol("p999"), Number::New(h.percentile(0.999)));
+        return out;
+    }
+
+    /// per operation latency histograms in nanoseconds and value sizes in bytes
+    /// latency([{enable: bool, reset: bool}])
+    /// reset clears the histograms after they have been read
+    static Handle<Value> Latency(const Arguments& args)
+    {
+        HandleScope scope;
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+
+        bool reset = false;
+        if (args[0]->IsObject())
+        {
+            const Local<Object> opts = args[0]->ToObject();
+            const Local<String> enable = String::NewSymbol("enable");
+            if (opts->Has(enable))
+                store->m_store.enable_latency(opts->Get(enable)->BooleanValue());
+            reset = opts->Get(String::NewSymbol("reset"))->BooleanValue();
+        }
+
+        Local<Object> out = Object::New();
+        OpLatency* latency = store->m_store.latency();
+        out->Set(String::NewSymbol("enabled"), Boolean::New(latency != 0));
+        if (!latency)
+            return scope.Close(out);
+
+        out->Set(String::NewSymbol("set"), histogram_to_v8(latency->set));
+        out->Set(String::NewSymbol("get"), histogram_to_v8(latency->get));
+        out->Set(String::NewSymbol("del"), histogram_to_v8(latency->del));
+        out->Set(String::NewSymbol("list"), histogram_to_v8(latency->list));
+        out->Set(String::NewSymbol("encodeBytes"), histogram_to_v8(latency->encode_bytes));
+        out->Set(String::NewSymbol("decodeBytes"), histogram_to_v8(latency->decode_bytes));
+
+        if (reset)
+            latency->reset();
+
+        return scope.Close(out);
+    }
+
+    /// apply {enable, slowerThan, largerThan, maxLen} to the slowlog
+    /// setting a threshold turns the log on
+    void configure_slowlog(const Local<Object> opts)
+    {
+        const Local<String> enable = String::NewSymbol("enable");
+        const Local<String> slower = String::NewSymbol("slowerThan");
+        const Local<String> larger = String::NewSymbol("largerThan");
+        const Local<String> max_len = String::NewSymbol("maxLen");
+
+        if (opts->Has(enable))
+            m_store.enable_slowlog(opts->Get(enable)->BooleanValue());
+        else if (opts->Has(slower) || opts->Has(larger) || opts->Has(max_len))
+            m_store.enable_slowlog(true);
+
+        SlowLog* log = m_store.slowlog();
+        if (!log)
+            return;
+
+        // thresholds are given in microseconds like redis
+        if (opts->Has(slower))
+            log->slower_than(uint64_t(opts->Get(slower)->IntegerValue()) * 1000);
+        if (opts->Has(larger))
+            log->larger_than(size_t(opts->Get(larger)->IntegerValue()));
+        if (opts->Has(max_len))
+            log->max_len(size_t(opts->Get(max_len)->IntegerValue()));
+    }
+
+    /// operations slower or larger than the thresholds, newest first
+    /// slowlog([{enable, slowerThan: us, largerThan: bytes, maxLen, reset}])
+    /// each entry is {id, time, op, key, bytes, nodes, duration} with the
+    /// duration in microseconds, reset clears the log after it has been read
+    static Handle<Value> Slowlog(const Arguments& args)
+    {
+        HandleScope scope;
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+
+        bool reset = false;
+        if (args[0]->IsObject())
+        {
+            const Local<Object> opts = args[0]->ToObject();
+            store->configure_slowlog(opts);
+            reset = opts->Get(String::NewSymbol("reset"))->BooleanValue();
+        }
+
+        Local<Array> arr = Array::New();
+        SlowLog* log = store->m_store.slowlog();
+        if (!log)
+            return scope.Close(arr);
+
+        const std::vector<SlowLog::Entry> entries = log->entries();
+        for (uint32_t i=0 ; i<entries.size() ; ++i)
+        {
+            const SlowLog::Entry& e = entries[i];
+
+            Local<Object> item = Object::New();
+            item->Set(String::NewSymbol("id"), Number::New(e.id));
+            item->Set(String::NewSymbol("time"), Number::New(e.time));
+            item->Set(String::NewSymbol("op"), String::NewSymbol(e.op));
+            item->Set(String::NewSymbol("key"), Number::New(e.key));
+            item->Set(String::NewSymbol("bytes"), Number::New(e.size.bytes));
+            item->Set(String::NewSymbol("nodes"), Number::New(e.size.nodes));
+            item->Set(String::NewSymbol("duration"), Number::New(e.duration_ns / 1000.0));
+            arr->Set(i, item);
+        }
+
+        if (reset)
+            log->reset();
+
+        return scope.Close(arr);
+    }
+
+    /// most accessed keys by gets and sets, most accessed first
+    /// hotKeys([k = 10, {reset}]) returns [{key, count, error}] where the
+    /// true count lies in [count - error, count]. empty unless the store
+    /// was created with {hotKeys: true | counters}
+    static Handle<Value> HotKeysList(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const size_t k = args[0]->IsUndefined() ? 10 : size_t(args[0]->IntegerValue());
+        const bool reset = args[1]->IsObject()
+            && args[1]->ToObject()->Get(String::NewSymbol("reset"))->BooleanValue();
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+
+        Local<Array> arr = Array::New();
+        HotKeys* hot = store->m_store.hot_keys();
+        if (!hot)
+            return scope.Close(arr);
+
+        const std::vector<HotKeys::Counter> top = hot->top(k);
+        for (uint32_t i=0 ; i<top.size() ; ++i)
+        {
+            Local<Object> item = Object::New();
+            item->Set(String::NewSymbol("key"), Number::New(top[i].key));
+            item->Set(String::NewSymbol("count"), Number::New(top[i].count));
+            item->Set(String::NewSymbol("error"), Number::New(top[i].error));
+            arr->Set(i, item);
+        }
+
+        if (reset)
+            hot->reset();
+
+        return scope.Close(arr);
+    }
+
+    static Local<Object> cost_to_v8(const Cost& c)
+    {
+        Local<Object> out = Object::New();
+        out->Set(String::NewSymbol("calls"), Number::New(c.calls));
+        out->Set(String::NewSymbol("ns"), Number::New(c.ns));
+        out->Set(String::NewSymbol("bytes"), Number::New(c.bytes));
+        return out;
+    }
+
+    static Local<Object> costs_by_type(const Cost* costs)
+    {
+        static const char* names[] = { "undefined", "int32", "number", "string", "array", "object" };
+
+        Local<Object> out = Object::New();
+        for (int i=0 ; i<CodecProfile::kTypes ; ++i)
+            out->Set(String::NewSymbol(names[i]), cost_to_v8(costs[i]));
+        return out;
+    }
+
+    /// codec costs as {encode: {type: cost}, decode: {type: cost},
+    /// phases: {phase: cost}} where each cost is {calls, ns, bytes}
+    static Local<Object> profile_to_v8(const CodecProfile& p)
+    {
+        Local<Object> phases = Object::New();
+        for (int i=0 ; i<CodecProfile::PHASE_COUNT ; ++i)
+        {
+            const CodecProfile::Phase phase = CodecProfile::Phase(i);
+            phases->Set(String::NewSymbol(CodecProfile::phase_name(phase)), cost_to_v8(p.phases[i]));
+        }
+
+        Local<Object> out = Object::New();
+        out->Set(String::NewSymbol("encode"), costs_by_type(p.encode));
+        out->Set(String::NewSymbol("decode"), costs_by_type(p.decode));
+        out->Set(String::NewSymbol("phases"), phases);
+        return out;
+    }
+
+    /// size of the store and the statistics that are on
+    /// stats([{reset}]) returns {keys, bytes, pendingFrees, codec, mrc: {rate, sampled,
+    /// curve}} where curve is [{keys, bytes, hitRatio}] in increasing
+    /// capacity, bytes being the capacity in keys times the current mean
+    /// value size. codec is there for stores created with {profile: true}
+    /// and reset clears it and the curve's samples after they have been read
+    static Handle<Value> Stats(const Arguments& args)
+    {
+        HandleScope scope;
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        const Store& s = store->m_store;
+
+        Local<Object> out = Object::New();
+        out->Set(String::NewSymbol("keys"), Number::New(s.size()));
+        out->Set(String::NewSymbol("bytes"), Number::New(s.bytes()));
+        out->Set(String::NewSymbol("indexBytes"), Number::New(s.secondary_bytes()));
+        out->Set(String::NewSymbol("denseKeys"), Boolean::New(s.dense()));
+        out->Set(String::NewSymbol("frozen"), Boolean::New(s.frozen()));
+
+        // shared by all stores
+        out->Set(String::NewSymbol("pendingFrees"), Number::New(Reclaimer::instance().pending()));
+
+        const bool reset = args[0]->IsObject()
+            && args[0]->ToObject()->Get(String::NewSymbol("reset"))->BooleanValue();
+
+        if (CodecProfile* profile = s.profile())
+        {
+            out->Set(String::NewSymbol("codec"), profile_to_v8(*profile));
+            if (reset)
+                profile->reset();
+        }
+
+        MissRatioCurve* mrc = store->m_store.mrc();
+        if (!mrc)
+            return scope.Close(out);
+
+        const double mean = s.size() ? double(s.bytes()) / s.size() : 0;
+        const std::vector<MissRatioCurve::Point> points = mrc->curve();
+
+        Local<Array> curve = Array::New(points.size());
+        for (uint32_t i=0 ; i<points.size() ; ++i)
+        {
+            Local<Object> p = Object::New();
+            p->Set(String::NewSymbol("keys"), Number::New(points[i].keys));
+            p->Set(String::NewSymbol("bytes"), Number::New(points[i].keys * mean));
+            p->Set(String::NewSymbol("hitRatio"), Number::New(points[i].hit_ratio));
+            curve->Set(i, p);
+        }
+
+        Local<Object> m = Object::New();
+        m->Set(String::NewSymbol("rate"), Number::New(mrc->rate()));
+        m->Set(String::NewSymbol("sampled"), Number::New(mrc->sampled()));
+        m->Set(String::NewSymbol("curve"), curve);
+        out->Set(String::NewSymbol("mrc"), m);
+
+        if (reset)
+            mrc->reset();
+
+        return scope.Close(out);
+    }
+
+    /// record operations to a binary trace for build/default/bypass_replay
+    /// trace(path) starts a new trace, trace(false) finishes it and
+    /// trace() reports {recording, path, records}
+    static Handle<Value> Trace(const Arguments& args)
+    {
+        HandleScope scope;
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+
+        if (args[0]->IsString())
+        {
+            String::Utf8Value path(args[0]);
+            if (!store->m_store.start_trace(std::string(*path, path.length()), now_ns()))
+                return ThrowException(Exception::Error(
+                    String::New("cannot create trace file")));
+        }
+        else if (args.Length() > 0 && !args[0]->BooleanValue())
+        {
+            store->m_store.stop_trace();
+        }
+
+        Local<Object> out = Object::New();
+        const TraceWriter* trace = store->m_store.trace();
+        out->Set(String::NewSymbol("recording"), Boolean::New(trace != 0));
+        if (trace)
+        {
+            out->Set(String::NewSymbol("path"), String::New(trace->path().c_str()));
+            out->Set(String::NewSymbol("records"), Number::New(trace->records()));
+        }
+
+        return scope.Close(out);
+    }
+
+    /// make the store read only and rebuild it for lookups
+    /// freeze() returns false if it was already frozen. keys are found
+    /// with a perfect hash in one probe and plain values are packed
+    /// together, every write throws afterwards until close()
+    static Handle<Value> Freeze(const Arguments& args)
+    {
+        HandleScope scope;
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        return scope.Close(Boolean::New(store->m_store.freeze()));
+    }
+
+    /// drop every key without waiting for the values to be freed
+    /// the store stays usable and starts out empty
+    static Handle<Value> Close(const Arguments& args)
+    {
+        HandleScope scope;
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        store->m_store.clear();
+
+        return scope.Close(Handle<Value>());
+    }
+
+    /// this store's metrics in the prometheus text format
+    static Handle<Value> Metrics(const Arguments& args)
+    {
+        HandleScope scope;
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+
+        std::string out;
+        render_metrics(std::vector<const Store*>(1, &store->m_store), out);
+        return scope.Close(String::New(out.data(), out.size()));
+    }
+
+    /// metrics of every live store in the prometheus text format
+    /// exported as bypass.metrics()
+    static Handle<Value> AllMetrics(const Arguments& args)
+    {
+        HandleScope scope;
+
+        std::string out;
+        render_metrics(MetricsRegistry::stores(), out);
+        return scope.Close(String::New(out.data(), out.size()));
+    }
+
+    /// keys holding the largest values, largest first
+    /// bigKeys([n = 10]) returns [{key, bytes, nodes}]
+    static Handle<Value> BigKeys(const Arguments& args)
+    {
+        HandleScope scope;
+
+        const size_t n = args[0]->IsUndefined() ? 10 : size_t(args[0]->IntegerValue());
+
+        BypassStore* store = ObjectWrap::Unwrap<BypassStore>(args.This());
+        const std::vector<std::pair<int64_t, Footprint> > keys = store->m_store.big_keys(n);
+
+        Local<Array> arr = Array::New(keys.size());
+        for (uint32_t i=0 ; i<keys.size() ; ++i)
         {
-            arr->Set(i, Int32::New(iter->first));
+            Local<Object> item = Object::New();
+            item->Set(String::NewSymbol("key"), Number::New(keys[i].first));
+            item->Set(String::NewSymbol("bytes"), Number::New(keys[i].second.bytes));
+            item->Set(String::NewSymbol("nodes"), Number::New(keys[i].second.nodes));
+            arr->Set(i, item);
         }
 
         return scope.Close(arr);
@@ -0,0 +1,31 @@
+#ifndef BYPASS_CLOCK_H
+#define BYPASS_CLOCK_H
+
+#include <stdint.h>
+
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+namespace bypass {
+
+/// monotonic clock in nanoseconds, only differences are meaningful
+inline uint64_t now_ns()
+{
+#if defined(__APPLE__)
+    static mach_timebase_info_data_t tb;
+    if (tb.denom == 0)
+        mach_timebase_info(&tb);
+    return mach_absolute_time() * tb.numer / tb.denom;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+} // namespace bypass
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef BYPASS_DENSE_H
+#define BYPASS_DENSE_H
+
+#include <vector>
+#include <algorithm>
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace bypass {
+
+/// slots for the keys 0..kMaxKey addressed directly by key
+/// slots come in pages of kPageSize allocated when a key in them is first
+/// set and freed when the last one goes, with a bitmap of the slots in use
+/// so a lookup is the page table, one bitmap word and the slot itself
+template <class T>
+class DenseArray
+{
+public:
+    static const uint32_t kPageBits = 10;
+    static const uint32_t kPageSize = 1 << kPageBits;
+
+    /// bounds the page table to 2 MB of pointers
+    static const int64_t kMaxKey = (int64_t(1) << 28) - 1;
+
+private:
+    static const uint32_t kWords = kPageSize / 64;
+
+    struct Page
+    {
+        uint64_t present[kWords];
+        uint32_t count;
+        T slots[kPageSize];
+
+        Page()
+            : count(0)
+        {
+            std::fill(present, present + kWords, uint64_t(0));
+        }
+
+        bool has(uint32_t i) const { return (present[i >> 6] >> (i & 63)) & 1; }
+    };
+
+    std::vector<Page*> m_pages;
+    size_t m_size;
+    size_t m_allocated;
+
+    DenseArray(const DenseArray&);
+    DenseArray& operator=(const DenseArray&);
+
+public:
+    DenseArray()
+        : m_size(0)
+        , m_allocated(0)
+    {}
+
+    ~DenseArray()
+    {
+        for (size_t i=0 ; i<m_pages.size() ; ++i)
+            delete m_pages[i];
+    }
+
+    static bool fits(int64_t key) { return key >= 0 && key <= kMaxKey; }
+
+    /// slot of key, 0 if it is not set. key must fit
+    T* find(int64_t key) const
+    {
+        const size_t page = size_t(key >> kPageBits);
+        if (page >= m_pages.size() || !m_pages[page])
+            return 0;
+
+        Page* p = m_pages[page];
+        const uint32_t i = uint32_t(key) & (kPageSize - 1);
+        return p->has(i) ? &p->slots[i] : 0;
+    }
+
+    /// slot of key, default constructed if it was not set. key must fit
+    T& insert(int64_t key)
+    {
+        const size_t page = size_t(key >> kPageBits);
+        if (page >= m_pages.size())
+            m_pages.resize(page + 1, 0);
+        if (!m_pages[page])
+        {
+            m_pages[page] = new Page();
+            ++m_allocated;
+        }
+
+        Page* p = m_pages[page];
+        const uint32_t i = uint32_t(key) & (kPageSize - 1);
+        if (!p->has(i))
+        {
+            p->present[i >> 6] |= uint64_t(1) << (i & 63);
+            ++p->count;
+            ++m_size;
+        }
+        return p->slots[i];
+    }
+
+    /// reset the slot of key, which must be set
+    void erase(int64_t key)
+    {
+        const size_t page = size_t(key >> kPageBits);
+        Page* p = m_pages[page];
+        const uint32_t i = uint32_t(key) & (kPageSize - 1);
+
+        p->slots[i] = T();
+        p->present[i >> 6] &= ~(uint64_t(1) << (i & 63));
+        --m_size;
+        if (--p->count == 0)
+        {
+            delete p;
+            m_pages[page] = 0;
+            --m_allocated;
+        }
+    }
+
+    /// first set key at or after key, false if there is none
+    bool next(int64_t& key) const
+    {
+        for (size_t page = size_t(key >> kPageBits) ; page < m_pages.size() ; ++page)
+        {
+            const Page* p = m_pages[page];
+            if (!p)
+                continue;
+
+            const int64_t base = int64_t(page) << kPageBits;
+            uint32_t i = key > base ? uint32_t(key - base) : 0;
+            for (uint32_t w = i >> 6 ; w < kWords ; ++w)
+            {
+                uint64_t bits = p->present[w];
+                if (w == (i >> 6))
+                    bits &= ~uint64_t(0) << (i & 63);
+                if (bits)
+                {
+                    key = base + w * 64 + __builtin_ctzll(bits);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    size_t size() const { return m_size; }
+
+    /// pages allocated
+    size_t pages() const { return m_allocated; }
+
+    /// pages and the page table
+    size_t bytes() const
+    {
+        return m_allocated * sizeof(Page) + m_pages.capacity() * sizeof(Page*);
+    }
+
+    void swap(DenseArray& other)
+    {
+        m_pages.swap(other.m_pages);
+        std::swap(m_size, other.m_size);
+        std::swap(m_allocated, other.m_allocated);
+    }
+};
+
+} // namespace bypass
+
+#endif
@@ -0,0 +1,414 @@
+#include <cstring>
+#include <algorithm>
+
+#include "frozen.h"
+#include "list.h"
+
+using namespace boost;
+
+namespace bypass {
+
+namespace {
+
+// average keys per bucket and share of the table left free
+const uint32_t kBucketSize = 4;
+const double kLoad = 0.95;
+
+enum Step
+{
+    STEP_UNDEFINED,
+    STEP_NUMBER,
+    STEP_INT32,
+    STEP_STRING,
+    STEP_BEGIN_ARRAY,
+    STEP_END_ARRAY,
+    STEP_BEGIN_OBJECT,
+    STEP_KEY,
+    STEP_RECORD_KEY,
+    STEP_END_OBJECT
+};
+
+void put_varint(std::vector<char>& out, uint32_t val)
+{
+    while (val >= 0x80)
+    {
+        out.push_back(char(val | 0x80));
+        val >>= 7;
+    }
+    out.push_back(char(val));
+}
+
+uint32_t get_varint(const char*& p)
+{
+    uint32_t val = 0;
+    for (unsigned shift=0 ; ; shift+=7)
+    {
+        const uint8_t b = uint8_t(*p++);
+        val |= uint32_t(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return val;
+    }
+}
+
+struct Bucket
+{
+    uint32_t id;
+    std::vector<uint64_t> hashes;
+};
+
+bool larger(const Bucket* a, const Bucket* b)
+{
+    return a->hashes.size() > b->hashes.size()
+        || (a->hashes.size() == b->hashes.size() && a->id < b->id);
+}
+
+} // namespace
+
+void PerfectHash::build(const std::vector<int64_t>& keys)
+{
+    m_seed = 0x9e3779b97f4a7c15ull;
+    while (!try_build(keys))
+        m_seed = mix(m_seed + 1);
+}
+
+bool PerfectHash::try_build(const std::vector<int64_t>& keys)
+{
+    m_keys = uint32_t(keys.size());
+    m_table = std::max(m_keys, uint32_t(m_keys / kLoad) + 1);
+    m_buckets = std::max(uint32_t(1), m_keys / kBucketSize);
+    m_pilots.assign(m_buckets, 0);
+    m_remap.clear();
+    if (!m_keys)
+        return true;
+
+    std::vector<Bucket> buckets(m_buckets);
+    for (uint32_t i=0 ; i<m_buckets ; ++i)
+        buckets[i].id = i;
+    for (size_t i=0 ; i<keys.size() ; ++i)
+    {
+        const uint64_t h = mix(uint64_t(keys[i]) ^ m_seed);
+        buckets[reduce(uint32_t(h >> 32), m_buckets)].hashes.push_back(h);
+    }
+
+    // largest buckets first while the table is emptiest
+    std::vector<Bucket*> order(m_buckets);
+    for (uint32_t i=0 ; i<m_buckets ; ++i)
+        order[i] = &buckets[i];
+    std::sort(order.begin(), order.end(), larger);
+
+    std::vector<bool> taken(m_table, false);
+    std::vector<uint32_t> spots;
+    for (size_t b=0 ; b<order.size() && !order[b]->hashes.empty() ; ++b)
+    {
+        const std::vector<uint64_t>& hashes = order[b]->hashes;
+
+        uint32_t pilot = 0;
+        for (;; ++pilot)
+        {
+            if (pilot > 0xffff)
+                return false;
+
+            spots.clear();
+            bool free = true;
+            for (size_t i=0 ; i<hashes.size() && free ; ++i)
+            {
+                const uint32_t p = position(hashes[i], uint16_t(pilot));
+                free = !taken[p] && std::find(spots.begin(), spots.end(), p) == spots.end();
+                spots.push_back(p);
+            }
+            if (free)
+                break;
+        }
+
+        m_pilots[order[b]->id] = uint16_t(pilot);
+        for (size_t i=0 ; i<spots.size() ; ++i)
+            taken[spots[i]] = true;
+    }
+
+    // positions past the keys take the free ones below in order
+    m_remap.resize(m_table - m_keys);
+    uint32_t free = 0;
+    for (uint32_t p=m_keys ; p<m_table ; ++p)
+    {
+        if (!taken[p])
+            continue;
+        while (taken[free])
+            ++free;
+        m_remap[p - m_keys] = free++;
+    }
+    return true;
+}
+
+/// a value replayed from the pack
+class PackedValues::Packed : public JsValue
+{
+public:
+    const PackedValues* owner;
+    const char* data;
+    uint32_t length;
+    Kind packed_kind;
+
+    virtual Kind kind() const { return packed_kind; }
+
+    virtual void emit(ValueSink& out) const
+    {
+        const char* p = data;
+        int depth = 0;
+        do
+            depth += owner->replay(p, out);
+        while (depth > 0);
+    }
+
+    virtual void measure(Footprint& out) const
+    {
+        out.bytes += sizeof(*this) + length;
+        ++out.nodes;
+    }
+
+    virtual Walk* walk(ValueSink& out) const;
+};
+
+/// replays a packed container one member at a time
+/// nested containers are replayed whole as part of their member
+class PackedValues::Steps : public JsValue::Walk
+{
+    const PackedValues& m_owner;
+    const char* m_pos;
+
+public:
+    Steps(const PackedValues& owner, const char* pos)
+        : m_owner(owner)
+        , m_pos(pos)
+    {}
+
+    virtual bool next(ValueSink& out, const JsValue*& child)
+    {
+        child = 0;
+
+        const Step step = Step(*m_pos);
+        if (step == STEP_END_ARRAY || step == STEP_END_OBJECT)
+        {
+            m_owner.replay(m_pos, out);
+            return false;
+        }
+        if (step == STEP_KEY || step == STEP_RECORD_KEY)
+            m_owner.replay(m_pos, out);
+
+        int depth = 0;
+        do
+            depth += m_owner.replay(m_pos, out);
+        while (depth > 0);
+        return true;
+    }
+};
+
+JsValue::Walk* PackedValues::Packed::walk(ValueSink& out) const
+{
+    if (data[0] != STEP_BEGIN_ARRAY && data[0] != STEP_BEGIN_OBJECT)
+        return 0;
+
+    const char* p = data;
+    owner->replay(p, out);
+    return new Steps(*owner, p);
+}
+
+/// records the calls a value makes while it is emitted
+class PackedValues::Writer : public ValueSink
+{
+    PackedValues& m_owner;
+    std::vector<char>& m_out;
+
+    void step(Step s) { m_out.push_back(char(s)); }
+
+    void bytes(const char* data, size_t length)
+    {
+        put_varint(m_out, uint32_t(length));
+        m_out.insert(m_out.end(), data, data + length);
+    }
+
+public:
+    Writer(PackedValues& owner)
+        : m_owner(owner)
+        , m_out(owner.m_data)
+    {}
+
+    virtual void undefined() { step(STEP_UNDEFINED); }
+
+    virtual void number(double val)
+    {
+        step(STEP_NUMBER);
+        const char* p = reinterpret_cast<const char*>(&val);
+        m_out.insert(m_out.end(), p, p + sizeof(val));
+    }
+
+    virtual void int32(int32_t val)
+    {
+        step(STEP_INT32);
+        const char* p = reinterpret_cast<const char*>(&val);
+        m_out.insert(m_out.end(), p, p + sizeof(val));
+    }
+
+    virtual void string(const char* data, size_t length)
+    {
+        step(STEP_STRING);
+        bytes(data, length);
+    }
+
+    virtual void begin_array(uint32_t size)
+    {
+        step(STEP_BEGIN_ARRAY);
+        put_varint(m_out, size);
+    }
+
+    virtual void end_array() { step(STEP_END_ARRAY); }
+
+    virtual void begin_object(uint32_t size)
+    {
+        step(STEP_BEGIN_OBJECT);
+        put_varint(m_out, size);
+    }
+
+    virtual void key(const char* name, size_t length)
+    {
+        step(STEP_KEY);
+        bytes(name, length);
+    }
+
+    virtual void key(const RecordLayout& layout, uint32_t field)
+    {
+        std::map<const RecordLayout*, uint32_t>::iterator iter = m_owner.m_layout_ids.find(&layout);
+        if (iter == m_owner.m_layout_ids.end())
+        {
+            iter = m_owner.m_layout_ids.insert(std::make_pair(&layout, uint32_t(m_owner.m_layouts.size()))).first;
+            m_owner.m_layouts.push_back(layout.shared_from_this());
+        }
+
+        step(STEP_RECORD_KEY);
+        put_varint(m_out, iter->second);
+        put_varint(m_out, field);
+    }
+
+    virtual void end_object() { step(STEP_END_OBJECT); }
+};
+
+PackedValues::PackedValues()
+    : m_values(0)
+{}
+
+PackedValues::~PackedValues()
+{
+    delete[] m_values;
+}
+
+bool PackedValues::packable(const JsValue& val)
+{
+    switch (val.kind())
+    {
+    case JsValue::KIND_UNDEFINED:
+    case JsValue::KIND_NUMBER:
+    case JsValue::KIND_STRING:
+    case JsValue::KIND_OBJECT:
+    case JsValue::KIND_RECORD:
+        return true;
+    case JsValue::KIND_ARRAY:
+        // deques keep their own operations
+        return !dynamic_cast<const JsList*>(&val);
+    default:
+        return false;
+    }
+}
+
+void PackedValues::add(const JsValue& val)
+{
+    m_added.push_back(std::make_pair(m_data.size(), val.kind()));
+    Writer w(*this);
+    val.emit(w);
+}
+
+void PackedValues::finish(const shared_ptr<PackedValues>& self, std::vector<shared_ptr<JsValue> >& out)
+{
+    PackedValues& p = *self;
+    std::vector<char>(p.m_data).swap(p.m_data);
+
+    const size_t count = p.m_added.size();
+    p.m_values = new Packed[count];
+    out.resize(count);
+    for (size_t i=0 ; i<count ; ++i)
+    {
+        const size_t start = p.m_added[i].first;
+        const size_t end = i + 1 < count ? p.m_added[i + 1].first : p.m_data.size();
+
+        Packed& v = p.m_values[i];
+        v.owner = &p;
+        v.data = &p.m_data[0] + start;
+        v.length = uint32_t(end - start);
+        v.packed_kind = p.m_added[i].second;
+
+        // shares ownership of the pack
+        out[i] = shared_ptr<JsValue>(self, &v);
+    }
+    std::vector<std::pair<size_t, JsValue::Kind> >().swap(p.m_added);
+    p.m_layout_ids.clear();
+}
+
+int PackedValues::replay(const char*& p, ValueSink& out) const
+{
+    switch (Step(*p++))
+    {
+    case STEP_UNDEFINED:
+        out.undefined();
+        return 0;
+    case STEP_NUMBER:
+    {
+        double val;
+        std::memcpy(&val, p, sizeof(val));
+        p += sizeof(val);
+        out.number(val);
+        return 0;
+    }
+    case STEP_INT32:
+    {
+        int32_t val;
+        std::memcpy(&val, p, sizeof(val));
+        p += sizeof(val);
+        out.int32(val);
+        return 0;
+    }
+    case STEP_STRING:
+    {
+        const uint32_t length = get_varint(p);
+        out.string(p, length);
+        p += length;
+        return 0;
+    }
+    case STEP_BEGIN_ARRAY:
+        out.begin_array(get_varint(p));
+        return 1;
+    case STEP_END_ARRAY:
+        out.end_array();
+        return -1;
+    case STEP_BEGIN_OBJECT:
+        out.begin_object(get_varint(p));
+        return 1;
+    case STEP_KEY:
+    {
+        const uint32_t length = get_varint(p);
+        out.key(p, length);
+        p += length;
+        return 0;
+    }
+    case STEP_RECORD_KEY:
+    {
+        const uint32_t layout = get_varint(p);
+        const uint32_t field = get_varint(p);
+        out.key(*m_layouts[layout], field);
+        return 0;
+    }
+    case STEP_END_OBJECT:
+        out.end_object();
+        return -1;
+    }
+    return 0;
+}
+
+} // namespace bypass
@@ -0,0 +1,132 @@
+#ifndef BYPASS_FROZEN_H
+#define BYPASS_FROZEN_H
+
+#include <map>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include "value.h"
+
+namespace bypass {
+
+/// minimal perfect hash over a fixed set of int64 keys
+/// after PTHash: keys are split into buckets of about four by one hash,
+/// and each bucket gets a 16 bit pilot chosen at build time so that a
+/// second hash mixed with the pilot sends all its keys to free positions.
+/// the table has 5% more positions than keys, the few keys landing past
+/// the end are sent to the positions left free through a remap array.
+/// a lookup is two hashes, a pilot load and rarely a remap load, about
+/// 6 bits per key in all
+class PerfectHash
+{
+    uint64_t m_seed;
+    uint32_t m_keys;
+    uint32_t m_table;
+    uint32_t m_buckets;
+    std::vector<uint16_t> m_pilots;
+    std::vector<uint32_t> m_remap;
+
+    static uint64_t mix(uint64_t x)
+    {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ull;
+        x ^= x >> 33;
+        return x;
+    }
+
+    /// x scaled into 0..n without a division
+    static uint32_t reduce(uint32_t x, uint32_t n)
+    {
+        return uint32_t((uint64_t(x) * n) >> 32);
+    }
+
+    uint32_t position(uint64_t h, uint16_t pilot) const
+    {
+        return reduce(uint32_t(h ^ mix(m_seed ^ pilot)), m_table);
+    }
+
+    /// one attempt with the current seed, false if a bucket found no pilot
+    bool try_build(const std::vector<int64_t>& keys);
+
+public:
+    PerfectHash()
+        : m_seed(0)
+        , m_keys(0)
+        , m_table(0)
+        , m_buckets(0)
+    {}
+
+    /// keys must be distinct
+    void build(const std::vector<int64_t>& keys);
+
+    /// position of key in 0..size(), unique among the built keys. any other
+    /// key also gets a position in range which the caller must check
+    uint32_t operator()(int64_t key) const
+    {
+        if (!m_keys)
+            return 0;
+
+        const uint64_t h = mix(uint64_t(key) ^ m_seed);
+        const uint32_t p = position(h, m_pilots[reduce(uint32_t(h >> 32), m_buckets)]);
+        return p < m_keys ? p : m_remap[p - m_keys];
+    }
+
+    uint32_t size() const { return m_keys; }
+
+    size_t bytes() const
+    {
+        return sizeof(*this) + m_pilots.capacity() * sizeof(uint16_t)
+            + m_remap.capacity() * sizeof(uint32_t);
+    }
+};
+
+/// the values of a frozen store packed into one buffer
+/// each value is kept as the sequence of calls emitting it made on a sink,
+/// so all kinds that are only ever emitted whole can be packed and replay
+/// exactly as before, record keys included. values are handed out as
+/// shared_ptrs sharing ownership of the whole pack
+class PackedValues
+{
+    class Packed;
+    class Writer;
+    class Steps;
+
+    std::vector<char> m_data;
+    std::vector<boost::shared_ptr<const RecordLayout> > m_layouts;
+    std::map<const RecordLayout*, uint32_t> m_layout_ids;
+
+    // offset and kind of each value added, then the values once finished
+    std::vector<std::pair<size_t, JsValue::Kind> > m_added;
+    Packed* m_values;
+
+    /// replay one call from p into out, returns the depth change
+    int replay(const char*& p, ValueSink& out) const;
+
+    PackedValues(const PackedValues&);
+    PackedValues& operator=(const PackedValues&);
+
+public:
+    PackedValues();
+    ~PackedValues();
+
+    /// plain numbers, strings, arrays, objects and records, not the values
+    /// with their own operations like hashes or deques
+    static bool packable(const JsValue& val);
+
+    /// pack val at the end
+    void add(const JsValue& val);
+
+    /// the packed values in the order they were added, call once after the
+    /// last add with the shared_ptr owning this
+    static void finish(const boost::shared_ptr<PackedValues>& self,
+                       std::vector<boost::shared_ptr<JsValue> >& out);
+};
+
+} // namespace bypass
+
+#endif
@@ -0,0 +1,106 @@
+#include "hash.h"
+
+using namespace boost;
+
+namespace bypass {
+
+Footprint JsHash::field_size(const std::string& name, const JsValue& val)
+{
+    // bucket chain link and hash alongside the pair
+    Footprint out;
+    out.bytes += sizeof(FieldMap::value_type) + 2 * sizeof(void*) + name.capacity();
+    val.measure(out);
+    return out;
+}
+
+bool JsHash::set(const std::string& field, const shared_ptr<JsValue>& val)
+{
+    std::pair<FieldMap::iterator, bool> res = m_fields.insert(std::make_pair(field, val));
+    if (!res.second)
+    {
+        const Footprint old = field_size(res.first->first, *res.first->second);
+        m_size.bytes -= old.bytes;
+        m_size.nodes -= old.nodes;
+        res.first->second = val;
+    }
+
+    const Footprint now = field_size(res.first->first, *val);
+    m_size.bytes += now.bytes;
+    m_size.nodes += now.nodes;
+    return res.second;
+}
+
+const JsValue* JsHash::get(const std::string& field) const
+{
+    FieldMap::const_iterator iter = m_fields.find(field);
+    if (iter == m_fields.end())
+        return 0;
+    return iter->second.get();
+}
+
+bool JsHash::del(const std::string& field)
+{
+    FieldMap::iterator iter = m_fields.find(field);
+    if (iter == m_fields.end())
+        return false;
+
+    const Footprint old = field_size(iter->first, *iter->second);
+    m_size.bytes -= old.bytes;
+    m_size.nodes -= old.nodes;
+    m_fields.erase(iter);
+    return true;
+}
+
+void JsHash::emit(ValueSink& out) const
+{
+    out.begin_object(m_fields.size());
+
+    FieldMap::const_iterator iter = m_fields.begin();
+    for (; iter != m_fields.end() ; ++iter)
+    {
+        out.key(iter->first.data(), iter->first.size());
+        iter->second->emit(out);
+    }
+
+    out.end_object();
+}
+
+void JsHash::measure(Footprint& out) const
+{
+    out.bytes += sizeof(*this) + m_fields.bucket_count() * sizeof(void*) + m_size.bytes;
+    out.nodes += 1 + m_size.nodes;
+}
+
+class JsHash::Members : public JsValue::Walk
+{
+    const JsHash& m_hash;
+    FieldMap::const_iterator m_iter;
+
+public:
+    Members(const JsHash& hash)
+        : m_hash(hash)
+        , m_iter(hash.m_fields.begin())
+    {}
+
+    virtual bool next(ValueSink& out, const JsValue*& child)
+    {
+        if (m_iter == m_hash.m_fields.end())
+        {
+            out.end_object();
+            return false;
+        }
+
+        out.key(m_iter->first.data(), m_iter->first.size());
+        child = m_iter->second.get();
+        ++m_iter;
+        return true;
+    }
+};
+
+JsValue::Walk* JsHash::walk(ValueSink& out) const
+{
+    out.begin_object(m_fields.size());
+    return new Members(*this);
+}
+
+} // namespace bypass
@@ -0,0 +1,52 @@
+#ifndef BYPASS_HASH_H
+#define BYPASS_HASH_H
+
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "value.h"
+
+namespace bypass {
+
+/// string fields mapped to values, as redis hashes
+/// fields are set and removed one at a time in place and the footprint of
+/// the fields is kept up to date as they change, so measuring is O(1).
+/// emits as an object
+class JsHash : public JsValue
+{
+    typedef boost::unordered_map<std::string, boost::shared_ptr<JsValue> > FieldMap;
+    FieldMap m_fields;
+
+    // every field with its value, the buckets are added by measure()
+    Footprint m_size;
+
+    class Members;
+
+    static Footprint field_size(const std::string& name, const JsValue& val);
+
+public:
+    virtual Kind kind() const { return KIND_HASH; }
+
+    uint32_t size() const { return m_fields.size(); }
+
+    /// set field to val, true if the field is new
+    bool set(const std::string& field, const boost::shared_ptr<JsValue>& val);
+
+    /// value of field, 0 if missing
+    const JsValue* get(const std::string& field) const;
+
+    /// true if the field was there
+    bool del(const std::string& field);
+
+    virtual void emit(ValueSink& out) const;
+
+    virtual void measure(Footprint& out) const;
+
+    virtual Walk* walk(ValueSink& out) const;
+};
+
+} // namespace bypass
+
+#endif
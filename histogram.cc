@@ -0,0 +1,82 @@
+#include <limits>
+
+#include "histogram.h"
+
+namespace bypass {
+
+namespace {
+
+// values below this are counted exactly
+const uint64_t kLinear = uint64_t(1) << Histogram::kSubBits;
+
+// sub buckets per power of two above kLinear
+const uint64_t kHalf = kLinear / 2;
+
+unsigned msb(uint64_t v)
+{
+    return 63 - __builtin_clzll(v);
+}
+
+} // namespace
+
+size_t Histogram::index_of(uint64_t v)
+{
+    if (v < kLinear)
+        return v;
+
+    // keep the kSubBits most significant bits
+    const unsigned shift = msb(v) - kSubBits + 1;
+    return (shift + 1) * kHalf + ((v >> shift) - kHalf);
+}
+
+uint64_t Histogram::value_at(size_t index)
+{
+    if (index < kLinear)
+        return index;
+
+    const unsigned shift = index / kHalf - 1;
+    const uint64_t sub = index % kHalf + kHalf;
+
+    // report the middle of the bucket
+    return (sub << shift) + ((uint64_t(1) << shift) >> 1);
+}
+
+Histogram::Histogram()
+    : m_counts(index_of(kMaxValue) + 1)
+{
+    reset();
+}
+
+void Histogram::reset()
+{
+    m_counts.assign(m_counts.size(), 0);
+    m_total = 0;
+    m_min = std::numeric_limits<uint64_t>::max();
+    m_max = 0;
+    m_sum = 0;
+}
+
+uint64_t Histogram::percentile(double q) const
+{
+    if (m_total == 0)
+        return 0;
+
+    uint64_t want = uint64_t(q * m_total + 0.5);
+    if (want == 0)
+        want = 1;
+
+    uint64_t seen = 0;
+    for (size_t i=0 ; i<m_counts.size() ; ++i)
+    {
+        seen += m_counts[i];
+        if (seen >= want)
+        {
+            const uint64_t v = value_at(i);
+            return v < m_min ? m_min : (v > m_max ? m_max : v);
+        }
+    }
+
+    return m_max;
+}
+
+} // namespace bypass
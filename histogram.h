@@ -0,0 +1,61 @@
+#ifndef BYPASS_HISTOGRAM_H
+#define BYPASS_HISTOGRAM_H
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace bypass {
+
+/// hdr style histogram with log-linear buckets
+/// every power of two range is split into 128 linear sub buckets so any
+/// recorded value is reported within 1% of its true value. values past
+/// kMaxValue are clamped into the last bucket
+class Histogram
+{
+public:
+    static const unsigned kSubBits = 8;
+    static const uint64_t kMaxValue = (uint64_t(1) << 40) - 1;
+
+private:
+    std::vector<uint64_t> m_counts;
+    uint64_t m_total;
+    uint64_t m_min;
+    uint64_t m_max;
+    double m_sum;
+
+    static size_t index_of(uint64_t v);
+    static uint64_t value_at(size_t index);
+
+public:
+    Histogram();
+
+    void record(uint64_t v)
+    {
+        if (v > kMaxValue)
+            v = kMaxValue;
+
+        ++m_counts[index_of(v)];
+        ++m_total;
+        m_sum += v;
+        if (v < m_min)
+            m_min = v;
+        if (v > m_max)
+            m_max = v;
+    }
+
+    void reset();
+
+    uint64_t count() const { return m_total; }
+    uint64_t min() const { return m_total ? m_min : 0; }
+    uint64_t max() const { return m_max; }
+    double mean() const { return m_total ? m_sum / m_total : 0; }
+
+    /// smallest recorded value v such that a fraction q of values are <= v
+    uint64_t percentile(double q) const;
+};
+
+} // namespace bypass
+
+#endif
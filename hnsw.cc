@@ -0,0 +1,224 @@
+#include <cmath>
+#include <queue>
+#include <algorithm>
+#include <functional>
+
+#include "hnsw.h"
+
+namespace bypass {
+
+Hnsw::Hnsw(const Space& space, uint32_t m, uint32_t ef_construction)
+    : m_space(space)
+    , m_m(m < 2 ? 2 : m)
+    , m_ef_construction(ef_construction < m_m ? m_m : ef_construction)
+    , m_level_mult(1 / std::log(double(m_m)))
+    , m_seed(0x2545f4914f6cdd1dull)
+    , m_entry(0)
+    , m_top(-1)
+    , m_visit(0)
+{}
+
+int Hnsw::random_level()
+{
+    // xorshift to a uniform double in (0, 1]
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 7;
+    m_seed ^= m_seed << 17;
+    const double u = double((m_seed >> 11) + 1) / double(uint64_t(1) << 53);
+    return int(-std::log(u) * m_level_mult);
+}
+
+uint32_t Hnsw::greedy(const float* q, uint32_t entry, int layer) const
+{
+    uint32_t cur = entry;
+    float best = m_space.distance(q, m_space.vector(cur));
+
+    for (bool moved = true ; moved ; )
+    {
+        moved = false;
+        const std::vector<uint32_t>& links = m_nodes[cur].links[layer];
+        for (size_t i=0 ; i<links.size() ; ++i)
+        {
+            const float d = m_space.distance(q, m_space.vector(links[i]));
+            if (d < best)
+            {
+                best = d;
+                cur = links[i];
+                moved = true;
+            }
+        }
+    }
+    return cur;
+}
+
+void Hnsw::search_layer(const float* q, uint32_t entry, size_t ef, int layer,
+                        std::vector<Candidate>& out) const
+{
+    if (m_visited.size() < m_nodes.size())
+        m_visited.resize(m_nodes.size(), 0);
+    if (++m_visit == 0)
+    {
+        std::fill(m_visited.begin(), m_visited.end(), 0);
+        m_visit = 1;
+    }
+
+    // candidates to expand nearest first, results farthest first
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate> > todo;
+    std::priority_queue<Candidate> found;
+
+    const Candidate start(m_space.distance(q, m_space.vector(entry)), entry);
+    todo.push(start);
+    found.push(start);
+    m_visited[entry] = m_visit;
+
+    while (!todo.empty())
+    {
+        const Candidate c = todo.top();
+        if (c.first > found.top().first && found.size() >= ef)
+            break;
+        todo.pop();
+
+        const std::vector<uint32_t>& links = m_nodes[c.second].links[layer];
+        for (size_t i=0 ; i<links.size() ; ++i)
+        {
+            const uint32_t n = links[i];
+            if (m_visited[n] == m_visit)
+                continue;
+            m_visited[n] = m_visit;
+
+            const float d = m_space.distance(q, m_space.vector(n));
+            if (found.size() < ef || d < found.top().first)
+            {
+                todo.push(Candidate(d, n));
+                found.push(Candidate(d, n));
+                if (found.size() > ef)
+                    found.pop();
+            }
+        }
+    }
+
+    out.resize(found.size());
+    for (size_t i=out.size() ; i>0 ; --i)
+    {
+        out[i - 1] = found.top();
+        found.pop();
+    }
+}
+
+void Hnsw::select(std::vector<Candidate>& candidates, size_t n) const
+{
+    std::sort(candidates.begin(), candidates.end());
+
+    std::vector<Candidate> kept;
+    for (size_t i=0 ; i<candidates.size() && kept.size()<n ; ++i)
+    {
+        const float* v = m_space.vector(candidates[i].second);
+
+        bool diverse = true;
+        for (size_t j=0 ; j<kept.size() && diverse ; ++j)
+            diverse = m_space.distance(v, m_space.vector(kept[j].second)) >= candidates[i].first;
+
+        if (diverse)
+            kept.push_back(candidates[i]);
+    }
+
+    candidates.swap(kept);
+}
+
+void Hnsw::link(uint32_t from, uint32_t to, int layer)
+{
+    std::vector<uint32_t>& links = m_nodes[from].links[layer];
+    links.push_back(to);
+    if (links.size() <= max_links(layer))
+        return;
+
+    // too many, keep the most useful ones
+    const float* v = m_space.vector(from);
+    std::vector<Candidate> candidates(links.size());
+    for (size_t i=0 ; i<links.size() ; ++i)
+        candidates[i] = Candidate(m_space.distance(v, m_space.vector(links[i])), links[i]);
+
+    select(candidates, max_links(layer));
+
+    links.resize(candidates.size());
+    for (size_t i=0 ; i<candidates.size() ; ++i)
+        links[i] = candidates[i].second;
+}
+
+void Hnsw::insert(uint32_t slot)
+{
+    if (m_nodes.size() <= slot)
+        m_nodes.resize(slot + 1);
+
+    const int level = random_level();
+    m_nodes[slot].links.assign(level + 1, std::vector<uint32_t>());
+
+    if (m_top < 0)
+    {
+        m_entry = slot;
+        m_top = level;
+        return;
+    }
+
+    const float* q = m_space.vector(slot);
+    uint32_t cur = m_entry;
+    for (int layer=m_top ; layer>level ; --layer)
+        cur = greedy(q, cur, layer);
+
+    std::vector<Candidate> near;
+    for (int layer=std::min(level, m_top) ; layer>=0 ; --layer)
+    {
+        search_layer(q, cur, m_ef_construction, layer, near);
+        cur = near[0].second;
+
+        select(near, m_m);
+        std::vector<uint32_t>& links = m_nodes[slot].links[layer];
+        for (size_t i=0 ; i<near.size() ; ++i)
+        {
+            links.push_back(near[i].second);
+            link(near[i].second, slot, layer);
+        }
+    }
+
+    if (level > m_top)
+    {
+        m_entry = slot;
+        m_top = level;
+    }
+}
+
+void Hnsw::search(const float* q, size_t ef, std::vector<Candidate>& out) const
+{
+    out.clear();
+    if (m_top < 0)
+        return;
+
+    uint32_t cur = m_entry;
+    for (int layer=m_top ; layer>0 ; --layer)
+        cur = greedy(q, cur, layer);
+
+    search_layer(q, cur, ef, 0, out);
+}
+
+void Hnsw::clear()
+{
+    m_nodes.clear();
+    m_visited.clear();
+    m_top = -1;
+}
+
+size_t Hnsw::bytes() const
+{
+    size_t out = sizeof(*this) + m_nodes.capacity() * sizeof(Node)
+        + m_visited.capacity() * sizeof(uint32_t);
+    for (size_t i=0 ; i<m_nodes.size() ; ++i)
+    {
+        const std::vector<std::vector<uint32_t> >& links = m_nodes[i].links;
+        out += links.capacity() * sizeof(links[0]);
+        for (size_t l=0 ; l<links.size() ; ++l)
+            out += links[l].capacity() * sizeof(uint32_t);
+    }
+    return out;
+}
+
+} // namespace bypass
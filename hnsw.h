@@ -0,0 +1,90 @@
+#ifndef BYPASS_HNSW_H
+#define BYPASS_HNSW_H
+
+#include <vector>
+#include <utility>
+
+#include <stdint.h>
+
+namespace bypass {
+
+/// hierarchical navigable small world graph for approximate nearest
+/// neighbour search, after Malkov and Yashunin
+/// nodes are the slots of a Space that owns the vectors. each node is on
+/// layer 0 and on each layer above with probability 1/m, and links to up
+/// to m neighbours per layer (2m on layer 0) picked with the paper's
+/// diversity heuristic. a search descends greedily from the single entry
+/// point on the top layer and widens to ef candidates on layer 0.
+/// nodes cannot be removed, owners mark them dead and rebuild
+class Hnsw
+{
+public:
+    /// where the vectors are, lower distances are nearer
+    class Space
+    {
+    public:
+        virtual ~Space() {}
+        virtual const float* vector(uint32_t slot) const = 0;
+        virtual float distance(const float* a, const float* b) const = 0;
+    };
+
+    /// distance and slot
+    typedef std::pair<float, uint32_t> Candidate;
+
+private:
+    struct Node
+    {
+        // neighbours by layer, empty for slots not in the graph
+        std::vector<std::vector<uint32_t> > links;
+    };
+
+    const Space& m_space;
+    uint32_t m_m;
+    uint32_t m_ef_construction;
+    double m_level_mult;
+    uint64_t m_seed;
+
+    std::vector<Node> m_nodes;
+    uint32_t m_entry;
+    int m_top;
+
+    // visit marks for searches, a mark equal to m_visit is visited
+    mutable std::vector<uint32_t> m_visited;
+    mutable uint32_t m_visit;
+
+    int random_level();
+
+    uint32_t max_links(int layer) const { return layer ? m_m : 2 * m_m; }
+
+    /// closest node to q on layer reached greedily from entry
+    uint32_t greedy(const float* q, uint32_t entry, int layer) const;
+
+    /// up to ef nearest nodes to q on layer, nearest first
+    void search_layer(const float* q, uint32_t entry, size_t ef, int layer,
+                      std::vector<Candidate>& out) const;
+
+    /// keep at most n of candidates sorted nearest first, skipping any that
+    /// is nearer to a kept one than to the base
+    void select(std::vector<Candidate>& candidates, size_t n) const;
+
+    void link(uint32_t from, uint32_t to, int layer);
+
+public:
+    Hnsw(const Space& space, uint32_t m, uint32_t ef_construction);
+
+    /// add the vector at slot
+    void insert(uint32_t slot);
+
+    /// up to ef nodes nearest to q, nearest first
+    void search(const float* q, size_t ef, std::vector<Candidate>& out) const;
+
+    bool empty() const { return m_top < 0; }
+
+    void clear();
+
+    size_t bytes() const;
+};
+
+} // namespace bypass
+
+#endif
@@ -0,0 +1,198 @@
+#include <algorithm>
+
+#include "hotkeys.h"
+
+namespace bypass {
+
+namespace {
+
+bool hotter(const HotKeys::Counter& a, const HotKeys::Counter& b)
+{
+    return a.count > b.count;
+}
+
+} // namespace
+
+HotKeys::HotKeys(size_t capacity)
+    : m_capacity(capacity ? capacity : 1)
+{
+    // keep the table at most half full so probes stay short
+    size_t size = 2;
+    while (size < m_capacity * 2)
+        size *= 2;
+
+    m_nodes.reserve(m_capacity);
+    m_buckets.resize(m_capacity);
+    m_table.resize(size);
+    m_mask = size - 1;
+
+    reset();
+}
+
+void HotKeys::erase_slot(uint32_t s)
+{
+    // backward shift deletion keeps every probe chain unbroken
+    uint32_t hole = s;
+    for (uint32_t next = (s + 1) & m_mask ; m_table[next] ; next = (next + 1) & m_mask)
+    {
+        Node& n = m_nodes[m_table[next] - 1];
+        const uint32_t h = home(n.key);
+
+        // entries already between their home and the hole stay put
+        if (((next - h) & m_mask) < ((next - hole) & m_mask))
+            continue;
+
+        m_table[hole] = m_table[next];
+        n.slot = hole;
+        hole = next;
+    }
+    m_table[hole] = 0;
+}
+
+uint32_t HotKeys::new_bucket(uint64_t count, uint32_t prev, uint32_t next)
+{
+    const uint32_t b = m_free;
+    m_free = m_buckets[b].next;
+
+    Bucket& bucket = m_buckets[b];
+    bucket.count = count;
+    bucket.head = kNone;
+    bucket.prev = prev;
+    bucket.next = next;
+
+    if (prev != kNone)
+        m_buckets[prev].next = b;
+    else
+        m_min = b;
+    if (next != kNone)
+        m_buckets[next].prev = b;
+
+    return b;
+}
+
+void HotKeys::link(uint32_t n, uint32_t b)
+{
+    Node& node = m_nodes[n];
+    Bucket& bucket = m_buckets[b];
+
+    node.bucket = b;
+    node.prev = kNone;
+    node.next = bucket.head;
+    if (bucket.head != kNone)
+        m_nodes[bucket.head].prev = n;
+    bucket.head = n;
+}
+
+void HotKeys::unlink(uint32_t n)
+{
+    Node& node = m_nodes[n];
+    Bucket& bucket = m_buckets[node.bucket];
+
+    if (node.prev != kNone)
+        m_nodes[node.prev].next = node.next;
+    else
+        bucket.head = node.next;
+    if (node.next != kNone)
+        m_nodes[node.next].prev = node.prev;
+
+    if (bucket.head != kNone)
+        return;
+
+    // an empty bucket goes back on the free list
+    if (bucket.prev != kNone)
+        m_buckets[bucket.prev].next = bucket.next;
+    else
+        m_min = bucket.next;
+    if (bucket.next != kNone)
+        m_buckets[bucket.next].prev = bucket.prev;
+
+    bucket.next = m_free;
+    m_free = node.bucket;
+}
+
+void HotKeys::increment(uint32_t n)
+{
+    const uint32_t b = m_nodes[n].bucket;
+    const uint64_t count = m_buckets[b].count + 1;
+
+    uint32_t next = m_buckets[b].next;
+    if (next == kNone || m_buckets[next].count != count)
+    {
+        // a node alone in its bucket can keep it
+        const Node& node = m_nodes[n];
+        if (node.prev == kNone && node.next == kNone)
+        {
+            m_buckets[b].count = count;
+            return;
+        }
+        next = new_bucket(count, b, next);
+    }
+
+    unlink(n);
+    link(n, next);
+}
+
+void HotKeys::replace(int64_t key, uint32_t slot)
+{
+    if (m_nodes.size() < m_capacity)
+    {
+        Node node;
+        node.key = key;
+        node.error = 0;
+        node.slot = slot;
+        m_nodes.push_back(node);
+
+        const uint32_t n = m_nodes.size() - 1;
+        m_table[slot] = n + 1;
+
+        uint32_t b = m_min;
+        if (b == kNone || m_buckets[b].count != 1)
+            b = new_bucket(1, kNone, b);
+        link(n, b);
+        return;
+    }
+
+    // take over a counter with the smallest count, removing the old key
+    // may move the empty slot found for the new one so probe again
+    const uint32_t n = m_buckets[m_min].head;
+    Node& node = m_nodes[n];
+    erase_slot(node.slot);
+
+    node.key = key;
+    node.error = m_buckets[m_min].count;
+    node.slot = probe(key);
+    m_table[node.slot] = n + 1;
+
+    increment(n);
+}
+
+std::vector<HotKeys::Counter> HotKeys::top(size_t k) const
+{
+    std::vector<Counter> out;
+    out.reserve(m_nodes.size());
+    for (size_t i=0 ; i<m_nodes.size() ; ++i)
+    {
+        const Node& node = m_nodes[i];
+        Counter c = { node.key, m_buckets[node.bucket].count, node.error };
+        out.push_back(c);
+    }
+
+    k = std::min(k, out.size());
+    std::partial_sort(out.begin(), out.begin() + k, out.end(), hotter);
+    out.resize(k);
+    return out;
+}
+
+void HotKeys::reset()
+{
+    m_nodes.clear();
+    std::fill(m_table.begin(), m_table.end(), 0);
+    m_total = 0;
+
+    m_min = kNone;
+    m_free = 0;
+    for (uint32_t i=0 ; i<m_buckets.size() ; ++i)
+        m_buckets[i].next = i + 1 < m_buckets.size() ? i + 1 : kNone;
+}
+
+} // namespace bypass
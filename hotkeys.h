@@ -0,0 +1,132 @@
+#ifndef BYPASS_HOTKEYS_H
+#define BYPASS_HOTKEYS_H
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace bypass {
+
+/// space-saving heavy hitters sketch (Metwally et al.)
+/// keeps a fixed number of counters. an untracked key takes over a counter
+/// with the smallest count and inherits that count as its error bound, so
+/// any key accessed more than total/capacity times is always present.
+/// counters live in the stream summary layout of the paper, linked into
+/// buckets of equal count, so every access is O(1). all memory is sized at
+/// creation and nothing is allocated per access
+class HotKeys
+{
+public:
+    struct Counter
+    {
+        int64_t key;
+
+        // count - error <= true count <= count
+        uint64_t count;
+        uint64_t error;
+    };
+
+private:
+    static const uint32_t kNone = 0xffffffff;
+
+    struct Node
+    {
+        int64_t key;
+        uint64_t error;
+
+        // position of this node's entry in the table
+        uint32_t slot;
+
+        uint32_t bucket;
+        uint32_t prev;
+        uint32_t next;
+    };
+
+    struct Bucket
+    {
+        uint64_t count;
+
+        // first node with this count
+        uint32_t head;
+
+        // buckets are kept in increasing count order
+        uint32_t prev;
+        uint32_t next;
+    };
+
+    std::vector<Node> m_nodes;
+    std::vector<Bucket> m_buckets;
+
+    // unused buckets, linked through next
+    uint32_t m_free;
+
+    // bucket with the smallest count
+    uint32_t m_min;
+
+    // node index + 1 of the counter for a key, 0 when empty
+    std::vector<uint32_t> m_table;
+    uint32_t m_mask;
+
+    size_t m_capacity;
+    uint64_t m_total;
+
+    uint32_t home(int64_t key) const
+    {
+        uint64_t h = uint64_t(key) * 0x9e3779b97f4a7c15ull;
+        return uint32_t(h >> 32) & m_mask;
+    }
+
+    /// table slot holding key or the empty slot where it would go
+    uint32_t probe(int64_t key) const
+    {
+        uint32_t s = home(key);
+        while (m_table[s] && m_nodes[m_table[s] - 1].key != key)
+            s = (s + 1) & m_mask;
+        return s;
+    }
+
+    void erase_slot(uint32_t s);
+
+    uint32_t new_bucket(uint64_t count, uint32_t prev, uint32_t next);
+    void link(uint32_t n, uint32_t b);
+    void unlink(uint32_t n);
+
+    /// move node n to the bucket one count higher
+    void increment(uint32_t n);
+
+    /// count the first access of an untracked key
+    void replace(int64_t key, uint32_t slot);
+
+public:
+    /// most counters a tracker may keep, slots are 32 bit
+    static const size_t kMaxCapacity = size_t(1) << 24;
+
+    /// capacity must be at most kMaxCapacity
+    HotKeys(size_t capacity);
+
+    void touch(int64_t key)
+    {
+        ++m_total;
+
+        const uint32_t s = probe(key);
+        if (m_table[s])
+            increment(m_table[s] - 1);
+        else
+            replace(key, s);
+    }
+
+    /// up to k counters with the highest counts, highest first
+    std::vector<Counter> top(size_t k) const;
+
+    /// accesses counted since the last reset
+    uint64_t total() const { return m_total; }
+
+    size_t capacity() const { return m_capacity; }
+
+    void reset();
+};
+
+} // namespace bypass
+
+#endif
@@ -0,0 +1,101 @@
+#include "index.h"
+
+namespace bypass {
+
+FieldPath parse_path(const std::string& dotted)
+{
+    FieldPath out;
+    if (dotted.empty())
+        return out;
+
+    size_t start = 0;
+    for (;;)
+    {
+        const size_t dot = dotted.find('.', start);
+        out.push_back(dotted.substr(start, dot == std::string::npos ? std::string::npos : dot - start));
+        if (dot == std::string::npos)
+            return out;
+        start = dot + 1;
+    }
+}
+
+int PathSink::match() const
+{
+    for (size_t p=0 ; p<m_paths.size() ; ++p)
+    {
+        const FieldPath& path = m_paths[p];
+
+        // arrays are transparent, each object level takes one name
+        size_t depth = 0;
+        bool same = true;
+        for (size_t i=0 ; i<m_stack.size() && same ; ++i)
+        {
+            if (m_stack[i].array)
+                continue;
+            same = depth < path.size() && m_stack[i].key == path[depth];
+            ++depth;
+        }
+
+        if (same && depth == path.size())
+            return int(p);
+    }
+    return -1;
+}
+
+void PathSink::found(size_t, const char*, size_t)
+{
+}
+
+void PathSink::found(size_t, double)
+{
+}
+
+void PathSink::number(double val)
+{
+    const int p = match();
+    if (p >= 0)
+        found(p, val);
+}
+
+void PathSink::int32(int32_t val)
+{
+    number(val);
+}
+
+void PathSink::string(const char* data, size_t length)
+{
+    const int p = match();
+    if (p >= 0)
+        found(p, data, length);
+}
+
+void PathSink::begin_array(uint32_t)
+{
+    Frame f;
+    f.array = true;
+    m_stack.push_back(f);
+}
+
+void PathSink::end_array()
+{
+    m_stack.pop_back();
+}
+
+void PathSink::begin_object(uint32_t)
+{
+    Frame f;
+    f.array = false;
+    m_stack.push_back(f);
+}
+
+void PathSink::key(const char* name, size_t length)
+{
+    m_stack.back().key.assign(name, length);
+}
+
+void PathSink::end_object()
+{
+    m_stack.pop_back();
+}
+
+} // namespace bypass
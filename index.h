@@ -0,0 +1,77 @@
+#ifndef BYPASS_INDEX_H
+#define BYPASS_INDEX_H
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "value.h"
+
+namespace bypass {
+
+/// secondary index over the values of a store
+/// told about every value stored under a key and every value removed.
+/// a value changed in place (hset, append, ...) is removed and added again
+/// after the change, so remove must forget the key by what add saw then
+/// rather than by the value it is passed
+class StoreIndex
+{
+public:
+    virtual ~StoreIndex() {}
+
+    virtual void add(int64_t key, const JsValue& val) = 0;
+    virtual void remove(int64_t key, const JsValue& val) = 0;
+    virtual void clear() = 0;
+
+    /// memory held by the index
+    virtual size_t bytes() const = 0;
+};
+
+/// member names leading from a value to one of its members
+/// "a.b" is {"a", "b"}, the empty string is the value itself
+typedef std::vector<std::string> FieldPath;
+
+FieldPath parse_path(const std::string& dotted);
+
+/// finds the scalars at a set of paths while a value is emitted into it
+/// elements of an array are at the path of the array
+class PathSink : public ValueSink
+{
+    struct Frame
+    {
+        bool array;
+        std::string key;
+    };
+
+    const std::vector<FieldPath>& m_paths;
+    std::vector<Frame> m_stack;
+
+    /// position in m_paths of the path of the current value, -1 for none
+    int match() const;
+
+protected:
+    virtual void found(size_t path, const char* data, size_t length);
+    virtual void found(size_t path, double val);
+
+public:
+    explicit PathSink(const std::vector<FieldPath>& paths)
+        : m_paths(paths)
+    {}
+
+    virtual void undefined() {}
+    virtual void number(double val);
+    virtual void int32(int32_t val);
+    virtual void string(const char* data, size_t length);
+
+    virtual void begin_array(uint32_t size);
+    virtual void end_array();
+
+    virtual void begin_object(uint32_t size);
+    virtual void key(const char* name, size_t length);
+    virtual void end_object();
+};
+
+} // namespace bypass
+
+#endif
@@ -0,0 +1,122 @@
+#include "list.h"
+
+using namespace boost;
+
+namespace bypass {
+
+namespace {
+
+/// memory of one element slot and the value in it
+void slot(const shared_ptr<JsValue>& val, Footprint& out)
+{
+    out.bytes += sizeof(val);
+    val->measure(out);
+}
+
+} // namespace
+
+shared_ptr<JsList> JsList::from(const JsValue& val)
+{
+    shared_ptr<JsList> out;
+    if (const JsList* list = dynamic_cast<const JsList*>(&val))
+    {
+        out.reset(new JsList(*list));
+    }
+    else if (const JsArray* arr = dynamic_cast<const JsArray*>(&val))
+    {
+        out.reset(new JsList());
+        out->m_items.assign(arr->elements().begin(), arr->elements().end());
+    }
+    return out;
+}
+
+void JsList::push_back(const shared_ptr<JsValue>& val, Footprint& added)
+{
+    m_items.push_back(val);
+    slot(val, added);
+}
+
+void JsList::push_front(const shared_ptr<JsValue>& val, Footprint& added)
+{
+    m_items.push_front(val);
+    slot(val, added);
+}
+
+shared_ptr<JsValue> JsList::pop_front(Footprint& removed)
+{
+    shared_ptr<JsValue> out = m_items.front();
+    m_items.pop_front();
+    slot(out, removed);
+    return out;
+}
+
+shared_ptr<JsValue> JsList::pop_back(Footprint& removed)
+{
+    shared_ptr<JsValue> out = m_items.back();
+    m_items.pop_back();
+    slot(out, removed);
+    return out;
+}
+
+void JsList::trim_front(size_t max, Footprint& removed)
+{
+    while (m_items.size() > max)
+    {
+        slot(m_items.front(), removed);
+        m_items.pop_front();
+    }
+}
+
+void JsList::emit(ValueSink& out) const
+{
+    out.begin_array(m_items.size());
+
+    Items::const_iterator iter = m_items.begin();
+    for (; iter != m_items.end() ; ++iter)
+        (*iter)->emit(out);
+
+    out.end_array();
+}
+
+void JsList::measure(Footprint& out) const
+{
+    // the chunks hold nothing but the slots, so their size follows the length
+    out.bytes += sizeof(*this);
+    ++out.nodes;
+
+    Items::const_iterator iter = m_items.begin();
+    for (; iter != m_items.end() ; ++iter)
+        slot(*iter, out);
+}
+
+class JsList::Members : public JsValue::Walk
+{
+    const JsList& m_list;
+    size_t m_next;
+
+public:
+    Members(const JsList& list)
+        : m_list(list)
+        , m_next(0)
+    {}
+
+    virtual bool next(ValueSink& out, const JsValue*& child)
+    {
+        if (m_next == m_list.m_items.size())
+        {
+            out.end_array();
+            return false;
+        }
+
+        child = m_list.m_items[m_next++].get();
+        return true;
+    }
+};
+
+JsValue::Walk* JsList::walk(ValueSink& out) const
+{
+    out.begin_array(m_items.size());
+    return new Members(*this);
+}
+
+} // namespace bypass
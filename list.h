@@ -0,0 +1,57 @@
+#ifndef BYPASS_LIST_H
+#define BYPASS_LIST_H
+
+#include <deque>
+
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include "value.h"
+
+namespace bypass {
+
+/// array that grows and shrinks at its ends in place, also the deque type
+/// elements are kept in fixed size chunks by a std::deque, so an append
+/// never copies the elements already stored and the footprint of a change
+/// is known without measuring the whole list again. emits as a plain array
+class JsList : public JsValue
+{
+    typedef std::deque<boost::shared_ptr<JsValue> > Items;
+    Items m_items;
+
+    class Members;
+
+public:
+    virtual Kind kind() const { return KIND_ARRAY; }
+
+    /// copy of the elements of an array or list, empty if val is neither
+    static boost::shared_ptr<JsList> from(const JsValue& val);
+
+    uint32_t size() const { return m_items.size(); }
+
+    /// add val to the end, its footprint is added to added
+    void push_back(const boost::shared_ptr<JsValue>& val, Footprint& added);
+
+    /// add val to the front, its footprint is added to added
+    void push_front(const boost::shared_ptr<JsValue>& val, Footprint& added);
+
+    /// take the first or last element, the list must not be empty
+    /// its footprint is added to removed
+    boost::shared_ptr<JsValue> pop_front(Footprint& removed);
+    boost::shared_ptr<JsValue> pop_back(Footprint& removed);
+
+    /// drop elements from the front until at most max remain
+    /// the footprint of what was dropped is added to removed
+    void trim_front(size_t max, Footprint& removed);
+
+    virtual void emit(ValueSink& out) const;
+
+    virtual void measure(Footprint& out) const;
+
+    virtual Walk* walk(ValueSink& out) const;
+};
+
+} // namespace bypass
+
+#endif
@@ -0,0 +1,209 @@
+#include <map>
+#include <cstdio>
+
+#include "metrics.h"
+#include "store.h"
+
+namespace bypass {
+
+namespace {
+
+typedef std::map<uint32_t, const Store*> StoreMap;
+
+StoreMap& live()
+{
+    static StoreMap map;
+    return map;
+}
+
+/// label values escape backslash, quote and newline
+void append_escaped(std::string& out, const std::string& s)
+{
+    for (size_t i=0 ; i<s.size() ; ++i)
+    {
+        const char c = s[i];
+        if (c == '\\' || c == '"')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (c == '\n')
+        {
+            out += "\\n";
+        }
+        else
+        {
+            out += c;
+        }
+    }
+}
+
+class Writer
+{
+    std::string& m_out;
+
+public:
+    Writer(std::string& out)
+        : m_out(out)
+    {}
+
+    void family(const char* name, const char* type, const char* help)
+    {
+        m_out += "# HELP ";
+        m_out += name;
+        m_out += ' ';
+        m_out += help;
+        m_out += "\n# TYPE ";
+        m_out += name;
+        m_out += ' ';
+        m_out += type;
+        m_out += '\n';
+    }
+
+    /// name{store="...",extra} value, extra is preformatted
+    void sample(const char* name, const Store& store, const char* extra, double value)
+    {
+        char num[32];
+        snprintf(num, sizeof(num), "%.17g", value);
+
+        m_out += name;
+        m_out += "{store=\"";
+        append_escaped(m_out, store.name());
+        m_out += '"';
+        if (extra)
+        {
+            m_out += ',';
+            m_out += extra;
+        }
+        m_out += "} ";
+        m_out += num;
+        m_out += '\n';
+    }
+};
+
+void summary(Writer& w, const char* name, const Store& store, const char* op,
+             const Histogram& h, double scale)
+{
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+    char labels[64];
+    for (size_t i=0 ; i<sizeof(quantiles) / sizeof(quantiles[0]) ; ++i)
+    {
+        snprintf(labels, sizeof(labels), "op=\"%s\",quantile=\"%g\"", op, quantiles[i]);
+        w.sample(name, store, labels, h.percentile(quantiles[i]) * scale);
+    }
+
+    std::string sum(name);
+    std::string count(name);
+    sum += "_sum";
+    count += "_count";
+
+    snprintf(labels, sizeof(labels), "op=\"%s\"", op);
+    w.sample(sum.c_str(), store, labels, h.mean() * h.count() * scale);
+    w.sample(count.c_str(), store, labels, h.count());
+}
+
+} // namespace
+
+void MetricsRegistry::add(const Store* store)
+{
+    live()[store->id()] = store;
+}
+
+void MetricsRegistry::remove(const Store* store)
+{
+    live().erase(store->id());
+}
+
+std::vector<const Store*> MetricsRegistry::stores()
+{
+    std::vector<const Store*> out;
+
+    StoreMap::const_iterator iter = live().begin();
+    for (; iter != live().end() ; ++iter)
+        out.push_back(iter->second);
+
+    return out;
+}
+
+void render_metrics(const std::vector<const Store*>& stores, std::string& out)
+{
+    Writer w(out);
+    char labels[64];
+
+    w.family("bypass_entries", "gauge", "Keys held by the store.");
+    for (size_t i=0 ; i<stores.size() ; ++i)
+        w.sample("bypass_entries", *stores[i], 0, stores[i]->size());
+
+    w.family("bypass_values", "gauge", "Top level values by kind.");
+    for (size_t i=0 ; i<stores.size() ; ++i)
+    {
+        for (int k=0 ; k<JsValue::KIND_COUNT ; ++k)
+        {
+            const JsValue::Kind kind = JsValue::Kind(k);
+            snprintf(labels, sizeof(labels), "kind=\"%s\"", JsValue::kind_name(kind));
+            w.sample("bypass_values", *stores[i], labels, stores[i]->count(kind));
+        }
+    }
+
+    w.family("bypass_bytes", "gauge", "Memory held by values by kind of top level value.");
+    for (size_t i=0 ; i<stores.size() ; ++i)
+    {
+        for (int k=0 ; k<JsValue::KIND_COUNT ; ++k)
+        {
+            const JsValue::Kind kind = JsValue::Kind(k);
+            snprintf(labels, sizeof(labels), "kind=\"%s\"", JsValue::kind_name(kind));
+            w.sample("bypass_bytes", *stores[i], labels, stores[i]->bytes(kind));
+        }
+    }
+
+    w.family("bypass_sets_total", "counter", "Values stored.");
+    for (size_t i=0 ; i<stores.size() ; ++i)
+        w.sample("bypass_sets_total", *stores[i], 0, stores[i]->counters().sets);
+
+    w.family("bypass_hits_total", "counter", "Gets that found their key.");
+    for (size_t i=0 ; i<stores.size() ; ++i)
+        w.sample("bypass_hits_total", *stores[i], 0, stores[i]->counters().hits);
+
+    w.family("bypass_misses_total", "counter", "Gets that did not find their key.");
+    for (size_t i=0 ; i<stores.size() ; ++i)
+        w.sample("bypass_misses_total", *stores[i], 0, stores[i]->counters().misses);
+
+    w.family("bypass_deletes_total", "counter", "Keys deleted.");
+    for (size_t i=0 ; i<stores.size() ; ++i)
+        w.sample("bypass_deletes_total", *stores[i], 0, stores[i]->counters().dels);
+
+    // only stores with latency tracking on have durations
+    bool timed = false;
+    for (size_t i=0 ; i<stores.size() ; ++i)
+        timed = timed || stores[i]->latency();
+    if (!timed)
+        return;
+
+    w.family("bypass_op_duration_seconds", "summary",
+             "Time spent in store calls including encoding and decoding.");
+    for (size_t i=0 ; i<stores.size() ; ++i)
+    {
+        const OpLatency* l = stores[i]->latency();
+        if (!l)
+            continue;
+
+        summary(w, "bypass_op_duration_seconds", *stores[i], "set", l->set, 1e-9);
+        summary(w, "bypass_op_duration_seconds", *stores[i], "get", l->get, 1e-9);
+        summary(w, "bypass_op_duration_seconds", *stores[i], "del", l->del, 1e-9);
+        summary(w, "bypass_op_duration_seconds", *stores[i], "list", l->list, 1e-9);
+    }
+
+    w.family("bypass_value_size_bytes", "summary", "Size of values encoded by sets and decoded by gets.");
+    for (size_t i=0 ; i<stores.size() ; ++i)
+    {
+        const OpLatency* l = stores[i]->latency();
+        if (!l)
+            continue;
+
+        summary(w, "bypass_value_size_bytes", *stores[i], "encode", l->encode_bytes, 1);
+        summary(w, "bypass_value_size_bytes", *stores[i], "decode", l->decode_bytes, 1);
+    }
+}
+
+} // namespace bypass
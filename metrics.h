@@ -0,0 +1,28 @@
+#ifndef BYPASS_METRICS_H
+#define BYPASS_METRICS_H
+
+#include <string>
+#include <vector>
+
+namespace bypass {
+
+class Store;
+
+/// every live store, so one scrape can cover the whole process
+class MetricsRegistry
+{
+public:
+    static void add(const Store* store);
+    static void remove(const Store* store);
+
+    /// live stores in creation order
+    static std::vector<const Store*> stores();
+};
+
+/// append the metrics of stores to out in the prometheus text exposition
+/// format, each family once with a sample per store labelled by name
+void render_metrics(const std::vector<const Store*>& stores, std::string& out);
+
+} // namespace bypass
+
+#endif
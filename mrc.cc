@@ -0,0 +1,148 @@
+#include <algorithm>
+
+#include "mrc.h"
+
+namespace bypass {
+
+namespace {
+
+bool earlier(const std::pair<uint32_t, int64_t>& a, const std::pair<uint32_t, int64_t>& b)
+{
+    return a.first < b.first;
+}
+
+// quantiles of the reuse distances reported as curve points
+const double kQuantiles[] = { 0.05, 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 0.95, 0.99, 1 };
+
+} // namespace
+
+MissRatioCurve::MissRatioCurve(double rate, size_t max_keys)
+    : m_max_keys(max_keys < 1 ? 1 : max_keys > kMaxKeys ? size_t(kMaxKeys) : max_keys)
+{
+    if (rate <= 0 || rate > 1)
+        rate = 1;
+    m_threshold = uint32_t(rate * kModulus);
+    if (m_threshold == 0)
+        m_threshold = 1;
+    m_initial_threshold = m_threshold;
+
+    // time 0 is unused by the fenwick tree
+    m_marks.resize(m_max_keys * 4 + 1);
+    reset();
+}
+
+void MissRatioCurve::sample(int64_t key, uint32_t hash)
+{
+    ++m_sampled;
+
+    if (m_now >= m_marks.size())
+        compact();
+
+    SampleMap::iterator iter = m_samples.find(key);
+    if (iter != m_samples.end())
+    {
+        // other keys touched since the last access, scaled to all keys.
+        // an lru of that many keys plus one would have hit
+        const uint32_t last = iter->second.time;
+        const int64_t others = marks_to(m_now - 1) - marks_to(last);
+        m_distances.record(uint64_t(others / rate() + 0.5) + 1);
+
+        mark(last, -1);
+        iter->second.time = m_now;
+        mark(m_now++, 1);
+        return;
+    }
+
+    Sample s = { m_now, hash };
+    m_samples[key] = s;
+    m_by_hash.insert(std::make_pair(hash, key));
+    mark(m_now++, 1);
+
+    if (m_samples.size() > m_max_keys)
+        shrink();
+}
+
+void MissRatioCurve::compact()
+{
+    std::vector<std::pair<uint32_t, int64_t> > order;
+    order.reserve(m_samples.size());
+
+    SampleMap::const_iterator iter = m_samples.begin();
+    for (; iter != m_samples.end() ; ++iter)
+        order.push_back(std::make_pair(iter->second.time, iter->first));
+    std::sort(order.begin(), order.end(), earlier);
+
+    std::fill(m_marks.begin(), m_marks.end(), 0);
+    m_now = 1;
+    for (size_t i=0 ; i<order.size() ; ++i)
+    {
+        m_samples[order[i].second].time = m_now;
+        mark(m_now++, 1);
+    }
+}
+
+void MissRatioCurve::shrink()
+{
+    while (m_samples.size() > m_max_keys)
+    {
+        // drop every key sharing the largest hash and sample below it
+        const uint32_t largest = m_by_hash.rbegin()->first;
+        while (!m_by_hash.empty() && m_by_hash.rbegin()->first == largest)
+        {
+            const int64_t key = m_by_hash.rbegin()->second;
+            m_by_hash.erase(--m_by_hash.end());
+
+            SampleMap::iterator iter = m_samples.find(key);
+            mark(iter->second.time, -1);
+            m_samples.erase(iter);
+        }
+        m_threshold = largest;
+    }
+    m_rate = double(m_threshold) / kModulus;
+}
+
+std::vector<MissRatioCurve::Point> MissRatioCurve::curve() const
+{
+    std::vector<Point> out;
+    if (m_sampled == 0)
+        return out;
+
+    // the sampled accesses rarely match the count the rate predicts,
+    // SHARDS-adj credits the difference to the smallest distance
+    const double adjust = m_expected - m_sampled;
+
+    // accesses not in the histogram were first accesses and always miss
+    for (size_t i=0 ; i<sizeof(kQuantiles) / sizeof(kQuantiles[0]) ; ++i)
+    {
+        if (m_distances.count() == 0)
+            break;
+
+        Point p;
+        p.keys = m_distances.percentile(kQuantiles[i]);
+        p.hit_ratio = (kQuantiles[i] * m_distances.count() + adjust) / m_expected;
+        p.hit_ratio = std::min(1.0, std::max(0.0, p.hit_ratio));
+
+        // several quantiles can land in one bucket, keep the highest
+        if (!out.empty() && out.back().keys == p.keys)
+            out.back() = p;
+        else
+            out.push_back(p);
+    }
+
+    return out;
+}
+
+void MissRatioCurve::reset()
+{
+    m_samples.clear();
+    m_by_hash.clear();
+    std::fill(m_marks.begin(), m_marks.end(), 0);
+    m_now = 1;
+    m_distances.reset();
+    m_sampled = 0;
+    m_expected = 0;
+    m_threshold = m_initial_threshold;
+    m_rate = double(m_threshold) / kModulus;
+}
+
+} // namespace bypass
@@ -0,0 +1,133 @@
+#ifndef BYPASS_MRC_H
+#define BYPASS_MRC_H
+
+#include <set>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+
+#include "histogram.h"
+
+namespace bypass {
+
+/// online miss ratio curve for an lru cache, estimated with SHARDS
+/// (Waldspurger et al., FAST 15). only keys whose hash falls under a
+/// threshold are followed, and the reuse distance of each sampled access
+/// is scaled up by the sampling rate. the threshold is lowered whenever
+/// more than max_keys keys are followed so memory stays fixed
+class MissRatioCurve
+{
+public:
+    struct Point
+    {
+        // lru capacity in keys
+        uint64_t keys;
+
+        // fraction of accesses that would hit at that capacity
+        double hit_ratio;
+    };
+
+    static const uint64_t kModulus = uint64_t(1) << 24;
+
+private:
+    struct Sample
+    {
+        uint32_t time;
+        uint32_t hash;
+    };
+
+    typedef boost::unordered_map<int64_t, Sample> SampleMap;
+    SampleMap m_samples;
+
+    // sampled keys by hash so the largest can be dropped first
+    std::set<std::pair<uint32_t, int64_t> > m_by_hash;
+
+    // fenwick tree over access times, one mark per followed key at the
+    // time of its last access. counting marks after a time gives the
+    // number of distinct keys accessed since then
+    std::vector<int32_t> m_marks;
+    uint32_t m_now;
+
+    size_t m_max_keys;
+    uint32_t m_threshold;
+
+    // threshold from the configured rate, restored by reset
+    uint32_t m_initial_threshold;
+
+    // scaled reuse distances in keys, first accesses are not recorded
+    Histogram m_distances;
+    uint64_t m_sampled;
+
+    // sampled accesses expected from the rate in effect at each access
+    double m_expected;
+    double m_rate;
+
+    void mark(uint32_t time, int32_t delta)
+    {
+        for (; time < m_marks.size() ; time += time & -time)
+            m_marks[time] += delta;
+    }
+
+    /// marks at or before time
+    int64_t marks_to(uint32_t time) const
+    {
+        int64_t sum = 0;
+        for (; time > 0 ; time -= time & -time)
+            sum += m_marks[time];
+        return sum;
+    }
+
+    /// renumber the last access times 1..n once times run out
+    void compact();
+
+    void sample(int64_t key, uint32_t hash);
+
+    // splitmix64 finalizer, spreads sequential keys over the whole range
+    static uint64_t mix(uint64_t h)
+    {
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ull;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebull;
+        h ^= h >> 31;
+        return h;
+    }
+
+    /// lower the threshold until at most m_max_keys keys are followed
+    void shrink();
+
+public:
+    /// most keys a curve may follow, 4 marks of 4 bytes each per key
+    static const size_t kMaxKeys = size_t(1) << 22;
+
+    /// rate in (0, 1] and max_keys at most kMaxKeys
+    MissRatioCurve(double rate = 0.01, size_t max_keys = 8192);
+
+    void access(int64_t key)
+    {
+        m_expected += m_rate;
+
+        const uint32_t hash = uint32_t(mix(uint64_t(key)) % kModulus);
+        if (hash < m_threshold)
+            sample(key, hash);
+    }
+
+    /// current sampling rate
+    double rate() const { return m_rate; }
+
+    /// sampled accesses since the last reset
+    uint64_t sampled() const { return m_sampled; }
+
+    /// hit ratio against capacity, one point for each quantile of the
+    /// reuse distances in increasing capacity
+    std::vector<Point> curve() const;
+
+    void reset();
+};
+
+} // namespace bypass
+
+#endif
@@ -0,0 +1,11 @@
+#include "probes.h"
+
+#ifdef BYPASS_USDT
+
+// the tracer finds these through the probe notes and increments them
+extern "C" {
+unsigned short bypass_op__start_semaphore __attribute__((unused, section(".probes")));
+unsigned short bypass_op__done_semaphore __attribute__((unused, section(".probes")));
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef BYPASS_PROBES_H
+#define BYPASS_PROBES_H
+
+/// usdt probes for perf, bpftrace and systemtap
+/// built in when configure finds sys/sdt.h and defines BYPASS_USDT,
+/// otherwise every probe compiles to nothing. each probe has a semaphore
+/// the tracer raises while attached, so the clock is only read for the
+/// probes when something is listening
+///
+///   bpftrace -e 'usdt:build/default/bypass.node:bypass:op__done
+///                { @us[str(arg0)] = hist(arg4 / 1000); }'
+///
+/// op__start(op, key)
+/// op__done(op, key, bytes, nodes, duration_ns)
+
+#ifdef BYPASS_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+extern "C" {
+extern unsigned short bypass_op__start_semaphore;
+extern unsigned short bypass_op__done_semaphore;
+}
+
+#define BYPASS_PROBE_ENABLED(name) __builtin_expect(bypass_##name##_semaphore != 0, 0)
+#define BYPASS_PROBE2(name, a, b) STAP_PROBE2(bypass, name, a, b)
+#define BYPASS_PROBE5(name, a, b, c, d, e) STAP_PROBE5(bypass, name, a, b, c, d, e)
+
+#else
+
+#define BYPASS_PROBE_ENABLED(name) false
+#define BYPASS_PROBE2(name, a, b) do {} while (0)
+#define BYPASS_PROBE5(name, a, b, c, d, e) do {} while (0)
+
+#endif
+
+#endif
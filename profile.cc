@@ -0,0 +1,254 @@
+#include "profile.h"
+#include "clock.h"
+
+namespace bypass {
+
+const char* CodecProfile::phase_name(Phase phase)
+{
+    switch (phase)
+    {
+    case ENCODE: return "encode";
+    case ENUMERATE: return "enumerate";
+    case TRANSCODE_IN: return "transcodeIn";
+    case READ: return "read";
+    case INDEX: return "index";
+    case DECODE: return "decode";
+    case TRANSCODE_OUT: return "transcodeOut";
+    case BUILD: return "build";
+    case PHASE_COUNT: break;
+    }
+
+    return "unknown";
+}
+
+void CostStack::push(ValueSource::Type type, uint64_t now)
+{
+    Frame f;
+    f.type = type;
+    f.start = now;
+    f.child_ns = 0;
+    f.bytes = 0;
+    m_frames.push_back(f);
+}
+
+void CostStack::pop(uint64_t now)
+{
+    const Frame f = m_frames.back();
+    m_frames.pop_back();
+
+    const uint64_t total = now - f.start;
+    m_costs[f.type].add(total - f.child_ns, f.bytes);
+    if (!m_frames.empty())
+        m_frames.back().child_ns += total;
+}
+
+void CostStack::leaf(ValueSource::Type type, uint64_t ns, uint64_t bytes)
+{
+    m_costs[type].add(ns, bytes);
+    if (!m_frames.empty())
+        m_frames.back().child_ns += ns;
+}
+
+ProfilingSource::ProfilingSource(ValueSource& in, CodecProfile& profile)
+    : m_in(in)
+    , m_profile(profile)
+    , m_stack(profile.encode)
+    , m_length(0)
+{
+    m_stack.push(m_in.type(), now_ns());
+}
+
+void ProfilingSource::finish()
+{
+    if (!m_stack.empty())
+        m_stack.pop(now_ns());
+}
+
+ValueSource::Type ProfilingSource::type()
+{
+    const uint64_t start = now_ns();
+    const Type t = m_in.type();
+    m_profile.phases[CodecProfile::READ].add(now_ns() - start);
+    return t;
+}
+
+double ProfilingSource::number()
+{
+    const uint64_t start = now_ns();
+    const double d = m_in.number();
+    m_profile.phases[CodecProfile::READ].add(now_ns() - start, sizeof(d));
+    m_stack.add_bytes(sizeof(d));
+    return d;
+}
+
+size_t ProfilingSource::string_length()
+{
+    const uint64_t start = now_ns();
+    m_length = m_in.string_length();
+    m_profile.phases[CodecProfile::TRANSCODE_IN].add(now_ns() - start);
+    return m_length;
+}
+
+void ProfilingSource::string_write(char* out)
+{
+    const uint64_t start = now_ns();
+    m_in.string_write(out);
+    m_profile.phases[CodecProfile::TRANSCODE_IN].add(now_ns() - start, m_length);
+    m_stack.add_bytes(m_length);
+}
+
+uint32_t ProfilingSource::size()
+{
+    const uint64_t start = now_ns();
+    const uint32_t n = m_in.size();
+    m_profile.phases[CodecProfile::ENUMERATE].add(now_ns() - start);
+    return n;
+}
+
+std::string ProfilingSource::key(uint32_t i)
+{
+    const uint64_t start = now_ns();
+    std::string k = m_in.key(i);
+    m_profile.phases[CodecProfile::ENUMERATE].add(now_ns() - start, k.size());
+    return k;
+}
+
+void ProfilingSource::enter(uint32_t i)
+{
+    const uint64_t start = now_ns();
+    m_in.enter(i);
+    const Type t = m_in.type();
+    m_profile.phases[CodecProfile::READ].add(now_ns() - start);
+
+    // the member load is charged to the member
+    m_stack.push(t, start);
+}
+
+void ProfilingSource::enter(const RecordLayout& layout, uint32_t field)
+{
+    const uint64_t start = now_ns();
+    m_in.enter(layout, field);
+    const Type t = m_in.type();
+    m_profile.phases[CodecProfile::READ].add(now_ns() - start);
+
+    m_stack.push(t, start);
+}
+
+void ProfilingSource::leave()
+{
+    m_stack.pop(now_ns());
+    m_in.leave();
+}
+
+bool ProfilingSource::matches(const RecordLayout& layout)
+{
+    const uint64_t start = now_ns();
+    const bool m = m_in.matches(layout);
+    m_profile.phases[CodecProfile::ENUMERATE].add(now_ns() - start);
+    return m;
+}
+
+ProfilingSink::ProfilingSink(ValueSink& out, CodecProfile& profile)
+    : m_out(out)
+    , m_profile(profile)
+    , m_stack(profile.decode)
+{}
+
+void ProfilingSink::begin(ValueSource::Type type)
+{
+    m_stack.push(type, now_ns());
+}
+
+void ProfilingSink::end()
+{
+    m_stack.pop(now_ns());
+}
+
+void ProfilingSink::undefined()
+{
+    const uint64_t start = now_ns();
+    m_out.undefined();
+    const uint64_t ns = now_ns() - start;
+    m_profile.phases[CodecProfile::BUILD].add(ns);
+    m_stack.leaf(ValueSource::UNDEFINED, ns, 0);
+}
+
+void ProfilingSink::number(double val)
+{
+    const uint64_t start = now_ns();
+    m_out.number(val);
+    const uint64_t ns = now_ns() - start;
+    m_profile.phases[CodecProfile::BUILD].add(ns, sizeof(val));
+    m_stack.leaf(ValueSource::NUMBER, ns, sizeof(val));
+}
+
+void ProfilingSink::int32(int32_t val)
+{
+    const uint64_t start = now_ns();
+    m_out.int32(val);
+    const uint64_t ns = now_ns() - start;
+    m_profile.phases[CodecProfile::BUILD].add(ns, sizeof(val));
+    m_stack.leaf(ValueSource::INT32, ns, sizeof(val));
+}
+
+void ProfilingSink::string(const char* data, size_t length)
+{
+    const uint64_t start = now_ns();
+    m_out.string(data, length);
+    const uint64_t ns = now_ns() - start;
+    m_profile.phases[CodecProfile::TRANSCODE_OUT].add(ns, length);
+    m_stack.leaf(ValueSource::STRING, ns, length);
+}
+
+void ProfilingSink::begin_array(uint32_t size)
+{
+    begin(ValueSource::ARRAY);
+
+    const uint64_t start = now_ns();
+    m_out.begin_array(size);
+    m_profile.phases[CodecProfile::BUILD].add(now_ns() - start);
+}
+
+void ProfilingSink::end_array()
+{
+    const uint64_t start = now_ns();
+    m_out.end_array();
+    m_profile.phases[CodecProfile::BUILD].add(now_ns() - start);
+
+    end();
+}
+
+void ProfilingSink::begin_object(uint32_t size)
+{
+    begin(ValueSource::OBJECT);
+
+    const uint64_t start = now_ns();
+    m_out.begin_object(size);
+    m_profile.phases[CodecProfile::BUILD].add(now_ns() - start);
+}
+
+void ProfilingSink::key(const char* name, size_t length)
+{
+    const uint64_t start = now_ns();
+    m_out.key(name, length);
+    m_profile.phases[CodecProfile::TRANSCODE_OUT].add(now_ns() - start, length);
+    m_stack.add_bytes(length);
+}
+
+void ProfilingSink::end_object()
+{
+    const uint64_t start = now_ns();
+    m_out.end_object();
+    m_profile.phases[CodecProfile::BUILD].add(now_ns() - start);
+
+    end();
+}
+
+void ProfilingSink::key(const RecordLayout& layout, uint32_t field)
+{
+    const uint64_t start = now_ns();
+    m_out.key(layout, field);
+    m_profile.phases[CodecProfile::TRANSCODE_OUT].add(now_ns() - start);
+}
+
+} // namespace bypass
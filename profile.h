@@ -0,0 +1,177 @@
+#ifndef BYPASS_PROFILE_H
+#define BYPASS_PROFILE_H
+
+#include <vector>
+
+#include <stdint.h>
+
+#include "value.h"
+
+namespace bypass {
+
+struct Cost
+{
+    uint64_t calls;
+    uint64_t ns;
+    uint64_t bytes;
+
+    Cost()
+        : calls(0)
+        , ns(0)
+        , bytes(0)
+    {}
+
+    void add(uint64_t n, uint64_t b = 0)
+    {
+        ++calls;
+        ns += n;
+        bytes += b;
+    }
+};
+
+/// where encoding and decoding time goes
+/// time by value type is exclusive of nested values, so a document's
+/// cost is spread over the members that caused it. encode calls count
+/// every visit and shape checks visit object members more than once.
+/// phases split the same time by what the codec was doing
+struct CodecProfile
+{
+    enum Phase
+    {
+        // whole encode including the phases below
+        ENCODE,
+
+        // reading property names and checking shapes
+        ENUMERATE,
+
+        // reading strings out of the source
+        TRANSCODE_IN,
+
+        // type checks, numbers and property loads
+        READ,
+
+        // inserting into the index and measuring the value
+        INDEX,
+
+        // whole decode including the phases below
+        DECODE,
+
+        // creating strings in the sink
+        TRANSCODE_OUT,
+
+        // creating numbers, arrays and objects and setting members
+        BUILD,
+
+        PHASE_COUNT
+    };
+
+    static const char* phase_name(Phase phase);
+
+    // indexed by ValueSource::Type
+    static const int kTypes = ValueSource::OBJECT + 1;
+
+    Cost encode[kTypes];
+    Cost decode[kTypes];
+    Cost phases[PHASE_COUNT];
+
+    void reset()
+    {
+        *this = CodecProfile();
+    }
+};
+
+/// tracks exclusive time per value as a tree is walked
+class CostStack
+{
+    struct Frame
+    {
+        ValueSource::Type type;
+        uint64_t start;
+        uint64_t child_ns;
+        uint64_t bytes;
+    };
+
+    std::vector<Frame> m_frames;
+    Cost* m_costs;
+
+public:
+    CostStack(Cost* costs)
+        : m_costs(costs)
+    {}
+
+    void push(ValueSource::Type type, uint64_t now);
+
+    /// charge the top value with its time less that of its children
+    void pop(uint64_t now);
+
+    /// charge a value with no children that took ns
+    void leaf(ValueSource::Type type, uint64_t ns, uint64_t bytes);
+
+    void add_bytes(uint64_t bytes)
+    {
+        if (!m_frames.empty())
+            m_frames.back().bytes += bytes;
+    }
+
+    bool empty() const { return m_frames.empty(); }
+};
+
+/// forwards to another source, charging the time of every call
+class ProfilingSource : public ValueSource
+{
+    ValueSource& m_in;
+    CodecProfile& m_profile;
+    CostStack m_stack;
+
+    // from the last string_length(), string_write() follows it
+    size_t m_length;
+
+public:
+    ProfilingSource(ValueSource& in, CodecProfile& profile);
+
+    /// charge the top level value, call once encoding is done
+    void finish();
+
+    virtual Type type();
+    virtual double number();
+    virtual size_t string_length();
+    virtual void string_write(char* out);
+    virtual uint32_t size();
+    virtual std::string key(uint32_t i);
+    virtual void enter(uint32_t i);
+    virtual void enter(const RecordLayout& layout, uint32_t field);
+    virtual void leave();
+    virtual bool matches(const RecordLayout& layout);
+};
+
+/// forwards to another sink, charging the time of every call
+class ProfilingSink : public ValueSink
+{
+    ValueSink& m_out;
+    CodecProfile& m_profile;
+    CostStack m_stack;
+
+    void begin(ValueSource::Type type);
+    void end();
+
+public:
+    ProfilingSink(ValueSink& out, CodecProfile& profile);
+
+    virtual void undefined();
+    virtual void number(double val);
+    virtual void int32(int32_t val);
+    virtual void string(const char* data, size_t length);
+
+    virtual void begin_array(uint32_t size);
+    virtual void end_array();
+
+    virtual void begin_object(uint32_t size);
+    virtual void key(const char* name, size_t length);
+    virtual void end_object();
+
+    virtual void key(const RecordLayout& layout, uint32_t field);
+};
+
+} // namespace bypass
+
+#endif
@@ -0,0 +1,918 @@
+#include <new>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include <stddef.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "radixtree.h"
+
+namespace bypass {
+
+namespace {
+
+enum NodeType
+{
+    NODE4,
+    NODE16,
+    NODE48,
+    NODE256
+};
+
+// prefix bytes kept in a node, the rest are read from a leaf below
+const uint32_t kPrefix = 8;
+
+} // namespace
+
+struct RadixTree::Leaf
+{
+    // first id, any others are in more
+    int64_t id;
+    std::vector<int64_t>* more;
+
+    uint32_t length;
+    char data[1];
+};
+
+struct RadixTree::Node
+{
+    uint8_t type;
+    uint16_t count;
+    uint32_t prefix_len;
+    uint8_t prefix[kPrefix];
+
+    // string ending at this node after its prefix
+    Leaf* terminal;
+
+    /// allocated size for the type
+    size_t bytes() const;
+
+    /// everything but the children, when swapping for another size
+    void copy_header(const Node* from)
+    {
+        count = from->count;
+        prefix_len = from->prefix_len;
+        std::memcpy(prefix, from->prefix, kPrefix);
+        terminal = from->terminal;
+    }
+};
+
+/// children in byte order
+struct RadixTree::Node4 : RadixTree::Node
+{
+    uint8_t keys[4];
+    void* children[4];
+};
+
+/// children in byte order
+struct RadixTree::Node16 : RadixTree::Node
+{
+    uint8_t keys[16];
+    void* children[16];
+};
+
+/// children unordered, index holds the position plus one by byte
+struct RadixTree::Node48 : RadixTree::Node
+{
+    uint8_t index[256];
+    void* children[48];
+};
+
+struct RadixTree::Node256 : RadixTree::Node
+{
+    void* children[256];
+};
+
+namespace {
+
+inline bool is_leaf(const void* ref)
+{
+    return uintptr_t(ref) & 1;
+}
+
+template<class T>
+inline T* untag(const void* ref)
+{
+    return reinterpret_cast<T*>(uintptr_t(ref) & ~uintptr_t(1));
+}
+
+inline void* tag(const void* leaf)
+{
+    return reinterpret_cast<void*>(uintptr_t(leaf) | 1);
+}
+
+template<class T>
+T* make_node(uint8_t type)
+{
+    T* node = new T();
+    node->type = type;
+    return node;
+}
+
+} // namespace
+
+size_t RadixTree::Node::bytes() const
+{
+    switch (type)
+    {
+    case NODE4:
+        return sizeof(Node4);
+    case NODE16:
+        return sizeof(Node16);
+    case NODE48:
+        return sizeof(Node48);
+    default:
+        return sizeof(Node256);
+    }
+}
+
+RadixTree::RadixTree()
+    : m_root(0)
+    , m_strings(0)
+    , m_bytes(0)
+{}
+
+RadixTree::~RadixTree()
+{
+    free_tree(m_root);
+}
+
+RadixTree::Leaf* RadixTree::make_leaf(const char* data, size_t length, int64_t id)
+{
+    const size_t size = std::max(sizeof(Leaf), offsetof(Leaf, data) + length);
+    Leaf* leaf = static_cast<Leaf*>(::operator new(size));
+    leaf->id = id;
+    leaf->more = 0;
+    leaf->length = uint32_t(length);
+    std::memcpy(leaf->data, data, length);
+
+    m_bytes += size;
+    ++m_strings;
+    return leaf;
+}
+
+void RadixTree::free_leaf(Leaf* leaf)
+{
+    m_bytes -= std::max(sizeof(Leaf), offsetof(Leaf, data) + leaf->length);
+    if (leaf->more)
+    {
+        m_bytes -= sizeof(*leaf->more) + leaf->more->size() * sizeof(int64_t);
+        delete leaf->more;
+    }
+    --m_strings;
+    ::operator delete(leaf);
+}
+
+void RadixTree::free_node(Node* node)
+{
+    m_bytes -= node->bytes();
+    switch (node->type)
+    {
+    case NODE4:
+        delete static_cast<Node4*>(node);
+        break;
+    case NODE16:
+        delete static_cast<Node16*>(node);
+        break;
+    case NODE48:
+        delete static_cast<Node48*>(node);
+        break;
+    default:
+        delete static_cast<Node256*>(node);
+        break;
+    }
+}
+
+void RadixTree::free_tree(void* ref)
+{
+    if (!ref)
+        return;
+    if (is_leaf(ref))
+    {
+        free_leaf(untag<Leaf>(ref));
+        return;
+    }
+
+    Node* node = static_cast<Node*>(ref);
+    if (node->terminal)
+        free_leaf(node->terminal);
+
+    switch (node->type)
+    {
+    case NODE4:
+        for (uint32_t i=0 ; i<node->count ; ++i)
+            free_tree(static_cast<Node4*>(node)->children[i]);
+        break;
+    case NODE16:
+        for (uint32_t i=0 ; i<node->count ; ++i)
+            free_tree(static_cast<Node16*>(node)->children[i]);
+        break;
+    case NODE48:
+        for (uint32_t i=0 ; i<48 ; ++i)
+            free_tree(static_cast<Node48*>(node)->children[i]);
+        break;
+    default:
+        for (uint32_t i=0 ; i<256 ; ++i)
+            free_tree(static_cast<Node256*>(node)->children[i]);
+        break;
+    }
+    free_node(node);
+}
+
+void RadixTree::clear()
+{
+    free_tree(m_root);
+    m_root = 0;
+}
+
+void RadixTree::add_id(Leaf* leaf, int64_t id)
+{
+    if (leaf->id == id)
+        return;
+    if (!leaf->more)
+    {
+        leaf->more = new std::vector<int64_t>();
+        m_bytes += sizeof(*leaf->more);
+    }
+    else if (std::find(leaf->more->begin(), leaf->more->end(), id) != leaf->more->end())
+    {
+        return;
+    }
+    leaf->more->push_back(id);
+    m_bytes += sizeof(int64_t);
+}
+
+RadixTree::Drop RadixTree::drop_id(Leaf* leaf, int64_t id)
+{
+    std::vector<int64_t>* more = leaf->more;
+    if (leaf->id != id)
+    {
+        if (!more)
+            return ABSENT;
+        std::vector<int64_t>::iterator iter = std::find(more->begin(), more->end(), id);
+        if (iter == more->end())
+            return ABSENT;
+        *iter = more->back();
+    }
+    else if (more)
+    {
+        leaf->id = more->back();
+    }
+    else
+    {
+        return EMPTY;
+    }
+
+    more->pop_back();
+    m_bytes -= sizeof(int64_t);
+    if (more->empty())
+    {
+        m_bytes -= sizeof(*more);
+        delete more;
+        leaf->more = 0;
+    }
+    return DROPPED;
+}
+
+void** RadixTree::find_child(Node* node, uint8_t b)
+{
+    switch (node->type)
+    {
+    case NODE4:
+    {
+        Node4* n = static_cast<Node4*>(node);
+        for (uint32_t i=0 ; i<n->count ; ++i)
+        {
+            if (n->keys[i] == b)
+                return &n->children[i];
+        }
+        return 0;
+    }
+    case NODE16:
+    {
+        Node16* n = static_cast<Node16*>(node);
+#ifdef __SSE2__
+        // compare all sixteen keys at once
+        const __m128i eq = _mm_cmpeq_epi8(_mm_set1_epi8(char(b)),
+                                          _mm_loadu_si128(reinterpret_cast<const __m128i*>(n->keys)));
+        const unsigned mask = unsigned(_mm_movemask_epi8(eq)) & ((1u << n->count) - 1);
+        return mask ? &n->children[__builtin_ctz(mask)] : 0;
+#else
+        const uint8_t* pos = std::lower_bound(n->keys, n->keys + n->count, b);
+        return pos != n->keys + n->count && *pos == b ? &n->children[pos - n->keys] : 0;
+#endif
+    }
+    case NODE48:
+    {
+        Node48* n = static_cast<Node48*>(node);
+        return n->index[b] ? &n->children[n->index[b] - 1] : 0;
+    }
+    default:
+    {
+        Node256* n = static_cast<Node256*>(node);
+        return n->children[b] ? &n->children[b] : 0;
+    }
+    }
+}
+
+void RadixTree::add_child(void*& ref, uint8_t b, void* child)
+{
+    Node* node = static_cast<Node*>(ref);
+    switch (node->type)
+    {
+    case NODE4:
+    {
+        Node4* n = static_cast<Node4*>(node);
+        if (n->count < 4)
+        {
+            uint32_t pos = 0;
+            while (pos < n->count && n->keys[pos] < b)
+                ++pos;
+            std::memmove(n->keys + pos + 1, n->keys + pos, n->count - pos);
+            std::memmove(n->children + pos + 1, n->children + pos, (n->count - pos) * sizeof(void*));
+            n->keys[pos] = b;
+            n->children[pos] = child;
+            ++n->count;
+            return;
+        }
+
+        Node16* grown = make_node<Node16>(NODE16);
+        m_bytes += sizeof(Node16);
+        grown->copy_header(n);
+        std::memcpy(grown->keys, n->keys, 4);
+        std::memcpy(grown->children, n->children, 4 * sizeof(void*));
+        free_node(n);
+        ref = grown;
+        add_child(ref, b, child);
+        return;
+    }
+    case NODE16:
+    {
+        Node16* n = static_cast<Node16*>(node);
+        if (n->count < 16)
+        {
+            const uint32_t pos = std::lower_bound(n->keys, n->keys + n->count, b) - n->keys;
+            std::memmove(n->keys + pos + 1, n->keys + pos, n->count - pos);
+            std::memmove(n->children + pos + 1, n->children + pos, (n->count - pos) * sizeof(void*));
+            n->keys[pos] = b;
+            n->children[pos] = child;
+            ++n->count;
+            return;
+        }
+
+        Node48* grown = make_node<Node48>(NODE48);
+        m_bytes += sizeof(Node48);
+        grown->copy_header(n);
+        for (uint32_t i=0 ; i<16 ; ++i)
+        {
+            grown->children[i] = n->children[i];
+            grown->index[n->keys[i]] = uint8_t(i + 1);
+        }
+        free_node(n);
+        ref = grown;
+        add_child(ref, b, child);
+        return;
+    }
+    case NODE48:
+    {
+        Node48* n = static_cast<Node48*>(node);
+        if (n->count < 48)
+        {
+            // removals leave holes anywhere
+            uint32_t pos = 0;
+            while (n->children[pos])
+                ++pos;
+            n->children[pos] = child;
+            n->index[b] = uint8_t(pos + 1);
+            ++n->count;
+            return;
+        }
+
+        Node256* grown = make_node<Node256>(NODE256);
+        m_bytes += sizeof(Node256);
+        grown->copy_header(n);
+        for (uint32_t i=0 ; i<256 ; ++i)
+        {
+            if (n->index[i])
+                grown->children[i] = n->children[n->index[i] - 1];
+        }
+        free_node(n);
+        ref = grown;
+        add_child(ref, b, child);
+        return;
+    }
+    default:
+    {
+        Node256* n = static_cast<Node256*>(node);
+        n->children[b] = child;
+        ++n->count;
+        return;
+    }
+    }
+}
+
+void RadixTree::remove_child(void*& ref, uint8_t b)
+{
+    Node* node = static_cast<Node*>(ref);
+    switch (node->type)
+    {
+    case NODE4:
+    {
+        Node4* n = static_cast<Node4*>(node);
+        const uint32_t pos = std::find(n->keys, n->keys + n->count, b) - n->keys;
+        std::memmove(n->keys + pos, n->keys + pos + 1, n->count - pos - 1);
+        std::memmove(n->children + pos, n->children + pos + 1, (n->count - pos - 1) * sizeof(void*));
+        --n->count;
+        return;
+    }
+    case NODE16:
+    {
+        Node16* n = static_cast<Node16*>(node);
+        const uint32_t pos = std::lower_bound(n->keys, n->keys + n->count, b) - n->keys;
+        std::memmove(n->keys + pos, n->keys + pos + 1, n->count - pos - 1);
+        std::memmove(n->children + pos, n->children + pos + 1, (n->count - pos - 1) * sizeof(void*));
+        if (--n->count > 3)
+            return;
+
+        Node4* shrunk = make_node<Node4>(NODE4);
+        m_bytes += sizeof(Node4);
+        shrunk->copy_header(n);
+        std::memcpy(shrunk->keys, n->keys, n->count);
+        std::memcpy(shrunk->children, n->children, n->count * sizeof(void*));
+        free_node(n);
+        ref = shrunk;
+        return;
+    }
+    case NODE48:
+    {
+        Node48* n = static_cast<Node48*>(node);
+        n->children[n->index[b] - 1] = 0;
+        n->index[b] = 0;
+        if (--n->count > 12)
+            return;
+
+        Node16* shrunk = make_node<Node16>(NODE16);
+        m_bytes += sizeof(Node16);
+        shrunk->copy_header(n);
+        for (uint32_t i=0, pos=0 ; i<256 ; ++i)
+        {
+            if (!n->index[i])
+                continue;
+            shrunk->keys[pos] = uint8_t(i);
+            shrunk->children[pos++] = n->children[n->index[i] - 1];
+        }
+        free_node(n);
+        ref = shrunk;
+        return;
+    }
+    default:
+    {
+        Node256* n = static_cast<Node256*>(node);
+        n->children[b] = 0;
+        if (--n->count > 40)
+            return;
+
+        Node48* shrunk = make_node<Node48>(NODE48);
+        m_bytes += sizeof(Node48);
+        shrunk->copy_header(n);
+        for (uint32_t i=0, pos=0 ; i<256 ; ++i)
+        {
+            if (!n->children[i])
+                continue;
+            shrunk->children[pos] = n->children[i];
+            shrunk->index[i] = uint8_t(++pos);
+        }
+        free_node(n);
+        ref = shrunk;
+        return;
+    }
+    }
+}
+
+void RadixTree::collapse(void*& ref)
+{
+    Node* node = static_cast<Node*>(ref);
+    if (node->count == 0)
+    {
+        // a leaf holds its whole string so it can stand where the node was
+        ref = node->terminal ? tag(node->terminal) : 0;
+        free_node(node);
+        return;
+    }
+
+    if (node->count > 1 || node->terminal || node->type != NODE4)
+        return;
+
+    Node4* n = static_cast<Node4*>(node);
+    void* child = n->children[0];
+    if (!is_leaf(child))
+    {
+        // the child takes over this prefix and the byte leading to it
+        Node* c = static_cast<Node*>(child);
+        uint8_t prefix[kPrefix];
+        uint32_t len = std::min(n->prefix_len, kPrefix);
+        std::memcpy(prefix, n->prefix, len);
+        if (len < kPrefix)
+            prefix[len++] = n->keys[0];
+        const uint32_t rest = std::min(kPrefix - len, c->prefix_len);
+        std::memcpy(prefix + len, c->prefix, rest);
+        std::memcpy(c->prefix, prefix, len + rest);
+        c->prefix_len += n->prefix_len + 1;
+    }
+    ref = child;
+    free_node(n);
+}
+
+const RadixTree::Leaf* RadixTree::minimum(const Node* node)
+{
+    for (;;)
+    {
+        if (node->terminal)
+            return node->terminal;
+
+        const void* child = 0;
+        switch (node->type)
+        {
+        case NODE4:
+            child = static_cast<const Node4*>(node)->children[0];
+            break;
+        case NODE16:
+            child = static_cast<const Node16*>(node)->children[0];
+            break;
+        case NODE48:
+        {
+            const Node48* n = static_cast<const Node48*>(node);
+            uint32_t i = 0;
+            while (!n->index[i])
+                ++i;
+            child = n->children[n->index[i] - 1];
+            break;
+        }
+        default:
+        {
+            const Node256* n = static_cast<const Node256*>(node);
+            uint32_t i = 0;
+            while (!n->children[i])
+                ++i;
+            child = n->children[i];
+            break;
+        }
+        }
+
+        if (is_leaf(child))
+            return untag<const Leaf>(child);
+        node = static_cast<const Node*>(child);
+    }
+}
+
+uint32_t RadixTree::prefix_match(const Node* node, const uint8_t* data, size_t length, size_t depth)
+{
+    const uint32_t kept = std::min(node->prefix_len, kPrefix);
+    uint32_t i = 0;
+    for (; i<kept ; ++i)
+    {
+        if (depth + i >= length || node->prefix[i] != data[depth + i])
+            return i;
+    }
+
+    if (node->prefix_len > kPrefix)
+    {
+        const uint8_t* full = reinterpret_cast<const uint8_t*>(minimum(node)->data);
+        for (; i<node->prefix_len ; ++i)
+        {
+            if (depth + i >= length || full[depth + i] != data[depth + i])
+                return i;
+        }
+    }
+    return i;
+}
+
+void RadixTree::insert(const char* data, size_t length, int64_t id)
+{
+    insert(m_root, reinterpret_cast<const uint8_t*>(data), length, 0, id);
+}
+
+void RadixTree::insert(void*& ref, const uint8_t* data, size_t length, size_t depth, int64_t id)
+{
+    const char* chars = reinterpret_cast<const char*>(data);
+
+    if (!ref)
+    {
+        ref = tag(make_leaf(chars, length, id));
+        return;
+    }
+
+    if (is_leaf(ref))
+    {
+        Leaf* leaf = untag<Leaf>(ref);
+        if (leaf->length == length && !std::memcmp(leaf->data, data, length))
+        {
+            add_id(leaf, id);
+            return;
+        }
+
+        // split on the first byte the two strings differ at
+        const uint8_t* other = reinterpret_cast<const uint8_t*>(leaf->data);
+        size_t common = 0;
+        while (depth + common < length && depth + common < leaf->length
+               && data[depth + common] == other[depth + common])
+            ++common;
+
+        Node4* node = make_node<Node4>(NODE4);
+        m_bytes += sizeof(Node4);
+        node->prefix_len = uint32_t(common);
+        std::memcpy(node->prefix, data + depth, std::min<size_t>(common, kPrefix));
+
+        void* split = node;
+        const size_t end = depth + common;
+        Leaf* added = make_leaf(chars, length, id);
+        if (leaf->length == end)
+            node->terminal = leaf;
+        else
+            add_child(split, other[end], ref);
+        if (length == end)
+            node->terminal = added;
+        else
+            add_child(split, data[end], tag(added));
+        ref = split;
+        return;
+    }
+
+    Node* node = static_cast<Node*>(ref);
+    if (node->prefix_len)
+    {
+        const uint32_t matched = prefix_match(node, data, length, depth);
+        if (matched < node->prefix_len)
+        {
+            // the string leaves the prefix early, split it there
+            Node4* parent = make_node<Node4>(NODE4);
+            m_bytes += sizeof(Node4);
+            parent->prefix_len = matched;
+            std::memcpy(parent->prefix, node->prefix, std::min(matched, kPrefix));
+
+            uint8_t b;
+            if (node->prefix_len <= kPrefix)
+            {
+                b = node->prefix[matched];
+                node->prefix_len -= matched + 1;
+                std::memmove(node->prefix, node->prefix + matched + 1, node->prefix_len);
+            }
+            else
+            {
+                const uint8_t* full = reinterpret_cast<const uint8_t*>(minimum(node)->data) + depth;
+                b = full[matched];
+                node->prefix_len -= matched + 1;
+                std::memcpy(node->prefix, full + matched + 1, std::min(node->prefix_len, kPrefix));
+            }
+
+            void* split = parent;
+            add_child(split, b, node);
+            Leaf* added = make_leaf(chars, length, id);
+            if (depth + matched == length)
+                parent->terminal = added;
+            else
+                add_child(split, data[depth + matched], tag(added));
+            ref = split;
+            return;
+        }
+        depth += node->prefix_len;
+    }
+
+    if (depth == length)
+    {
+        if (node->terminal)
+            add_id(node->terminal, id);
+        else
+            node->terminal = make_leaf(chars, length, id);
+        return;
+    }
+
+    void** child = find_child(node, data[depth]);
+    if (child)
+        insert(*child, data, length, depth + 1, id);
+    else
+        add_child(ref, data[depth], tag(make_leaf(chars, length, id)));
+}
+
+bool RadixTree::remove(const char* data, size_t length, int64_t id)
+{
+    return remove(m_root, reinterpret_cast<const uint8_t*>(data), length, 0, id);
+}
+
+bool RadixTree::remove(void*& ref, const uint8_t* data, size_t length, size_t depth, int64_t id)
+{
+    if (!ref)
+        return false;
+
+    if (is_leaf(ref))
+    {
+        Leaf* leaf = untag<Leaf>(ref);
+        if (leaf->length != length || std::memcmp(leaf->data, data, length))
+            return false;
+
+        const Drop drop = drop_id(leaf, id);
+        if (drop == EMPTY)
+        {
+            free_leaf(leaf);
+            ref = 0;
+        }
+        return drop != ABSENT;
+    }
+
+    Node* node = static_cast<Node*>(ref);
+    if (prefix_match(node, data, length, depth) != node->prefix_len)
+        return false;
+    depth += node->prefix_len;
+
+    if (depth == length)
+    {
+        if (!node->terminal)
+            return false;
+
+        const Drop drop = drop_id(node->terminal, id);
+        if (drop == EMPTY)
+        {
+            free_leaf(node->terminal);
+            node->terminal = 0;
+            collapse(ref);
+        }
+        return drop != ABSENT;
+    }
+
+    const uint8_t b = data[depth];
+    void** child = find_child(node, b);
+    if (!child || !remove(*child, data, length, depth + 1, id))
+        return false;
+
+    if (!*child)
+    {
+        remove_child(ref, b);
+        collapse(ref);
+    }
+    return true;
+}
+
+bool RadixTree::find(const char* data, size_t length, Visitor& out) const
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    const void* ref = m_root;
+    size_t depth = 0;
+
+    while (ref)
+    {
+        const Leaf* leaf = 0;
+        if (is_leaf(ref))
+        {
+            leaf = untag<const Leaf>(ref);
+        }
+        else
+        {
+            // only the kept prefix bytes are checked on the way down,
+            // the leaf is compared whole at the end
+            Node* node = static_cast<Node*>(const_cast<void*>(ref));
+            const uint32_t kept = std::min(node->prefix_len, kPrefix);
+            for (uint32_t i=0 ; i<kept ; ++i)
+            {
+                if (depth + i >= length || node->prefix[i] != bytes[depth + i])
+                    return false;
+            }
+
+            depth += node->prefix_len;
+            if (depth > length)
+                return false;
+            if (depth == length)
+            {
+                leaf = node->terminal;
+            }
+            else
+            {
+                void** child = find_child(node, bytes[depth]);
+                ref = child ? *child : 0;
+                ++depth;
+                continue;
+            }
+        }
+
+        if (!leaf || leaf->length != length || std::memcmp(leaf->data, data, length))
+            return false;
+        visit(leaf, out);
+        return true;
+    }
+    return false;
+}
+
+bool RadixTree::visit(const Leaf* leaf, Visitor& out)
+{
+    if (!out.visit(leaf->data, leaf->length, leaf->id))
+        return false;
+    if (leaf->more)
+    {
+        for (size_t i=0 ; i<leaf->more->size() ; ++i)
+        {
+            if (!out.visit(leaf->data, leaf->length, (*leaf->more)[i]))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool RadixTree::walk(const void* ref, const uint8_t* from, size_t length, size_t depth,
+                     bool bounded, Visitor& out)
+{
+    if (is_leaf(ref))
+    {
+        const Leaf* leaf = untag<const Leaf>(ref);
+        if (bounded)
+        {
+            // the bytes before depth are known to equal from
+            const size_t n = std::min<size_t>(leaf->length, length);
+            const int cmp = std::memcmp(leaf->data + depth, from + depth, n > depth ? n - depth : 0);
+            if (cmp < 0 || (cmp == 0 && leaf->length < length))
+                return true;
+        }
+        return visit(leaf, out);
+    }
+
+    const Node* node = static_cast<const Node*>(ref);
+    if (bounded)
+    {
+        const uint8_t* full = node->prefix_len > kPrefix
+            ? reinterpret_cast<const uint8_t*>(minimum(node)->data) : 0;
+        for (uint32_t i=0 ; i<node->prefix_len && bounded ; ++i)
+        {
+            if (depth + i >= length)
+            {
+                bounded = false;
+                break;
+            }
+            const uint8_t c = i < kPrefix ? node->prefix[i] : full[depth + i];
+            if (c < from[depth + i])
+                return true;
+            if (c > from[depth + i])
+                bounded = false;
+        }
+    }
+    depth += node->prefix_len;
+
+    // everything below is past from once all of it has matched
+    if (bounded && depth >= length)
+        bounded = false;
+
+    // the terminal is shorter than from and sorts before it while bounded
+    if (node->terminal && !bounded && !visit(node->terminal, out))
+        return false;
+
+    const uint32_t first = bounded ? from[depth] : 0;
+    switch (node->type)
+    {
+    case NODE4:
+    case NODE16:
+    {
+        const uint8_t* keys = node->type == NODE4
+            ? static_cast<const Node4*>(node)->keys : static_cast<const Node16*>(node)->keys;
+        void* const* children = node->type == NODE4
+            ? static_cast<const Node4*>(node)->children : static_cast<const Node16*>(node)->children;
+        for (uint32_t i=0 ; i<node->count ; ++i)
+        {
+            if (keys[i] >= first
+                && !walk(children[i], from, length, depth + 1, bounded && keys[i] == first, out))
+                return false;
+        }
+        return true;
+    }
+    case NODE48:
+    {
+        const Node48* n = static_cast<const Node48*>(node);
+        for (uint32_t i=first ; i<256 ; ++i)
+        {
+            if (n->index[i]
+                && !walk(n->children[n->index[i] - 1], from, length, depth + 1, bounded && i == first, out))
+                return false;
+        }
+        return true;
+    }
+    default:
+    {
+        const Node256* n = static_cast<const Node256*>(node);
+        for (uint32_t i=first ; i<256 ; ++i)
+        {
+            if (n->children[i]
+                && !walk(n->children[i], from, length, depth + 1, bounded && i == first, out))
+                return false;
+        }
+        return true;
+    }
+    }
+}
+
+void RadixTree::scan(const char* from, size_t length, Visitor& out) const
+{
+    if (m_root)
+        walk(m_root, reinterpret_cast<const uint8_t*>(from), length, 0, length > 0, out);
+}
+
+} // namespace bypass
@@ -0,0 +1,107 @@
+#ifndef BYPASS_RADIXTREE_H
+#define BYPASS_RADIXTREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace bypass {
+
+/// adaptive radix tree mapping byte strings to sets of int64 ids
+/// after Leis, Kemper and Neumann. inner nodes branch on one byte and come
+/// in four sizes (4, 16, 48 and 256 children) that are swapped as children
+/// come and go. runs of bytes without a branch are kept once in the node
+/// below them, and a string that ends where its branch would start is a
+/// leaf hanging directly off the last node it shares. only the first
+/// kPrefix bytes of a run are kept in the node, lookups compare the rest
+/// against the leaf they end at. strings are ordered bytewise as unsigned
+class RadixTree
+{
+public:
+    /// told about every (string, id) pair of a scan in order
+    class Visitor
+    {
+    public:
+        virtual ~Visitor() {}
+
+        /// return false to stop the scan
+        virtual bool visit(const char* data, size_t length, int64_t id) = 0;
+    };
+
+private:
+    struct Leaf;
+    struct Node;
+    struct Node4;
+    struct Node16;
+    struct Node48;
+    struct Node256;
+
+    enum Drop
+    {
+        ABSENT,
+        DROPPED,
+        EMPTY
+    };
+
+    // children are Node* or Leaf* tagged with the low bit
+    void* m_root;
+    size_t m_strings;
+    size_t m_bytes;
+
+    Leaf* make_leaf(const char* data, size_t length, int64_t id);
+    void free_leaf(Leaf* leaf);
+    void free_node(Node* node);
+    void free_tree(void* ref);
+
+    void add_id(Leaf* leaf, int64_t id);
+    Drop drop_id(Leaf* leaf, int64_t id);
+
+    static void** find_child(Node* node, uint8_t b);
+    void add_child(void*& ref, uint8_t b, void* child);
+    void remove_child(void*& ref, uint8_t b);
+
+    /// replace a node left with no children or a single one
+    void collapse(void*& ref);
+
+    static const Leaf* minimum(const Node* node);
+
+    /// how much of the prefix of node matches data from depth
+    static uint32_t prefix_match(const Node* node, const uint8_t* data, size_t length, size_t depth);
+
+    void insert(void*& ref, const uint8_t* data, size_t length, size_t depth, int64_t id);
+    bool remove(void*& ref, const uint8_t* data, size_t length, size_t depth, int64_t id);
+
+    static bool visit(const Leaf* leaf, Visitor& out);
+    static bool walk(const void* ref, const uint8_t* from, size_t length, size_t depth,
+                     bool bounded, Visitor& out);
+
+    RadixTree(const RadixTree&);
+    RadixTree& operator=(const RadixTree&);
+
+public:
+    RadixTree();
+    ~RadixTree();
+
+    /// add id under data, nothing if it is there already
+    void insert(const char* data, size_t length, int64_t id);
+
+    /// false if id was not under data
+    bool remove(const char* data, size_t length, int64_t id);
+
+    /// visit the ids under data, false if there are none
+    bool find(const char* data, size_t length, Visitor& out) const;
+
+    /// visit every string at or after from in order until out says stop
+    void scan(const char* from, size_t length, Visitor& out) const;
+
+    void clear();
+
+    /// distinct strings held
+    size_t size() const { return m_strings; }
+
+    /// memory held by nodes and leaves
+    size_t bytes() const { return m_bytes; }
+};
+
+} // namespace bypass
+
+#endif
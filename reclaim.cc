@@ -0,0 +1,103 @@
+#include "reclaim.h"
+#include "value.h"
+
+using namespace boost;
+
+namespace bypass {
+
+Reclaimer::Reclaimer()
+    : m_started(false)
+    , m_pending(0)
+{
+    pthread_mutex_init(&m_lock, 0);
+    pthread_cond_init(&m_work, 0);
+    pthread_cond_init(&m_idle, 0);
+}
+
+Reclaimer& Reclaimer::instance()
+{
+    // never destroyed so the worker cannot outlive it at exit
+    static Reclaimer* r = new Reclaimer();
+    return *r;
+}
+
+void* Reclaimer::run(void* self)
+{
+    static_cast<Reclaimer*>(self)->loop();
+    return 0;
+}
+
+bool Reclaimer::start()
+{
+    if (!m_started)
+    {
+        m_started = pthread_create(&m_thread, 0, run, this) == 0;
+        if (m_started)
+            pthread_detach(m_thread);
+    }
+
+    return m_started;
+}
+
+void Reclaimer::release(shared_ptr<JsValue>& val)
+{
+    pthread_mutex_lock(&m_lock);
+    if (!start())
+    {
+        // without a thread values are freed where they are released
+        pthread_mutex_unlock(&m_lock);
+        val.reset();
+        return;
+    }
+
+    m_values.push_back(shared_ptr<JsValue>());
+    m_values.back().swap(val);
+    queued();
+    pthread_mutex_unlock(&m_lock);
+}
+
+void Reclaimer::loop()
+{
+    std::vector<shared_ptr<JsValue> > values;
+    std::vector<Garbage*> garbage;
+
+    pthread_mutex_lock(&m_lock);
+    for (;;)
+    {
+        while (m_values.empty() && m_garbage.empty())
+            pthread_cond_wait(&m_work, &m_lock);
+
+        values.swap(m_values);
+        garbage.swap(m_garbage);
+        const size_t count = values.size() + garbage.size();
+        pthread_mutex_unlock(&m_lock);
+
+        values.clear();
+        for (size_t i=0 ; i<garbage.size() ; ++i)
+            delete garbage[i];
+        garbage.clear();
+
+        pthread_mutex_lock(&m_lock);
+        m_pending -= count;
+        if (m_pending == 0)
+            pthread_cond_broadcast(&m_idle);
+    }
+}
+
+size_t Reclaimer::pending()
+{
+    pthread_mutex_lock(&m_lock);
+    const size_t n = m_pending;
+    pthread_mutex_unlock(&m_lock);
+    return n;
+}
+
+void Reclaimer::drain()
+{
+    pthread_mutex_lock(&m_lock);
+    while (m_pending)
+        pthread_cond_wait(&m_idle, &m_lock);
+    pthread_mutex_unlock(&m_lock);
+}
+
+} // namespace bypass
@@ -0,0 +1,107 @@
+#ifndef BYPASS_RECLAIM_H
+#define BYPASS_RECLAIM_H
+
+#include <vector>
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include <boost/shared_ptr.hpp>
+
+namespace bypass {
+
+class JsValue;
+
+/// frees detached values on a background thread
+/// destroying a large value tree or a whole index runs a destructor per
+/// node, so the main thread hands them over here instead. a single worker
+/// started on first use takes everything queued in one batch at a time
+class Reclaimer
+{
+public:
+    /// anything that can be queued, destroyed by the worker
+    class Garbage
+    {
+    public:
+        virtual ~Garbage() {}
+    };
+
+    /// takes over the contents of a container by swapping
+    template <class T>
+    class Holder : public Garbage
+    {
+        T m_val;
+
+    public:
+        Holder(T& val)
+        {
+            m_val.swap(val);
+        }
+    };
+
+    /// values with at least this many nodes are worth handing over
+    static const size_t kMinNodes = 64;
+
+private:
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_work;
+    pthread_cond_t m_idle;
+    pthread_t m_thread;
+    bool m_started;
+
+    std::vector<boost::shared_ptr<JsValue> > m_values;
+    std::vector<Garbage*> m_garbage;
+
+    // queued plus being freed by the worker
+    size_t m_pending;
+
+    Reclaimer();
+
+    static void* run(void* self);
+    void loop();
+
+    /// start the worker if needed, with the lock held
+    /// false if no thread could be started
+    bool start();
+
+    /// count one more item queued and wake the worker, with the lock held
+    void queued()
+    {
+        ++m_pending;
+        pthread_cond_signal(&m_work);
+    }
+
+public:
+    /// lives until the process exits, the worker is never joined
+    static Reclaimer& instance();
+
+    /// take the value out of val, which is left empty
+    void release(boost::shared_ptr<JsValue>& val);
+
+    /// take a container, which is left empty
+    template <class T>
+    void release(T& container)
+    {
+        pthread_mutex_lock(&m_lock);
+        if (!start())
+        {
+            pthread_mutex_unlock(&m_lock);
+            T().swap(container);
+            return;
+        }
+
+        m_garbage.push_back(new Holder<T>(container));
+        queued();
+        pthread_mutex_unlock(&m_lock);
+    }
+
+    /// values and containers not yet freed
+    size_t pending();
+
+    /// block until everything queued so far has been freed
+    void drain();
+};
+
+} // namespace bypass
+
+#endif
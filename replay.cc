@@ -0,0 +1,276 @@
+// replay a trace recorded with store.trace(path)
+//
+//   build/default/bypass_replay trace [--lru bytes] [--every ops]
+//
+// drives a Store with values of the recorded sizes, or with --lru a byte
+// bounded lru simulation, and reports throughput, hit ratio and memory
+// every so many operations and for the whole trace
+
+#include <list>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <boost/unordered_map.hpp>
+
+#include "store.h"
+#include "trace.h"
+#include "clock.h"
+
+using namespace boost;
+using namespace bypass;
+
+namespace {
+
+/// a string of the given length, enough to give values their recorded size
+class FillSource : public ValueSource
+{
+    size_t m_length;
+
+public:
+    FillSource(size_t length)
+        : m_length(length)
+    {}
+
+    virtual Type type() { return STRING; }
+    virtual double number() { return 0; }
+    virtual size_t string_length() { return m_length; }
+    virtual void string_write(char* out) { memset(out, 'x', m_length); }
+    virtual uint32_t size() { return 0; }
+    virtual std::string key(uint32_t) { return std::string(); }
+    virtual void enter(uint32_t) {}
+    virtual void enter(const RecordLayout&, uint32_t) {}
+    virtual void leave() {}
+};
+
+/// what a replay target has to answer
+class Target
+{
+public:
+    virtual ~Target() {}
+
+    virtual void set(int64_t key, uint32_t bytes) = 0;
+
+    /// true on a hit
+    virtual bool get(int64_t key) = 0;
+
+    virtual void del(int64_t key) = 0;
+
+    virtual size_t keys() const = 0;
+    virtual size_t bytes() const = 0;
+};
+
+class StoreTarget : public Target
+{
+    Store m_store;
+
+public:
+    virtual void set(int64_t key, uint32_t bytes)
+    {
+        // the footprint of a string counts the object as well
+        const size_t overhead = sizeof(JsString);
+        FillSource in(bytes > overhead ? bytes - overhead : 0);
+        m_store.set(key, m_store.encode(in));
+    }
+
+    virtual bool get(int64_t key)
+    {
+        return m_store.find(key) != 0;
+    }
+
+    virtual void del(int64_t key)
+    {
+        Footprint removed;
+        m_store.del(key, removed);
+    }
+
+    virtual size_t keys() const { return m_store.size(); }
+    virtual size_t bytes() const { return m_store.bytes(); }
+};
+
+/// lru cache bounded by the recorded value sizes
+class LruTarget : public Target
+{
+    typedef std::list<std::pair<int64_t, uint32_t> > Order;
+    typedef unordered_map<int64_t, Order::iterator> Index;
+
+    Order m_order;
+    Index m_index;
+    size_t m_capacity;
+    size_t m_bytes;
+
+    void remove(Index::iterator iter)
+    {
+        m_bytes -= iter->second->second;
+        m_order.erase(iter->second);
+        m_index.erase(iter);
+    }
+
+public:
+    LruTarget(size_t capacity)
+        : m_capacity(capacity)
+        , m_bytes(0)
+    {}
+
+    virtual void set(int64_t key, uint32_t bytes)
+    {
+        Index::iterator iter = m_index.find(key);
+        if (iter != m_index.end())
+            remove(iter);
+
+        m_order.push_front(std::make_pair(key, bytes));
+        m_index[key] = m_order.begin();
+        m_bytes += bytes;
+
+        while (m_bytes > m_capacity && !m_order.empty())
+            remove(m_index.find(m_order.back().first));
+    }
+
+    virtual bool get(int64_t key)
+    {
+        Index::iterator iter = m_index.find(key);
+        if (iter == m_index.end())
+            return false;
+
+        m_order.splice(m_order.begin(), m_order, iter->second);
+        return true;
+    }
+
+    virtual void del(int64_t key)
+    {
+        Index::iterator iter = m_index.find(key);
+        if (iter != m_index.end())
+            remove(iter);
+    }
+
+    virtual size_t keys() const { return m_index.size(); }
+    virtual size_t bytes() const { return m_bytes; }
+};
+
+struct Counts
+{
+    uint64_t ops;
+    uint64_t gets;
+    uint64_t hits;
+
+    // hits when the trace was recorded
+    uint64_t recorded_hits;
+
+    Counts()
+        : ops(0)
+        , gets(0)
+        , hits(0)
+        , recorded_hits(0)
+    {}
+};
+
+double ratio(uint64_t a, uint64_t b)
+{
+    return b ? double(a) / b : 0;
+}
+
+void usage()
+{
+    fprintf(stderr, "usage: bypass_replay trace [--lru bytes] [--every ops]\n");
+    exit(2);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+        usage();
+
+    size_t lru = 0;
+    uint64_t every = 100000;
+    for (int i=2 ; i<argc ; ++i)
+    {
+        if (!strcmp(argv[i], "--lru") && i + 1 < argc)
+            lru = strtoull(argv[++i], 0, 10);
+        else if (!strcmp(argv[i], "--every") && i + 1 < argc)
+            every = strtoull(argv[++i], 0, 10);
+        else
+            usage();
+    }
+
+    TraceReader trace;
+    if (!trace.open(argv[1]))
+    {
+        fprintf(stderr, "cannot read trace %s\n", argv[1]);
+        return 1;
+    }
+
+    StoreTarget store;
+    LruTarget sim(lru);
+    Target& target = lru ? static_cast<Target&>(sim) : static_cast<Target&>(store);
+
+    printf("%12s %12s %10s %10s %12s %14s\n", "ops", "ops/sec", "hit", "recorded", "keys", "bytes");
+
+    Counts total;
+    Counts interval;
+    TraceRecord r;
+    uint64_t traced_ns = 0;
+    const uint64_t start = now_ns();
+    uint64_t mark = start;
+
+    while (trace.next(r))
+    {
+        const int64_t key = int64_t(r.key);
+        traced_ns = r.time;
+
+        switch (r.op)
+        {
+        case Store::OP_SET:
+        case Store::OP_APPEND_POINTS:
+        case Store::OP_APPEND:
+        case Store::OP_MODIFY:
+            target.set(key, r.bytes);
+            break;
+
+        case Store::OP_GET:
+        case Store::OP_RANGE:
+        case Store::OP_READ:
+            ++interval.gets;
+            interval.hits += target.get(key);
+            interval.recorded_hits += r.bytes != 0;
+            break;
+
+        case Store::OP_DEL:
+            target.del(key);
+            break;
+        }
+
+        if (++interval.ops < every)
+            continue;
+
+        const uint64_t now = now_ns();
+        printf("%12llu %12.0f %10.4f %10.4f %12lu %14lu\n",
+               (unsigned long long)(total.ops + interval.ops),
+               interval.ops / ((now - mark) / 1e9),
+               ratio(interval.hits, interval.gets),
+               ratio(interval.recorded_hits, interval.gets),
+               (unsigned long)target.keys(), (unsigned long)target.bytes());
+
+        total.ops += interval.ops;
+        total.gets += interval.gets;
+        total.hits += interval.hits;
+        total.recorded_hits += interval.recorded_hits;
+        interval = Counts();
+        mark = now;
+    }
+
+    total.ops += interval.ops;
+    total.gets += interval.gets;
+    total.hits += interval.hits;
+    total.recorded_hits += interval.recorded_hits;
+
+    const double elapsed = (now_ns() - start) / 1e9;
+    printf("\n%llu ops in %.3fs (%.3fs when recorded), %.0f ops/sec\n",
+           (unsigned long long)total.ops, elapsed, traced_ns / 1e9, total.ops / elapsed);
+    printf("hit ratio %.4f (%.4f when recorded), %lu keys, %lu bytes\n",
+           ratio(total.hits, total.gets), ratio(total.recorded_hits, total.gets),
+           (unsigned long)target.keys(), (unsigned long)target.bytes());
+    return 0;
+}
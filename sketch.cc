@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "sketch.h"
+
+namespace bypass {
+
+namespace {
+
+/// splitmix64 finalizer
+inline uint64_t mix(uint64_t h)
+{
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    return h;
+}
+
+} // namespace
+
+uint64_t sketch_hash(const char* data, size_t length)
+{
+    // each 8 byte word is mixed in on its own so nearby inputs diverge
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ length;
+    for (; length >= 8 ; data += 8, length -= 8)
+    {
+        uint64_t w;
+        memcpy(&w, data, 8);
+        h = (h ^ mix(w)) * 0x9fb21c651e98df25ull;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, data, length);
+    return mix(h ^ mix(tail));
+}
+
+bool JsHyperLogLog::add(uint64_t hash)
+{
+    const uint32_t index = uint32_t(hash >> (64 - kPrecision));
+
+    // the guard bit caps the run so an all zero remainder still counts
+    const uint64_t rest = (hash << kPrecision) | (uint64_t(1) << (kPrecision - 1));
+    const uint8_t rank = uint8_t(__builtin_clzll(rest) + 1);
+
+    if (m_registers[index] >= rank)
+        return false;
+    m_registers[index] = rank;
+    return true;
+}
+
+void JsHyperLogLog::merge(const JsHyperLogLog& other)
+{
+    for (uint32_t i=0 ; i<kRegisters ; ++i)
+    {
+        if (other.m_registers[i] > m_registers[i])
+            m_registers[i] = other.m_registers[i];
+    }
+}
+
+uint64_t JsHyperLogLog::count() const
+{
+    const double m = kRegisters;
+    const double alpha = 0.7213 / (1 + 1.079 / m);
+
+    double sum = 0;
+    uint32_t zeros = 0;
+    for (uint32_t i=0 ; i<kRegisters ; ++i)
+    {
+        sum += std::ldexp(1.0, -int(m_registers[i]));
+        zeros += m_registers[i] == 0;
+    }
+
+    double estimate = alpha * m * m / sum;
+
+    // small cardinalities are more accurate by linear counting
+    if (estimate <= 2.5 * m && zeros)
+        estimate = m * std::log(m / zeros);
+
+    return uint64_t(estimate + 0.5);
+}
+
+void JsHyperLogLog::emit(ValueSink& out) const
+{
+    out.number(double(count()));
+}
+
+void JsHyperLogLog::measure(Footprint& out) const
+{
+    out.bytes += sizeof(*this) + m_registers.capacity();
+    ++out.nodes;
+}
+
+JsCountMin* JsCountMin::create(double epsilon, double delta)
+{
+    const double width = std::ceil(M_E / epsilon);
+    const double depth = std::max(1.0, std::ceil(std::log(1 / delta)));
+    if (!fits(width, depth))
+        return 0;
+    return new JsCountMin(uint32_t(width), uint32_t(depth));
+}
+
+size_t JsCountMin::slot(uint64_t hash, uint32_t row) const
+{
+    // rows use h1 + row * h2 from the two halves of one hash
+    const uint32_t h1 = uint32_t(hash);
+    const uint32_t h2 = uint32_t(hash >> 32) | 1;
+    return size_t(row) * m_width + (h1 + row * h2) % m_width;
+}
+
+void JsCountMin::add(uint64_t hash, uint32_t n)
+{
+    const uint32_t max = std::numeric_limits<uint32_t>::max();
+    for (uint32_t row=0 ; row<m_depth ; ++row)
+    {
+        uint32_t& c = m_counters[slot(hash, row)];
+        c = (max - c < n) ? max : c + n;
+    }
+    m_total += n;
+}
+
+uint32_t JsCountMin::estimate(uint64_t hash) const
+{
+    uint32_t out = std::numeric_limits<uint32_t>::max();
+    for (uint32_t row=0 ; row<m_depth ; ++row)
+    {
+        const uint32_t c = m_counters[slot(hash, row)];
+        if (c < out)
+            out = c;
+    }
+    return out;
+}
+
+bool JsCountMin::merge(const JsCountMin& other)
+{
+    if (other.m_width != m_width || other.m_depth != m_depth)
+        return false;
+
+    const uint32_t max = std::numeric_limits<uint32_t>::max();
+    for (size_t i=0 ; i<m_counters.size() ; ++i)
+    {
+        const uint32_t n = other.m_counters[i];
+        m_counters[i] = (max - m_counters[i] < n) ? max : m_counters[i] + n;
+    }
+    m_total += other.m_total;
+    return true;
+}
+
+void JsCountMin::emit(ValueSink& out) const
+{
+    out.begin_object(3);
+    out.key("width", 5);
+    out.number(m_width);
+    out.key("depth", 5);
+    out.number(m_depth);
+    out.key("total", 5);
+    out.number(double(m_total));
+    out.end_object();
+}
+
+void JsCountMin::measure(Footprint& out) const
+{
+    out.bytes += sizeof(*this) + m_counters.capacity() * sizeof(uint32_t);
+    ++out.nodes;
+}
+
+} // namespace bypass
@@ -0,0 +1,114 @@
+#ifndef BYPASS_SKETCH_H
+#define BYPASS_SKETCH_H
+
+#include <vector>
+
+#include <stdint.h>
+
+#include "value.h"
+
+namespace bypass {
+
+/// 64 bit hash of the bytes of an item added to a sketch
+uint64_t sketch_hash(const char* data, size_t length);
+
+/// distinct count estimate in a fixed 16kB, as redis pfadd/pfcount
+/// the top 14 bits of an item's hash pick one of 16384 registers which
+/// keeps the longest run of leading zeros seen in the rest, for a
+/// standard error of about 0.8%. merging keeps the larger register.
+/// emits as the estimate
+class JsHyperLogLog : public JsValue
+{
+    static const unsigned kPrecision = 14;
+    static const uint32_t kRegisters = 1 << kPrecision;
+
+    std::vector<uint8_t> m_registers;
+
+public:
+    virtual Kind kind() const { return KIND_HLL; }
+
+    JsHyperLogLog()
+        : m_registers(kRegisters)
+    {}
+
+    /// true if the estimate may have changed
+    bool add(uint64_t hash);
+
+    /// fold other into this, the union of both
+    void merge(const JsHyperLogLog& other);
+
+    uint64_t count() const;
+
+    virtual void emit(ValueSink& out) const;
+
+    virtual void measure(Footprint& out) const;
+};
+
+/// frequency estimates in fixed memory
+/// depth rows of width counters, an item adds to one counter per row and
+/// its estimate is the smallest of them. with width e / epsilon and depth
+/// ln(1 / delta) estimates exceed the true count by more than epsilon
+/// times the total with probability at most delta, and never undercount.
+/// emits as {width, depth, total}
+class JsCountMin : public JsValue
+{
+    uint32_t m_width;
+    uint32_t m_depth;
+    uint64_t m_total;
+    std::vector<uint32_t> m_counters;
+
+    /// counter of item in row
+    size_t slot(uint64_t hash, uint32_t row) const;
+
+public:
+    /// most counters one sketch may have, 256MB
+    static const size_t kMaxCounters = size_t(1) << 26;
+
+    virtual Kind kind() const { return KIND_COUNTMIN; }
+
+    /// 0.1% of the total with 99% confidence
+    JsCountMin()
+        : m_width(2719)
+        , m_depth(5)
+        , m_total(0)
+        , m_counters(size_t(m_width) * m_depth)
+    {}
+
+    /// width * depth must be at most kMaxCounters, see fits()
+    JsCountMin(uint32_t width, uint32_t depth)
+        : m_width(width)
+        , m_depth(depth)
+        , m_total(0)
+        , m_counters(size_t(width) * depth)
+    {}
+
+    /// true if a sketch of width by depth counters can be made
+    static bool fits(double width, double depth)
+    {
+        return width >= 1 && depth >= 1 && width * depth <= double(kMaxCounters);
+    }
+
+    /// sized for error epsilon of the total with probability delta
+    /// 0 if that needs more than kMaxCounters counters
+    static JsCountMin* create(double epsilon, double delta);
+
+    uint32_t width() const { return m_width; }
+    uint32_t depth() const { return m_depth; }
+    uint64_t total() const { return m_total; }
+
+    /// count an item n more times, counters saturate instead of wrapping
+    void add(uint64_t hash, uint32_t n);
+
+    uint32_t estimate(uint64_t hash) const;
+
+    /// add the counters of other, false if the dimensions differ
+    bool merge(const JsCountMin& other);
+
+    virtual void emit(ValueSink& out) const;
+
+    virtual void measure(Footprint& out) const;
+};
+
+} // namespace bypass
+
+#endif
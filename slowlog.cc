@@ -0,0 +1,74 @@
+#include <ctime>
+#include <algorithm>
+
+#include "slowlog.h"
+
+namespace bypass {
+
+namespace {
+
+bool newer(const SlowLog::Entry& a, const SlowLog::Entry& b)
+{
+    return a.id > b.id;
+}
+
+} // namespace
+
+SlowLog::SlowLog()
+    : m_head(0)
+    , m_max_len(128)
+    , m_next_id(0)
+    , m_slower_than_ns(10000000)
+    , m_larger_than_bytes(0)
+{}
+
+void SlowLog::max_len(size_t len)
+{
+    if (len == 0)
+        len = 1;
+
+    // rewrite oldest first so the ring can be appended to again
+    std::vector<Entry> keep = entries();
+    if (keep.size() > len)
+        keep.resize(len);
+    std::reverse(keep.begin(), keep.end());
+    m_ring.swap(keep);
+    m_head = 0;
+
+    m_max_len = len;
+}
+
+void SlowLog::record(const char* op, int64_t key, const Footprint& size, uint64_t duration_ns)
+{
+    Entry e;
+    e.id = m_next_id++;
+    e.time = time(0);
+    e.op = op;
+    e.key = key;
+    e.size = size;
+    e.duration_ns = duration_ns;
+
+    if (m_ring.size() < m_max_len)
+    {
+        m_ring.push_back(e);
+        return;
+    }
+
+    m_ring[m_head] = e;
+    m_head = (m_head + 1) % m_ring.size();
+}
+
+std::vector<SlowLog::Entry> SlowLog::entries() const
+{
+    std::vector<Entry> out(m_ring);
+    std::sort(out.begin(), out.end(), newer);
+    return out;
+}
+
+void SlowLog::reset()
+{
+    m_ring.clear();
+    m_head = 0;
+}
+
+} // namespace bypass
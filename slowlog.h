@@ -0,0 +1,72 @@
+#ifndef BYPASS_SLOWLOG_H
+#define BYPASS_SLOWLOG_H
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "value.h"
+
+namespace bypass {
+
+/// bounded log of operations that were slower or larger than a threshold
+/// kept as a ring buffer so the newest max_len entries survive
+class SlowLog
+{
+public:
+    struct Entry
+    {
+        // increases by one for every entry ever logged
+        uint64_t id;
+
+        // wall clock seconds when the operation finished
+        uint64_t time;
+
+        const char* op;
+        int64_t key;
+        Footprint size;
+        uint64_t duration_ns;
+    };
+
+private:
+    std::vector<Entry> m_ring;
+
+    // oldest entry once the ring is full
+    size_t m_head;
+
+    size_t m_max_len;
+    uint64_t m_next_id;
+    uint64_t m_slower_than_ns;
+    size_t m_larger_than_bytes;
+
+public:
+    /// logs operations slower than 10ms by default
+    SlowLog();
+
+    /// operations taking at least ns are logged, 0 disables the check
+    void slower_than(uint64_t ns) { m_slower_than_ns = ns; }
+
+    /// operations on values of at least bytes are logged, 0 disables the check
+    void larger_than(size_t bytes) { m_larger_than_bytes = bytes; }
+
+    /// drops the oldest entries if the log shrinks
+    void max_len(size_t len);
+
+    bool wants(uint64_t duration_ns, const Footprint& size) const
+    {
+        return (m_slower_than_ns && duration_ns >= m_slower_than_ns)
+            || (m_larger_than_bytes && size.bytes >= m_larger_than_bytes);
+    }
+
+    void record(const char* op, int64_t key, const Footprint& size, uint64_t duration_ns);
+
+    /// logged entries, newest first
+    std::vector<Entry> entries() const;
+
+    void reset();
+};
+
+} // namespace bypass
+
+#endif
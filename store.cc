@@ -0,0 +1,322 @@
+#include <cstdio>
+#include <algorithm>
+
+#include "store.h"
+#include "metrics.h"
+
+using namespace boost;
+
+namespace bypass {
+
+namespace {
+
+typedef std::pair<int64_t, Footprint> KeySize;
+
+bool larger(const KeySize& a, const KeySize& b)
+{
+    return a.second.bytes > b.second.bytes;
+}
+
+} // namespace
+
+const char* Store::op_name(Op op)
+{
+    switch (op)
+    {
+    case OP_SET: return "set";
+    case OP_GET: return "get";
+    case OP_DEL: return "del";
+    case OP_LIST: return "list";
+    case OP_APPEND_POINTS: return "appendPoints";
+    case OP_RANGE: return "range";
+    case OP_APPEND: return "append";
+    case OP_MODIFY: return "modify";
+    case OP_READ: return "read";
+    }
+
+    return "unknown";
+}
+
+Store::Cursor::Cursor(const Store& store)
+    : m_store(store)
+    , m_iter(store.m_cache.begin())
+    , m_split(store.m_cache.lower_bound(0))
+    , m_key(0)
+    , m_entry(0)
+    , m_phase(BELOW)
+    , m_next(0)
+{
+    if (store.m_frozen.empty())
+        return;
+
+    m_phase = FROZEN;
+    std::vector<std::pair<int64_t, uint32_t> > keys(store.m_frozen.size());
+    for (uint32_t i=0 ; i<keys.size() ; ++i)
+        keys[i] = std::make_pair(store.m_frozen[i].first, i);
+    std::sort(keys.begin(), keys.end());
+
+    m_order.resize(keys.size());
+    for (size_t i=0 ; i<keys.size() ; ++i)
+        m_order[i] = keys[i].second;
+}
+
+bool Store::Cursor::next()
+{
+    // the tree only holds keys the dense map does not take, so the dense
+    // keys all sort between its negative and non negative ones
+    switch (m_phase)
+    {
+    case BELOW:
+        if (m_iter != m_split)
+        {
+            m_key = m_iter->first;
+            m_entry = &m_iter->second;
+            ++m_iter;
+            return true;
+        }
+        m_phase = DENSE;
+        m_key = -1;
+        // fall through
+
+    case DENSE:
+    {
+        int64_t key = m_key + 1;
+        if (m_store.m_dense.size() && m_store.m_dense.next(key))
+        {
+            m_key = key;
+            m_entry = m_store.m_dense.find(key);
+            return true;
+        }
+        m_phase = ABOVE;
+    }
+        // fall through
+
+    case ABOVE:
+        if (m_iter == m_store.m_cache.end())
+            return false;
+        m_key = m_iter->first;
+        m_entry = &m_iter->second;
+        ++m_iter;
+        return true;
+
+    case FROZEN:
+        if (m_next == m_order.size())
+            return false;
+        m_key = m_store.m_frozen[m_order[m_next]].first;
+        m_entry = &m_store.m_frozen[m_order[m_next]].second;
+        ++m_next;
+        return true;
+    }
+    return false;
+}
+
+Store::Store(const shared_ptr<const RecordLayout>& layout, KeyMode key_mode)
+    : m_key_mode(key_mode)
+    , m_dense_on(key_mode == KEYS_DENSE)
+    , m_bytes(0)
+    , m_layout(layout)
+{
+    static uint32_t next_id = 0;
+    m_id = next_id++;
+
+    char name[16];
+    snprintf(name, sizeof(name), "%u", m_id);
+    m_name = name;
+
+    for (int i=0 ; i<JsValue::KIND_COUNT ; ++i)
+    {
+        m_kind_bytes[i] = 0;
+        m_kind_count[i] = 0;
+    }
+
+    MetricsRegistry::add(this);
+}
+
+Store::~Store()
+{
+    MetricsRegistry::remove(this);
+    if (!m_cache.empty())
+        Reclaimer::instance().release(m_cache);
+    if (m_dense.size())
+        Reclaimer::instance().release(m_dense);
+    if (!m_frozen.empty())
+        Reclaimer::instance().release(m_frozen);
+}
+
+void Store::clear()
+{
+    if (!m_cache.empty())
+        Reclaimer::instance().release(m_cache);
+    if (m_dense.size())
+        Reclaimer::instance().release(m_dense);
+    m_dense_on = m_key_mode == KEYS_DENSE;
+    if (!m_frozen.empty())
+        Reclaimer::instance().release(m_frozen);
+    m_frozen_hash.reset();
+
+    for (IndexMap::iterator iter = m_indexes.begin() ; iter != m_indexes.end() ; ++iter)
+        iter->second->clear();
+
+    m_bytes = 0;
+    for (int i=0 ; i<JsValue::KIND_COUNT ; ++i)
+    {
+        m_kind_bytes[i] = 0;
+        m_kind_count[i] = 0;
+    }
+}
+
+shared_ptr<JsValue> Store::encode(ValueSource& in)
+{
+    if (!m_profile)
+        return encode_value(in);
+
+    const uint64_t start = now_ns();
+    ProfilingSource p(in, *m_profile);
+    const shared_ptr<JsValue> v = encode_value(p);
+    p.finish();
+    m_profile->phases[CodecProfile::ENCODE].add(now_ns() - start);
+
+    return v;
+}
+
+shared_ptr<JsValue> Store::encode_value(ValueSource& in)
+{
+    shared_ptr<JsValue> v;
+    if (m_layout)
+        v = m_layout->encode(in);
+    if (!v)
+        v = bypass::encode(in, m_shape);
+
+    return v;
+}
+
+void Store::emit(const Entry& e, ValueSink& out)
+{
+    if (!m_profile)
+        return e.value->emit(out);
+
+    const uint64_t start = now_ns();
+    ProfilingSink p(out, *m_profile);
+    e.value->emit(p);
+    m_profile->phases[CodecProfile::DECODE].add(now_ns() - start, e.size.bytes);
+}
+
+void Store::go_dense()
+{
+    CacheMap::iterator iter = m_cache.lower_bound(0);
+    while (iter != m_cache.end() && DenseMap::fits(iter->first))
+    {
+        Entry& e = m_dense.insert(iter->first);
+        e.value.swap(iter->second.value);
+        e.size = iter->second.size;
+        m_cache.erase(iter++);
+    }
+    m_dense_on = true;
+}
+
+void Store::go_sparse()
+{
+    DenseMap dense;
+    dense.swap(m_dense);
+    for (int64_t key = 0 ; dense.next(key) ; ++key)
+    {
+        Entry& from = *dense.find(key);
+        Entry& e = m_cache[key];
+        e.value.swap(from.value);
+        e.size = from.size;
+    }
+    m_dense_on = false;
+}
+
+bool Store::freeze()
+{
+    if (m_frozen_hash)
+        return false;
+
+    std::vector<int64_t> keys;
+    keys.reserve(size());
+    for (Cursor c(*this) ; c.next() ; )
+        keys.push_back(c.key());
+
+    scoped_ptr<PerfectHash> hash(new PerfectHash());
+    hash->build(keys);
+
+    FrozenSlots slots(keys.size());
+    for (size_t i=0 ; i<keys.size() ; ++i)
+    {
+        std::pair<int64_t, Entry>& slot = slots[(*hash)(keys[i])];
+        slot.first = keys[i];
+        slot.second.value = find(keys[i])->value;
+    }
+
+    // pack in hash order so neighbouring slots hold neighbouring values
+    const shared_ptr<PackedValues> pack(new PackedValues());
+    for (size_t i=0 ; i<slots.size() ; ++i)
+    {
+        if (PackedValues::packable(*slots[i].second.value))
+            pack->add(*slots[i].second.value);
+    }
+
+    std::vector<shared_ptr<JsValue> > packed;
+    PackedValues::finish(pack, packed);
+    for (size_t i=0, n=0 ; i<slots.size() ; ++i)
+    {
+        if (PackedValues::packable(*slots[i].second.value))
+            slots[i].second.value = packed[n++];
+    }
+
+    if (!m_cache.empty())
+        Reclaimer::instance().release(m_cache);
+    if (m_dense.size())
+        Reclaimer::instance().release(m_dense);
+
+    m_bytes = 0;
+    for (int i=0 ; i<JsValue::KIND_COUNT ; ++i)
+    {
+        m_kind_bytes[i] = 0;
+        m_kind_count[i] = 0;
+    }
+    for (size_t i=0 ; i<slots.size() ; ++i)
+        remember(slots[i].second);
+
+    m_frozen.swap(slots);
+    m_frozen_hash.swap(hash);
+    return true;
+}
+
+std::vector<std::pair<int64_t, Footprint> > Store::big_keys(size_t n) const
+{
+    std::vector<KeySize> out;
+    out.reserve(size());
+
+    for (Cursor c(*this) ; c.next() ; )
+        out.push_back(KeySize(c.key(), c.entry().size));
+
+    n = std::min(n, out.size());
+    std::partial_sort(out.begin(), out.begin() + n, out.end(), larger);
+    out.resize(n);
+
+    return out;
+}
+
+bool Store::add_index(const std::string& name, const shared_ptr<StoreIndex>& index)
+{
+    if (m_indexes.count(name))
+        return false;
+
+    for (Cursor c(*this) ; c.next() ; )
+        index->add(c.key(), *c.entry().value);
+
+    m_indexes[name] = index;
+    return true;
+}
+
+size_t Store::secondary_bytes() const
+{
+    size_t out = 0;
+    for (IndexMap::const_iterator iter = m_indexes.begin() ; iter != m_indexes.end() ; ++iter)
+        out += iter->second->bytes();
+    return out;
+}
+
+} // namespace bypass
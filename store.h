@@ -0,0 +1,565 @@
+#ifndef BYPASS_STORE_H
+#define BYPASS_STORE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "value.h"
+#include "clock.h"
+#include "histogram.h"
+#include "slowlog.h"
+#include "hotkeys.h"
+#include "mrc.h"
+#include "trace.h"
+#include "profile.h"
+#include "reclaim.h"
+#include "index.h"
+#include "dense.h"
+#include "frozen.h"
+
+namespace bypass {
+
+/// per operation histograms
+/// latencies are in nanoseconds, value sizes in bytes
+struct OpLatency
+{
+    Histogram set;
+    Histogram get;
+    Histogram del;
+    Histogram list;
+    Histogram encode_bytes;
+    Histogram decode_bytes;
+
+    void reset()
+    {
+        set.reset();
+        get.reset();
+        del.reset();
+        list.reset();
+        encode_bytes.reset();
+        decode_bytes.reset();
+    }
+};
+
+/// operation counts, always kept
+struct StoreCounters
+{
+    uint64_t sets;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t dels;
+
+    StoreCounters()
+        : sets(0)
+        , hits(0)
+        , misses(0)
+        , dels(0)
+    {}
+};
+
+/// the cache itself, independent of v8
+/// maps integer keys to encoded values
+class Store
+{
+public:
+    enum Op
+    {
+        OP_SET,
+        OP_GET,
+        OP_DEL,
+        OP_LIST,
+        OP_APPEND_POINTS,
+        OP_RANGE,
+        OP_APPEND,
+
+        // in place changes and partial reads of hashes, sorted sets and deques
+        OP_MODIFY,
+        OP_READ
+    };
+
+    static const char* op_name(Op op);
+
+    struct Entry
+    {
+        boost::shared_ptr<JsValue> value;
+
+        // measured when the value is stored or changed in place
+        Footprint size;
+    };
+
+    typedef std::map<int64_t, Entry> CacheMap;
+    typedef DenseArray<Entry> DenseMap;
+
+    /// how keys are held
+    enum KeyMode
+    {
+        /// in a tree, any keys
+        KEYS_SPARSE,
+
+        /// keys 0..DenseMap::kMaxKey in a directly indexed array, others
+        /// in the tree
+        KEYS_DENSE,
+
+        /// sparse until the keys are found to be dense, then dense until
+        /// the dense pages are found to be mostly empty
+        KEYS_AUTO
+    };
+
+    /// smallest store auto mode checks for dense keys
+    static const size_t kDenseMinKeys = 1024;
+
+    /// entries of a frozen store by perfect hash position
+    typedef std::vector<std::pair<int64_t, Entry> > FrozenSlots;
+
+    /// every entry in key order
+    class Cursor
+    {
+        const Store& m_store;
+        CacheMap::const_iterator m_iter;
+        CacheMap::const_iterator m_split;
+        int64_t m_key;
+        const Entry* m_entry;
+
+        // negative keys in the tree, the dense keys, the rest of the tree,
+        // or the frozen slots sorted by key
+        enum { BELOW, DENSE, ABOVE, FROZEN } m_phase;
+        std::vector<uint32_t> m_order;
+        size_t m_next;
+
+    public:
+        explicit Cursor(const Store& store);
+
+        /// move to the next entry, false past the last one
+        bool next();
+
+        int64_t key() const { return m_key; }
+        const Entry& entry() const { return *m_entry; }
+    };
+
+private:
+    // keys the dense map does not take, or all of them while sparse
+    CacheMap m_cache;
+
+    // only used once the keys are dense
+    DenseMap m_dense;
+    KeyMode m_key_mode;
+    bool m_dense_on;
+
+    // set by freeze, when the tree and dense map are left empty
+    boost::scoped_ptr<PerfectHash> m_frozen_hash;
+    FrozenSlots m_frozen;
+
+    // sum of the footprints of all entries, in total and by kind
+    size_t m_bytes;
+    size_t m_kind_bytes[JsValue::KIND_COUNT];
+    size_t m_kind_count[JsValue::KIND_COUNT];
+
+    StoreCounters m_counters;
+
+    // unique for the life of the process
+    uint32_t m_id;
+
+    // label used for metrics
+    std::string m_name;
+
+    // set when the store was created with a schema
+    boost::shared_ptr<const RecordLayout> m_layout;
+
+    // shape of the last top level value encoded
+    boost::shared_ptr<const RecordLayout> m_shape;
+
+    // only allocated while latency tracking is on
+    boost::scoped_ptr<OpLatency> m_latency;
+
+    // only allocated while the slowlog is on
+    boost::scoped_ptr<SlowLog> m_slowlog;
+
+    // only allocated while hot keys are tracked
+    boost::scoped_ptr<HotKeys> m_hot_keys;
+
+    // only allocated while the miss ratio curve is estimated
+    boost::scoped_ptr<MissRatioCurve> m_mrc;
+
+    // only allocated while operations are traced to a file
+    boost::scoped_ptr<TraceWriter> m_trace;
+
+    // only allocated while codec costs are profiled
+    boost::scoped_ptr<CodecProfile> m_profile;
+
+    // secondary indexes by name, kept up to date on set and del
+    typedef std::map<std::string, boost::shared_ptr<StoreIndex> > IndexMap;
+    IndexMap m_indexes;
+
+    void index_remove(int64_t key, const JsValue& val)
+    {
+        for (IndexMap::iterator iter = m_indexes.begin() ; iter != m_indexes.end() ; ++iter)
+            iter->second->remove(key, val);
+    }
+
+    void index_add(int64_t key, const JsValue& val)
+    {
+        for (IndexMap::iterator iter = m_indexes.begin() ; iter != m_indexes.end() ; ++iter)
+            iter->second->add(key, val);
+    }
+
+    /// entry for key, empty if it was not set
+    Entry& slot(int64_t key)
+    {
+        if (m_dense_on && DenseMap::fits(key))
+            return m_dense.insert(key);
+        return m_cache[key];
+    }
+
+    /// everything del does but removing e from its map
+    void drop(int64_t key, Entry& e, Footprint& removed)
+    {
+        ++m_counters.dels;
+
+        removed = e.size;
+        if (!m_indexes.empty())
+            index_remove(key, *e.value);
+        forget(e);
+        release(e);
+    }
+
+    /// keys fill at least half of 0..max, checked in O(1) on the tree ends
+    bool keys_dense() const
+    {
+        if (m_cache.size() < kDenseMinKeys)
+            return false;
+        const int64_t first = m_cache.begin()->first;
+        const int64_t last = m_cache.rbegin()->first;
+        return first >= 0 && DenseMap::fits(last) && uint64_t(last) < 2 * m_cache.size();
+    }
+
+    /// move the keys that fit from the tree to the dense map
+    /// entries move, so pointers to them are stale afterwards
+    void go_dense();
+
+    /// the dense pages have over 8 slots for each key, checked in O(1).
+    /// keys_dense() needs half of them used, so the two cannot flip flop
+    bool pages_sparse() const
+    {
+        const size_t slots = m_dense.pages() * DenseMap::kPageSize;
+        return slots > 8 * kDenseMinKeys && m_dense.size() * 8 < slots;
+    }
+
+    /// move every key from the dense map back to the tree, the same way
+    void go_sparse();
+
+public:
+    void forget(const Entry& e)
+    {
+        const JsValue::Kind kind = e.value->kind();
+        m_bytes -= e.size.bytes;
+        m_kind_bytes[kind] -= e.size.bytes;
+        --m_kind_count[kind];
+    }
+
+    /// hand a large value to the background thread so dropping it is O(1)
+    /// small ones are cheaper to free right away
+    static void release(Entry& e)
+    {
+        if (e.size.nodes >= Reclaimer::kMinNodes)
+            Reclaimer::instance().release(e.value);
+    }
+
+    /// schema first, then the shape seen last
+    boost::shared_ptr<JsValue> encode_value(ValueSource& in);
+
+    void remember(Entry& e)
+    {
+        e.size = Footprint();
+        e.value->measure(e.size);
+
+        const JsValue::Kind kind = e.value->kind();
+        m_bytes += e.size.bytes;
+        m_kind_bytes[kind] += e.size.bytes;
+        ++m_kind_count[kind];
+    }
+
+public:
+    Store(const boost::shared_ptr<const RecordLayout>& layout = boost::shared_ptr<const RecordLayout>(),
+          KeyMode key_mode = KEYS_AUTO);
+    ~Store();
+
+    /// encode the current value of in using the schema if it fits
+    boost::shared_ptr<JsValue> encode(ValueSource& in);
+
+    /// write the value of e to out
+    void emit(const Entry& e, ValueSink& out);
+
+    Entry& set(int64_t key, const boost::shared_ptr<JsValue>& val)
+    {
+        const uint64_t start = m_profile ? now_ns() : 0;
+        ++m_counters.sets;
+
+        Entry& e = slot(key);
+        if (e.value)
+        {
+            if (!m_indexes.empty())
+                index_remove(key, *e.value);
+            forget(e);
+            release(e);
+        }
+        e.value = val;
+        remember(e);
+        if (!m_indexes.empty())
+            index_add(key, *val);
+
+        if (m_profile)
+            m_profile->phases[CodecProfile::INDEX].add(now_ns() - start, e.size.bytes);
+
+        if (m_key_mode == KEYS_AUTO && (m_dense_on ? pages_sparse() : keys_dense()))
+        {
+            if (m_dense_on)
+                go_sparse();
+            else
+                go_dense();
+            return *find(key);
+        }
+        return e;
+    }
+
+    /// entry for key, 0 if missing
+    Entry* find(int64_t key)
+    {
+        if (m_frozen_hash)
+        {
+            if (m_frozen.empty())
+                return 0;
+            std::pair<int64_t, Entry>& slot = m_frozen[(*m_frozen_hash)(key)];
+            return slot.first == key && slot.second.value ? &slot.second : 0;
+        }
+
+        if (m_dense_on && DenseMap::fits(key))
+            return m_dense.find(key);
+
+        CacheMap::iterator iter = m_cache.find(key);
+        if (iter == m_cache.end())
+            return 0;
+        return &iter->second;
+    }
+
+    /// same as find but counted as a hit or miss
+    Entry* lookup(int64_t key)
+    {
+        Entry* e = find(key);
+        if (e)
+            ++m_counters.hits;
+        else
+            ++m_counters.misses;
+        return e;
+    }
+
+    /// call after changing the value of e in place
+    void resized(Entry& e)
+    {
+        forget(e);
+        remember(e);
+    }
+
+    /// call after changing the value under key in place and resizing it
+    /// the indexes drop what they held for key and read the value again
+    void changed(int64_t key, const Entry& e)
+    {
+        if (m_indexes.empty())
+            return;
+        index_remove(key, *e.value);
+        index_add(key, *e.value);
+    }
+
+    /// same as above when the change is known, so the value is not measured
+    /// again. the kind of the value must not have changed
+    void resized(Entry& e, const Footprint& added, const Footprint& removed)
+    {
+        const JsValue::Kind kind = e.value->kind();
+        const size_t before = e.size.bytes;
+        e.size.bytes += added.bytes - removed.bytes;
+        e.size.nodes += added.nodes - removed.nodes;
+        m_bytes += e.size.bytes - before;
+        m_kind_bytes[kind] += e.size.bytes - before;
+    }
+
+    /// true if the key was present, its size is left in removed
+    bool del(int64_t key, Footprint& removed)
+    {
+        if (m_dense_on && DenseMap::fits(key))
+        {
+            Entry* e = m_dense.find(key);
+            if (!e)
+                return false;
+
+            drop(key, *e, removed);
+            m_dense.erase(key);
+            if (m_key_mode == KEYS_AUTO && pages_sparse())
+                go_sparse();
+            return true;
+        }
+
+        CacheMap::iterator iter = m_cache.find(key);
+        if (iter == m_cache.end())
+            return false;
+
+        drop(key, iter->second, removed);
+        m_cache.erase(iter);
+        return true;
+    }
+
+    size_t size() const { return m_cache.size() + m_dense.size() + m_frozen.size(); }
+
+    KeyMode key_mode() const { return m_key_mode; }
+
+    /// true once keys are held in the dense map
+    bool dense() const { return m_dense_on; }
+
+    /// drop every entry, the index and values are freed in the background
+    void clear();
+
+    /// memory held by all values
+    size_t bytes() const { return m_bytes; }
+
+    /// estimated memory of the index itself, the tree node of every entry
+    /// and the dense pages
+    size_t index_bytes() const
+    {
+        return m_cache.size() * (sizeof(CacheMap::value_type) + 4 * sizeof(void*)) + m_dense.bytes()
+            + m_frozen.capacity() * sizeof(FrozenSlots::value_type)
+            + (m_frozen_hash ? m_frozen_hash->bytes() : 0);
+    }
+
+    /// rebuild into a read only layout, a perfect hash over the keys and
+    /// plain values packed together in hash order. false if already frozen
+    /// set, del and changes in place must not be made afterwards
+    bool freeze();
+
+    bool frozen() const { return m_frozen_hash.get() != 0; }
+
+    /// memory held by and number of top level values of one kind
+    size_t bytes(JsValue::Kind kind) const { return m_kind_bytes[kind]; }
+    size_t count(JsValue::Kind kind) const { return m_kind_count[kind]; }
+
+    const StoreCounters& counters() const { return m_counters; }
+
+    uint32_t id() const { return m_id; }
+
+    /// defaults to the id
+    const std::string& name() const { return m_name; }
+    void set_name(const std::string& name) { m_name = name; }
+
+    /// count a get or set of key for the access statistics that are on
+    void touch(int64_t key)
+    {
+        if (m_hot_keys)
+            m_hot_keys->touch(key);
+        if (m_mrc)
+            m_mrc->access(key);
+    }
+
+    /// histograms to record into, 0 when tracking is off
+    OpLatency* latency() const { return m_latency.get(); }
+
+    /// turning tracking off discards what was recorded
+    void enable_latency(bool on)
+    {
+        if (!on)
+            m_latency.reset();
+        else if (!m_latency)
+            m_latency.reset(new OpLatency());
+    }
+
+    /// log to record slow operations into, 0 when off
+    SlowLog* slowlog() const { return m_slowlog.get(); }
+
+    /// turning the log off discards its entries
+    void enable_slowlog(bool on)
+    {
+        if (!on)
+            m_slowlog.reset();
+        else if (!m_slowlog)
+            m_slowlog.reset(new SlowLog());
+    }
+
+    /// sketch counting gets and sets, 0 when off
+    HotKeys* hot_keys() const { return m_hot_keys.get(); }
+
+    /// track the hottest keys with capacity counters, 0 turns tracking off
+    void enable_hot_keys(size_t capacity)
+    {
+        if (!capacity)
+            m_hot_keys.reset();
+        else if (!m_hot_keys || m_hot_keys->capacity() != capacity)
+            m_hot_keys.reset(new HotKeys(capacity));
+    }
+
+    /// lru hit ratio curve estimate, 0 when off
+    const MissRatioCurve* mrc() const { return m_mrc.get(); }
+    MissRatioCurve* mrc() { return m_mrc.get(); }
+
+    /// sample accesses at rate keeping at most max_keys, rate 0 turns it off
+    void enable_mrc(double rate, size_t max_keys)
+    {
+        if (rate <= 0)
+            m_mrc.reset();
+        else
+            m_mrc.reset(new MissRatioCurve(rate, max_keys));
+    }
+
+    /// codec costs by type and phase, 0 when off
+    CodecProfile* profile() const { return m_profile.get(); }
+
+    /// turning profiling off discards what was counted
+    void enable_profile(bool on)
+    {
+        if (!on)
+            m_profile.reset();
+        else if (!m_profile)
+            m_profile.reset(new CodecProfile());
+    }
+
+    /// trace being written, 0 when off
+    TraceWriter* trace() const { return m_trace.get(); }
+
+    /// start writing operations to a new trace at path, replacing any
+    /// trace in progress. false if the file cannot be created
+    bool start_trace(const std::string& path, uint64_t now_ns)
+    {
+        boost::scoped_ptr<TraceWriter> t(new TraceWriter());
+        if (!t->open(path, now_ns))
+            return false;
+        m_trace.swap(t);
+        return true;
+    }
+
+    void stop_trace() { m_trace.reset(); }
+
+    /// add a secondary index under name and feed it every entry
+    /// false if the name is taken
+    bool add_index(const std::string& name, const boost::shared_ptr<StoreIndex>& index);
+
+    /// index added under name, 0 if there is none
+    StoreIndex* index(const std::string& name) const
+    {
+        IndexMap::const_iterator iter = m_indexes.find(name);
+        return iter == m_indexes.end() ? 0 : iter->second.get();
+    }
+
+    /// false if there was no index under name
+    bool drop_index(const std::string& name) { return m_indexes.erase(name) != 0; }
+
+    /// memory held by all secondary indexes
+    size_t secondary_bytes() const;
+
+    /// up to n keys holding the largest values, largest first
+    std::vector<std::pair<int64_t, Footprint> > big_keys(size_t n) const;
+};
+
+} // namespace bypass
+
+#endif
@@ -0,0 +1,143 @@
+#include <cstring>
+#include <algorithm>
+
+#include "stringindex.h"
+
+namespace bypass {
+
+namespace {
+
+/// keeps what a scan visits until a limit or an end string
+class Matches : public RadixTree::Visitor
+{
+    std::vector<StringIndex::Match>& m_out;
+    size_t m_limit;
+
+    // strings must start with m_prefix, or sort before m_end when m_bounded
+    const std::string* m_prefix;
+    const std::string* m_end;
+
+public:
+    Matches(std::vector<StringIndex::Match>& out, size_t limit)
+        : m_out(out)
+        , m_limit(limit)
+        , m_prefix(0)
+        , m_end(0)
+    {}
+
+    void prefix(const std::string& p) { m_prefix = &p; }
+    void end(const std::string& e) { m_end = &e; }
+
+    virtual bool visit(const char* data, size_t length, int64_t id)
+    {
+        if (m_out.size() >= m_limit)
+            return false;
+        if (m_prefix && (length < m_prefix->size()
+                         || std::memcmp(data, m_prefix->data(), m_prefix->size())))
+            return false;
+        if (m_end && m_end->compare(0, std::string::npos, data, length) <= 0)
+            return false;
+
+        StringIndex::Match m;
+        m.value.assign(data, length);
+        m.key = id;
+        m_out.push_back(m);
+        return true;
+    }
+};
+
+} // namespace
+
+/// the strings at the indexed path
+class StringIndex::Collector : public PathSink
+{
+public:
+    std::vector<std::string> values;
+
+    Collector(const StringIndex& index)
+        : PathSink(index.m_paths)
+    {}
+
+protected:
+    virtual void found(size_t, const char* data, size_t length)
+    {
+        values.push_back(std::string(data, length));
+    }
+};
+
+StringIndex::StringIndex(const FieldPath& path)
+    : m_paths(1, path)
+{}
+
+void StringIndex::lookup(const std::string& value, std::vector<Match>& out) const
+{
+    Matches matches(out, size_t(-1));
+    m_tree.find(value.data(), value.size(), matches);
+}
+
+void StringIndex::prefix(const std::string& prefix, size_t limit, std::vector<Match>& out) const
+{
+    Matches matches(out, limit);
+    matches.prefix(prefix);
+    m_tree.scan(prefix.data(), prefix.size(), matches);
+}
+
+void StringIndex::range(const std::string& from, const std::string& to, bool bounded,
+                        size_t limit, std::vector<Match>& out) const
+{
+    Matches matches(out, limit);
+    if (bounded)
+        matches.end(to);
+    m_tree.scan(from.data(), from.size(), matches);
+}
+
+void StringIndex::add(int64_t key, const JsValue& val)
+{
+    Collector strings(*this);
+    val.emit(strings);
+    if (strings.values.empty())
+        return;
+
+    std::vector<std::string>& values = strings.values;
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+
+    for (size_t i=0 ; i<values.size() ; ++i)
+        m_tree.insert(values[i].data(), values[i].size(), key);
+    m_strings_of[key].swap(values);
+}
+
+void StringIndex::remove(int64_t key, const JsValue&)
+{
+    StringsOf::iterator iter = m_strings_of.find(key);
+    if (iter == m_strings_of.end())
+        return;
+
+    const std::vector<std::string>& values = iter->second;
+    for (size_t i=0 ; i<values.size() ; ++i)
+        m_tree.remove(values[i].data(), values[i].size(), key);
+    m_strings_of.erase(iter);
+}
+
+void StringIndex::clear()
+{
+    m_tree.clear();
+    m_strings_of.clear();
+}
+
+size_t StringIndex::bytes() const
+{
+    size_t out = sizeof(*this) + m_tree.bytes() + m_strings_of.bucket_count() * sizeof(void*);
+
+    StringsOf::const_iterator iter = m_strings_of.begin();
+    for (; iter != m_strings_of.end() ; ++iter)
+    {
+        out += sizeof(StringsOf::value_type) + 2 * sizeof(void*)
+            + iter->second.capacity() * sizeof(std::string);
+        for (size_t i=0 ; i<iter->second.size() ; ++i)
+            out += iter->second[i].capacity();
+    }
+    return out;
+}
+
+} // namespace bypass
@@ -0,0 +1,64 @@
+#ifndef BYPASS_STRINGINDEX_H
+#define BYPASS_STRINGINDEX_H
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+
+#include "index.h"
+#include "radixtree.h"
+
+namespace bypass {
+
+/// ordered index from the strings at one path to the keys holding them
+/// kept in a radix tree so besides exact lookups it serves every string
+/// with a prefix or in a range in byte order. strings in arrays at the
+/// path are indexed too, several keys can share a string. the strings
+/// indexed for each key are kept so they can be removed by key
+class StringIndex : public StoreIndex
+{
+public:
+    struct Match
+    {
+        std::string value;
+        int64_t key;
+    };
+
+private:
+    class Collector;
+
+    std::vector<FieldPath> m_paths;
+    RadixTree m_tree;
+
+    // distinct strings indexed for each key holding any
+    typedef boost::unordered_map<int64_t, std::vector<std::string> > StringsOf;
+    StringsOf m_strings_of;
+
+public:
+    explicit StringIndex(const FieldPath& path);
+
+    /// keys holding exactly value
+    void lookup(const std::string& value, std::vector<Match>& out) const;
+
+    /// up to limit strings starting with prefix in order
+    void prefix(const std::string& prefix, size_t limit, std::vector<Match>& out) const;
+
+    /// up to limit strings from from on in order, before to if bounded
+    void range(const std::string& from, const std::string& to, bool bounded,
+               size_t limit, std::vector<Match>& out) const;
+
+    /// distinct strings indexed
+    size_t strings() const { return m_tree.size(); }
+
+    virtual void add(int64_t key, const JsValue& val);
+    virtual void remove(int64_t key, const JsValue& val);
+    virtual void clear();
+    virtual size_t bytes() const;
+};
+
+} // namespace bypass
+
+#endif
@@ -54,3 +54,458 @@ assert.equal(got, undefined);
 assert.equal(store.get(2).index, 2);
 
 assert.deepEqual([0, 2, 3, 4], store.list());
+
+// time series are appended in place and decoded by timestamp range
+var series = new bypass.BypassStore();
+assert.equal(series.appendPoints(7, [1000, 2000, 3000], [1.5, 1.5, 2.25]), 3);
+assert.equal(series.appendPoints(7, [4000, 5010], [-0.5, 1e10]), 5);
+assert.deepEqual(series.get(7), [1000, 2000, 3000, 4000, 5010, 1.5, 1.5, 2.25, -0.5, 1e10]);
+assert.deepEqual(series.range(7, 2000, 4000), [2000, 3000, 4000, 1.5, 2.25, -0.5]);
+assert.throws(function() { series.appendPoints(7, [10], [1]); });
+assert.throws(function() { store.appendPoints(0, [10], [1]); });
+
+// schema stores lay records out at fixed offsets, anything else falls back
+var people = new bypass.BypassStore({schema: {name: 'string', age: 'number'}});
+people.set(1, {name: 'ängel', age: 31.5});
+people.set(2, {name: 'bob', age: 'unknown'});
+people.set(3, {name: 'carl', age: 40, extra: [1, 2]});
+assert.deepEqual(people.get(1), {name: 'ängel', age: 31.5});
+assert.deepEqual(people.get(2), {name: 'bob', age: 'unknown'});
+assert.deepEqual(people.get(3), {name: 'carl', age: 40, extra: [1, 2]});
+assert.throws(function() { new bypass.BypassStore({schema: {a: 'date'}}); });
+
+// objects of one shape share a compiled layout, the guard catches changes
+var shapes = new bypass.BypassStore();
+var docs = [
+    {a: 1, b: 'x', c: {d: [1, {e: 'f'}]}},
+    {a: 2, b: 'y', c: {d: [2, {e: 'g'}]}},
+    {a: 'three', b: 3, c: [3]},
+    {b: 'z', a: 4, c: {}},
+    {a: 5, b: 'w'}
+];
+docs.forEach(function(d, i) { shapes.set(i, d); });
+docs.forEach(function(d, i) { assert.deepEqual(shapes.get(i), d); });
+
+// member names holding NUL do not alias another shape
+var plain = {x: [], y: []};
+var tricky = {};
+tricky['x\u00002y'] = [1];
+shapes.set(10, plain);
+shapes.set(11, tricky);
+assert.deepEqual(shapes.get(10), plain);
+assert.deepEqual(shapes.get(11), tricky);
+
+// latency histograms are off unless asked for
+assert.equal(store.latency().enabled, false);
+var timed = new bypass.BypassStore({latency: true});
+timed.set(1, template_document);
+timed.get(1);
+timed.get(2);
+var lat = timed.latency({reset: true});
+assert.equal(lat.set.count, 1);
+assert.equal(lat.get.count, 2);
+assert.ok(lat.encodeBytes.max > 0);
+assert.equal(timed.latency().get.count, 0);
+assert.equal(timed.latency({enable: false}).enabled, false);
+
+// the slowlog records anything over a threshold, big keys come from the index
+var logged = new bypass.BypassStore({slowlog: {slowerThan: 0, largerThan: 100}});
+logged.set(1, 'small');
+logged.set(2, {list: new Array(64).join('x,').split(',')});
+logged.get(2);
+var slow = logged.slowlog({reset: true});
+assert.equal(slow.length, 2);
+assert.equal(slow[0].op, 'get');
+assert.equal(slow[1].op, 'set');
+assert.equal(slow[0].key, 2);
+assert.ok(slow[0].bytes > 100 && slow[0].nodes > 64);
+assert.deepEqual(logged.slowlog(), []);
+assert.equal(logged.bigKeys(1)[0].key, 2);
+assert.equal(logged.bigKeys().length, 2);
+
+// hot keys are counted on gets and sets with a fixed number of counters
+var hot = new bypass.BypassStore({hotKeys: 4});
+for (var i=0 ; i<50 ; ++i) {
+    hot.set(i % 10, i);
+    hot.get(3);
+}
+var top = hot.hotKeys(2);
+assert.equal(top.length, 2);
+assert.equal(top[0].key, 3);
+assert.ok(top[0].count - top[0].error <= 55 && top[0].count >= 55);
+assert.deepEqual(hot.hotKeys(1, {reset: true}).length, 1);
+assert.deepEqual(hot.hotKeys(), []);
+assert.deepEqual(store.hotKeys(), []);
+assert.throws(function() { new bypass.BypassStore({hotKeys: -1}); }, RangeError);
+assert.throws(function() { new bypass.BypassStore({hotKeys: 1e12}); }, RangeError);
+
+// stats estimate the lru hit ratio against capacity from sampled accesses
+var sized = new bypass.BypassStore({mrc: {rate: 1}});
+for (var i=0 ; i<1000 ; ++i)
+    sized.set(i % 100, i);
+var stats = sized.stats();
+assert.equal(stats.keys, 100);
+assert.ok(stats.bytes > 0);
+assert.equal(stats.mrc.sampled, 1000);
+var last = stats.mrc.curve[stats.mrc.curve.length - 1];
+assert.equal(last.keys, 100);
+assert.ok(Math.abs(last.hitRatio - 0.9) < 1e-9);
+assert.equal(sized.stats({reset: true}).mrc.sampled, 1000);
+assert.equal(sized.stats().mrc.sampled, 0);
+assert.equal(sized.stats().mrc.rate, 1);
+assert.equal(store.stats().mrc, undefined);
+assert.throws(function() { new bypass.BypassStore({mrc: {maxKeys: -1}}); }, RangeError);
+assert.throws(function() { new bypass.BypassStore({mrc: {maxKeys: 1e12}}); }, RangeError);
+assert.throws(function() { new bypass.BypassStore({mrc: {rate: 0}}); }, RangeError);
+assert.throws(function() { new bypass.BypassStore({mrc: {rate: 2}}); }, RangeError);
+
+// traces record every operation until stopped
+var trace_path = require('path').join(require('os').tmpdir(), 'bypass-test-' + process.pid + '.trace');
+var traced = new bypass.BypassStore();
+assert.equal(traced.trace().recording, false);
+assert.equal(traced.trace(trace_path).path, trace_path);
+traced.set(1, 'one');
+traced.get(1);
+traced.get(2);
+traced.del(1);
+assert.equal(traced.trace().records, 4);
+assert.equal(traced.trace(false).recording, false);
+assert.equal(require('fs').readFileSync(trace_path).slice(0, 8).toString(), 'BYPTRC1\n');
+require('fs').unlinkSync(trace_path);
+assert.throws(function() { traced.trace('/nonexistent/dir/trace'); });
+
+// metrics are rendered natively in the prometheus text format
+var scraped = new bypass.BypassStore({name: 'scraped'});
+scraped.set(1, 'one');
+scraped.get(1);
+scraped.get(2);
+var text = scraped.metrics();
+assert.ok(/^bypass_entries\{store="scraped"\} 1$/m.test(text));
+assert.ok(/^bypass_hits_total\{store="scraped"\} 1$/m.test(text));
+assert.ok(/^bypass_misses_total\{store="scraped"\} 1$/m.test(text));
+assert.ok(/^bypass_values\{store="scraped",kind="string"\} 1$/m.test(text));
+assert.ok(bypass.metrics().indexOf('store="scraped"') >= 0);
+
+// codec costs are broken down by value type and phase when profiling
+var profiled = new bypass.BypassStore({profile: true});
+profiled.set(1, {name: 'x', list: [1, 2.5, 'y']});
+profiled.get(1);
+var codec = profiled.stats().codec;
+assert.equal(codec.phases.encode.calls, 1);
+assert.equal(codec.phases.decode.calls, 1);
+assert.equal(codec.encode.object.calls, 1);
+assert.ok(codec.encode.string.calls >= 2);
+assert.equal(codec.encode.string.bytes, 2);
+assert.equal(codec.decode.object.calls, 1);
+assert.equal(codec.decode.array.calls, 1);
+assert.equal(codec.decode.string.calls, 2);
+assert.equal(profiled.stats({reset: true}).codec.decode.string.calls, 2);
+assert.equal(profiled.stats().codec.decode.string.calls, 0);
+assert.equal(store.stats().codec, undefined);
+
+// large values and closed stores are freed in the background
+var closing = new bypass.BypassStore();
+var big = [];
+for (var i=0 ; i<1000 ; ++i)
+    big.push('item ' + i);
+closing.set(1, big);
+closing.set(2, big);
+closing.del(1);
+assert.equal(closing.get(1), undefined);
+assert.deepEqual(closing.get(2), big);
+closing.close();
+assert.equal(closing.stats().keys, 0);
+assert.equal(closing.stats().bytes, 0);
+assert.equal(closing.get(2), undefined);
+closing.set(3, 'again');
+assert.equal(closing.get(3), 'again');
+
+// huge values can be decoded a slice at a time off the current turn
+var sliced = new bypass.BypassStore();
+var nested = {name: 'n', list: big, inner: {deep: [1, {x: 'y'}]}};
+sliced.set(1, nested);
+sliced.set(2, big);
+var streamed = [];
+var callbacks = 0;
+sliced.getIncremental(1, {budgetMs: 0.01}, function(err, val) {
+    assert.equal(err, null);
+    assert.deepEqual(val, nested);
+    ++callbacks;
+});
+sliced.getIncremental(3, function(err, val) {
+    assert.equal(val, undefined);
+    ++callbacks;
+});
+sliced.getStream(2, {batchSize: 300}, function(err, items, done) {
+    assert.ok(items.length <= 300);
+    streamed = streamed.concat(items);
+    if (done) {
+        assert.deepEqual(streamed, big);
+        ++callbacks;
+    }
+});
+sliced.del(1);
+assert.throws(function() { sliced.getStream(2); });
+assert.throws(function() { sliced.set(4, 'x'); sliced.getStream(4, function() {}); });
+process.on('exit', function() { assert.equal(callbacks, 3); });
+
+// arrays grow in place and can be capped from the front
+var feed = new bypass.BypassStore();
+assert.equal(feed.append(1, ['a', 'b']), 2);
+assert.equal(feed.append(1, [{c: 3}]), 3);
+assert.deepEqual(feed.get(1), ['a', 'b', {c: 3}]);
+feed.set(2, [1, 2, 3]);
+assert.equal(feed.append(2, [4, 5], {maxLength: 3}), 3);
+assert.deepEqual(feed.get(2), [3, 4, 5]);
+var feed_bytes = feed.stats().bytes;
+feed.append(2, [6], {maxLength: 3});
+assert.equal(feed.stats().bytes, feed_bytes);
+feed.set(3, 'text');
+assert.throws(function() { feed.append(3, [1]); });
+assert.throws(function() { feed.append(1, 'x'); });
+assert.throws(function() { feed.append(1, [1], {maxLength: -1}); });
+
+// deques, hashes and sorted sets are changed in place
+var types = new bypass.BypassStore();
+types.rpush(1, [2, 3]);
+assert.equal(types.lpush(1, [0, 1]), 4);
+assert.deepEqual(types.get(1), [0, 1, 2, 3]);
+assert.equal(types.lpop(1), 0);
+assert.equal(types.rpop(1), 3);
+assert.deepEqual(types.get(1), [1, 2]);
+assert.equal(types.lpop(9), undefined);
+
+assert.equal(types.hset(2, 'a', {x: 1}), true);
+assert.equal(types.hset(2, 'b', 'two'), true);
+assert.equal(types.hset(2, 'b', 'deux'), false);
+assert.deepEqual(types.hget(2, 'a'), {x: 1});
+assert.equal(types.hget(2, 'c'), undefined);
+assert.equal(types.hdel(2, 'a'), true);
+assert.equal(types.hdel(2, 'a'), false);
+assert.deepEqual(types.get(2), {b: 'deux'});
+
+assert.equal(types.zadd(3, 5, 'five'), true);
+assert.equal(types.zadd(3, 1, 'one'), true);
+assert.equal(types.zadd(3, 3, 'three'), true);
+assert.equal(types.zadd(3, 4, 'three'), false);
+assert.deepEqual(types.zrange(3, 0, -1), ['one', 'three', 'five']);
+assert.deepEqual(types.zrange(3, -2, -1, {withScores: true}), ['three', 4, 'five', 5]);
+assert.equal(types.zrank(3, 'five'), 2);
+assert.equal(types.zscore(3, 'three'), 4);
+assert.equal(types.zrem(3, 'one'), true);
+assert.equal(types.zrank(3, 'one'), undefined);
+assert.deepEqual(types.get(3), ['three', 4, 'five', 5]);
+
+assert.throws(function() { types.hset(3, 'a', 1); });
+assert.throws(function() { types.zadd(2, 1, 'a'); });
+assert.throws(function() { types.lpush(2, [1]); });
+assert.throws(function() { types.zadd(3, NaN, 'a'); });
+assert.equal(types.stats().keys, 3);
+
+// roaring bitmaps hold integer sets natively
+var bitmaps = new bypass.BypassStore();
+var evens = [];
+for (var i=0 ; i<20000 ; i+=2)
+    evens.push(i);
+assert.equal(bitmaps.bitmapAdd(1, evens), 10000);
+assert.equal(bitmaps.bitmapAdd(1, [0, 2, 4294967295]), 1);
+assert.equal(bitmaps.bitmapAdd(2, [1, 2, 3, 4, 70000]), 5);
+assert.equal(bitmaps.bitmapCount(1), 10001);
+assert.equal(bitmaps.bitmapContains(1, 4294967295), true);
+assert.equal(bitmaps.bitmapContains(1, 3), false);
+assert.equal(bitmaps.bitmapRemove(1, [4294967295, 5]), 1);
+assert.deepEqual(Array.prototype.slice.call(bitmaps.bitmapAnd(1, 2)), [2, 4]);
+assert.equal(bitmaps.bitmapOr(1, 2, 3), 10003);
+assert.equal(bitmaps.bitmapCount(3), 10003);
+assert.equal(bitmaps.bitmapAndNot(2, 1).length, 3);
+assert.equal(bitmaps.bitmapToArray(9).length, 0);
+assert.deepEqual(bitmaps.get(2), [1, 2, 3, 4, 70000]);
+assert.throws(function() { bitmaps.bitmapAdd(1, [-1]); });
+assert.throws(function() { bitmaps.bitmapAdd(1, 'x'); });
+bitmaps.set(4, 'text');
+assert.throws(function() { bitmaps.bitmapAnd(1, 4); });
+
+// sketches count in fixed memory
+var sketches = new bypass.BypassStore();
+var visitors = [];
+for (var i=0 ; i<5000 ; ++i)
+    visitors.push('visitor ' + i);
+assert.equal(sketches.pfadd(1, visitors), true);
+assert.equal(sketches.pfadd(1, visitors.slice(0, 100)), false);
+assert.ok(Math.abs(sketches.pfcount(1) - 5000) < 250);
+sketches.pfadd(2, ['visitor 1', 'someone else']);
+assert.ok(Math.abs(sketches.pfcount([1, 2]) - 5001) < 250);
+sketches.pfmerge(3, [1, 2]);
+assert.equal(sketches.pfcount(3), sketches.pfcount([1, 2]));
+assert.equal(sketches.pfcount(9), 0);
+
+sketches.cmsInit(4, {epsilon: 0.01, delta: 0.01});
+sketches.cmsIncr(4, ['a', 'b', 'a']);
+sketches.cmsIncr(4, ['c'], [10]);
+assert.deepEqual(sketches.cmsQuery(4, ['a', 'b', 'c', 'd']), [2, 1, 10, 0]);
+assert.equal(sketches.get(4).total, 13);
+sketches.cmsMerge(5, [4, 4]);
+assert.deepEqual(sketches.cmsQuery(5, ['a']), [4]);
+assert.throws(function() { sketches.cmsInit(4, {width: 10, depth: 2}); });
+assert.throws(function() { sketches.cmsInit(6, {width: 65536, depth: 65536}); }, RangeError);
+assert.throws(function() { sketches.cmsInit(6, {epsilon: 1e-12, delta: 0.01}); }, RangeError);
+assert.equal(sketches.get(6), undefined);
+assert.throws(function() { sketches.cmsIncr(1, ['a']); });
+assert.throws(function() { sketches.cmsIncr(4, ['a'], [-1]); }, RangeError);
+assert.throws(function() { sketches.cmsIncr(4, ['a'], [1.5]); }, RangeError);
+assert.deepEqual(sketches.cmsQuery(4, ['a']), [2]);
+assert.throws(function() { sketches.pfadd(4, ['a']); });
+
+// text indexes follow sets and dels and rank by bm25
+var articles = new bypass.BypassStore();
+articles.set(1, {title: 'Native caches', body: 'values live outside the heap'});
+articles.createTextIndex('text', ['title', 'body', 'meta.tags']);
+articles.set(2, {title: 'Heap growth', body: 'the heap grows and the heap pauses', meta: {tags: ['gc']}});
+articles.set(3, {title: 'Unrelated', body: 'nothing to see'});
+assert.deepEqual(articles.search('text', 'heap'), [2, 1]);
+assert.deepEqual(articles.search('text', ['HEAP', 'native'], {limit: 1}), [1]);
+assert.deepEqual(articles.search('text', 'gc'), [2]);
+assert.equal(articles.search('text', 'heap', {withScores: true}).length, 4);
+articles.del(2);
+assert.deepEqual(articles.search('text', 'heap'), [1]);
+articles.set(1, {title: 'Replaced'});
+assert.deepEqual(articles.search('text', 'heap'), []);
+articles.append(4, [{body: 'heap notes'}]);
+articles.hset(5, 'title', 'heap of hashes');
+assert.deepEqual(articles.search('text', 'heap').sort(), [4, 5]);
+articles.lpop(4);
+articles.hset(5, 'title', 'renamed');
+assert.deepEqual(articles.search('text', 'heap'), []);
+assert.ok(articles.stats().indexBytes > 0);
+assert.throws(function() { articles.createTextIndex('text', 'title'); });
+assert.throws(function() { articles.createTextIndex('other', 'title', {tokenizer: 'nope'}); });
+assert.equal(articles.dropIndex('text'), true);
+assert.throws(function() { articles.search('text', 'heap'); });
+
+// vector indexes find the nearest stored embeddings
+var embeddings = new bypass.BypassStore();
+embeddings.set(1, {v: [1, 0, 0]});
+embeddings.createVectorIndex('v', 'v', {dimensions: 3});
+embeddings.createVectorIndex('dot', 'v', {dimensions: 3, metric: 'dot', hnsw: {m: 4}});
+embeddings.set(2, {v: [0, 1, 0]});
+embeddings.set(3, {v: [0.9, 0.1, 0]});
+embeddings.set(4, {v: [1, 2]});
+assert.deepEqual(embeddings.nearest('v', [1, 0, 0], {k: 2}), [1, 3]);
+assert.deepEqual(embeddings.nearest('v', [0, 1, 0], {k: 1, withScores: true}), [2, 0]);
+assert.deepEqual(embeddings.nearest('dot', [0, 2, 0], {k: 3}), [2, 3, 1]);
+assert.deepEqual(embeddings.nearest('dot', [0, 2, 0], {k: 3, exact: true}), [2, 3, 1]);
+embeddings.del(1);
+assert.deepEqual(embeddings.nearest('v', [1, 0, 0]), [3, 2]);
+assert.deepEqual(embeddings.nearest('dot', [1, 0, 0], {k: 1}), [3]);
+assert.throws(function() { embeddings.nearest('v', [1, 0]); });
+assert.throws(function() { embeddings.nearest('none', [1, 0, 0]); });
+assert.throws(function() { embeddings.createVectorIndex('x', 'v', {dimensions: 0}); });
+assert.throws(function() { embeddings.createVectorIndex('x', 'v', {dimensions: 3, metric: 'nope'}); });
+
+// string indexes serve exact, prefix and ordered range lookups
+var users = new bypass.BypassStore();
+users.set(1, {path: 'user:123:name'});
+users.createStringIndex('path', 'path');
+users.set(2, {path: 'user:123:email'});
+users.set(3, {path: 'user:124:name'});
+users.set(4, {path: ['user:12', 'zzz']});
+users.set(5, {path: 'user:123:name'});
+assert.deepEqual(users.lookup('path', 'user:123:name').sort(), [1, 5]);
+assert.deepEqual(users.lookup('path', 'user:125'), []);
+assert.deepEqual(users.scanPrefix('path', 'user:123:'), [2, 1, 5]);
+assert.deepEqual(users.scanPrefix('path', 'user:12', {limit: 2}), [4, 2]);
+assert.deepEqual(users.scanPrefix('path', 'user:124', {withStrings: true}), ['user:124:name', 3]);
+assert.deepEqual(users.scanRange('path', 'user:123:f', 'user:124:name'), [1, 5]);
+assert.deepEqual(users.scanRange('path', 'user:124'), [3, 4]);
+users.del(5);
+users.set(1, {path: 'other'});
+assert.deepEqual(users.scanPrefix('path', 'user:123:'), [2]);
+assert.deepEqual(users.scanRange('path', null, 'user', {withStrings: true}), ['other', 1]);
+assert.throws(function() { users.lookup('none', 'x'); });
+users.append(7, [{path: 'user:7'}]);
+assert.deepEqual(users.lookup('path', 'user:7'), [7]);
+users.lpop(7);
+users.del(7);
+assert.deepEqual(users.lookup('path', 'user:7'), []);
+users.hset(8, 'path', 'user:9');
+users.hset(8, 'path', 'user:8');
+assert.deepEqual(users.lookup('path', 'user:9'), []);
+users.del(8);
+assert.deepEqual(users.scanPrefix('path', 'user:8'), []);
+
+// dense integer keys index an array directly
+var dense = new bypass.BypassStore({keys: 'dense'});
+dense.set(0, 'zero');
+dense.set(5000, 'far');
+dense.set(-3, 'negative');
+assert.equal(dense.get(5000), 'far');
+assert.equal(dense.get(-3), 'negative');
+assert.equal(dense.get(7), undefined);
+assert.deepEqual(dense.list(), [-3, 0, 5000]);
+dense.del(0);
+assert.deepEqual(dense.list(), [-3, 5000]);
+assert.equal(dense.stats().denseKeys, true);
+
+var counted = new bypass.BypassStore();
+for (var i=0 ; i<2000 ; ++i)
+    counted.set(i, i);
+assert.equal(counted.stats().denseKeys, true);
+assert.equal(counted.get(1999), 1999);
+assert.equal(counted.list().length, 2000);
+
+// scattered keys send an auto store back to the tree
+var scattered = new bypass.BypassStore();
+for (var i=0 ; i<1024 ; ++i)
+    scattered.set(i * 2, i);
+assert.equal(scattered.stats().denseKeys, true);
+for (var i=1 ; i<=100 ; ++i)
+    scattered.set(i * 1000000, i);
+assert.equal(scattered.stats().denseKeys, false);
+assert.equal(scattered.get(2046), 1023);
+assert.equal(scattered.get(100000000), 100);
+assert.equal(scattered.list().length, 1124);
+assert.equal(new bypass.BypassStore({keys: 'sparse'}).stats().denseKeys, false);
+assert.throws(function() { new bypass.BypassStore({keys: 'nope'}); });
+
+// a frozen store is read only and looked up through a perfect hash
+var frozen = new bypass.BypassStore();
+frozen.set(30, {name: 'x', tags: ['a', 'b']});
+frozen.set(-2, 'str');
+frozen.set(1e9, [1, 2.5, {deep: true}]);
+frozen.hset(7, 'f', 'v');
+assert.equal(frozen.freeze(), true);
+assert.equal(frozen.freeze(), false);
+assert.equal(frozen.stats().frozen, true);
+assert.deepEqual(frozen.get(30), {name: 'x', tags: ['a', 'b']});
+assert.equal(frozen.get(-2), 'str');
+assert.deepEqual(frozen.get(1e9), [1, 2.5, {deep: true}]);
+assert.equal(frozen.hget(7, 'f'), 'v');
+assert.equal(frozen.get(31), undefined);
+assert.deepEqual(frozen.list(), [-2, 7, 30, 1e9]);
+assert.throws(function() { frozen.set(1, 1); }, /frozen/);
+assert.throws(function() { frozen.del(30); }, /frozen/);
+assert.throws(function() { frozen.hset(7, 'g', 'w'); }, /frozen/);
+assert.equal(frozen.get(30).name, 'x');
+
+var frozenNested = new bypass.BypassStore();
+var pairs = [];
+for (var i=0 ; i<50 ; ++i)
+    pairs.push([i, {at: [i, String(i)]}]);
+frozenNested.set(1, pairs);
+frozenNested.set(2, {name: 'n', inner: {deep: [1, {x: 'y'}]}});
+frozenNested.freeze();
+var frozenStreamed = [];
+var frozenCallbacks = 0;
+frozenNested.getStream(1, {batchSize: 7}, function(err, items, done) {
+    assert.ok(items.length <= 7);
+    frozenStreamed = frozenStreamed.concat(items);
+    if (done) {
+        assert.deepEqual(frozenStreamed, pairs);
+        ++frozenCallbacks;
+    }
+});
+frozenNested.getIncremental(2, {budgetMs: 0.01}, function(err, val) {
+    assert.deepEqual(val, {name: 'n', inner: {deep: [1, {x: 'y'}]}});
+    ++frozenCallbacks;
+});
+process.on('exit', function() { assert.equal(frozenCallbacks, 2); });
@@ -0,0 +1,298 @@
+#include <cmath>
+#include <algorithm>
+
+#include "textindex.h"
+
+namespace bypass {
+
+namespace {
+
+// bm25 parameters, the usual defaults
+const double kK1 = 1.2;
+const double kB = 0.75;
+
+void put_varint(std::vector<uint8_t>& out, uint32_t val)
+{
+    while (val >= 0x80)
+    {
+        out.push_back(uint8_t(val | 0x80));
+        val >>= 7;
+    }
+    out.push_back(uint8_t(val));
+}
+
+uint32_t get_varint(const uint8_t*& p)
+{
+    uint32_t val = 0;
+    for (unsigned shift=0 ; ; shift+=7)
+    {
+        const uint8_t b = *p++;
+        val |= uint32_t(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return val;
+    }
+}
+
+inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+inline bool is_word(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+        || (c & 0x80);
+}
+
+bool by_score(const TextIndex::Hit& a, const TextIndex::Hit& b)
+{
+    return a.score > b.score || (a.score == b.score && a.key < b.key);
+}
+
+} // namespace
+
+/// counts the words of every string at the indexed paths
+class TextIndex::Collector : public PathSink
+{
+    const TextIndex& m_index;
+
+public:
+    TermCounts counts;
+    uint32_t length;
+
+    Collector(const TextIndex& index)
+        : PathSink(index.m_paths)
+        , m_index(index)
+        , length(0)
+    {}
+
+protected:
+    virtual void found(size_t, const char* data, size_t size)
+    {
+        m_index.tokenize(data, size, counts, length);
+    }
+};
+
+TextIndex::TextIndex(const std::vector<FieldPath>& paths, Tokenizer tokenizer)
+    : m_paths(paths)
+    , m_tokenizer(tokenizer)
+    , m_live(0)
+    , m_total_length(0)
+{}
+
+bool TextIndex::tokenizer(const std::string& name, Tokenizer& out)
+{
+    if (name == "simple")
+        out = SIMPLE;
+    else if (name == "whitespace")
+        out = WHITESPACE;
+    else
+        return false;
+    return true;
+}
+
+void TextIndex::tokenize(const char* data, size_t length, TermCounts& out, uint32_t& count) const
+{
+    std::string word;
+    for (size_t i=0 ; i<=length ; ++i)
+    {
+        const bool end = i == length ||
+            (m_tokenizer == SIMPLE ? !is_word(data[i]) : is_space(data[i]));
+        if (!end)
+        {
+            char c = data[i];
+            if (m_tokenizer == SIMPLE && c >= 'A' && c <= 'Z')
+                c += 'a' - 'A';
+            word += c;
+            continue;
+        }
+
+        if (!word.empty())
+        {
+            ++out[word];
+            ++count;
+            word.clear();
+        }
+    }
+}
+
+void TextIndex::terms(const std::string& text, std::vector<std::string>& out) const
+{
+    TermCounts counts;
+    uint32_t count = 0;
+    tokenize(text.data(), text.size(), counts, count);
+
+    for (TermCounts::const_iterator iter = counts.begin() ; iter != counts.end() ; ++iter)
+        out.push_back(iter->first);
+}
+
+void TextIndex::append(Postings& list, uint32_t doc, uint32_t tf)
+{
+    put_varint(list.data, list.data.empty() ? doc : doc - list.last);
+    put_varint(list.data, tf);
+    list.last = doc;
+}
+
+void TextIndex::add(int64_t key, const JsValue& val)
+{
+    Collector words(*this);
+    val.emit(words);
+    if (words.counts.empty())
+        return;
+
+    const uint32_t doc = m_docs.size();
+    Doc d = { key, words.length, true };
+    m_docs.push_back(d);
+    m_doc_of[key] = doc;
+    ++m_live;
+    m_total_length += words.length;
+
+    for (TermCounts::const_iterator iter = words.counts.begin() ; iter != words.counts.end() ; ++iter)
+        append(m_terms[iter->first], doc, iter->second);
+}
+
+void TextIndex::remove(int64_t key, const JsValue&)
+{
+    boost::unordered_map<int64_t, uint32_t>::iterator iter = m_doc_of.find(key);
+    if (iter == m_doc_of.end())
+        return;
+
+    Doc& d = m_docs[iter->second];
+    d.live = false;
+    --m_live;
+    m_total_length -= d.length;
+    m_doc_of.erase(iter);
+
+    const size_t dead = m_docs.size() - m_live;
+    if (dead > 1024 && dead > m_live)
+        compact();
+}
+
+void TextIndex::compact()
+{
+    std::vector<uint32_t> renumber(m_docs.size());
+    std::vector<Doc> docs;
+    docs.reserve(m_live);
+    for (uint32_t i=0 ; i<m_docs.size() ; ++i)
+    {
+        if (!m_docs[i].live)
+            continue;
+        renumber[i] = docs.size();
+        m_doc_of[m_docs[i].key] = docs.size();
+        docs.push_back(m_docs[i]);
+    }
+
+    TermMap::iterator iter = m_terms.begin();
+    while (iter != m_terms.end())
+    {
+        Postings kept;
+        const uint8_t* p = iter->second.data.empty() ? 0 : &iter->second.data[0];
+        const uint8_t* end = p + iter->second.data.size();
+        uint32_t doc = 0;
+        for (bool first = true ; p < end ; first = false)
+        {
+            doc = first ? get_varint(p) : doc + get_varint(p);
+            const uint32_t tf = get_varint(p);
+            if (m_docs[doc].live)
+                append(kept, renumber[doc], tf);
+        }
+
+        if (kept.data.empty())
+        {
+            iter = m_terms.erase(iter);
+            continue;
+        }
+
+        iter->second.data.swap(kept.data);
+        iter->second.last = kept.last;
+        ++iter;
+    }
+
+    m_docs.swap(docs);
+}
+
+std::vector<TextIndex::Hit> TextIndex::search(const std::vector<std::string>& terms, size_t limit) const
+{
+    std::vector<Hit> out;
+    if (!m_live || !limit)
+        return out;
+
+    const double avg_length = double(m_total_length) / m_live;
+    boost::unordered_map<uint32_t, double> scores;
+
+    std::vector<std::pair<uint32_t, uint32_t> > hits;
+    for (size_t t=0 ; t<terms.size() ; ++t)
+    {
+        TermMap::const_iterator list = m_terms.find(terms[t]);
+        if (list == m_terms.end())
+            continue;
+
+        // the document frequency counts live documents only, so the list
+        // is decoded before any of it is scored
+        hits.clear();
+        const uint8_t* p = &list->second.data[0];
+        const uint8_t* end = p + list->second.data.size();
+        uint32_t doc = 0;
+        for (bool first = true ; p < end ; first = false)
+        {
+            doc = first ? get_varint(p) : doc + get_varint(p);
+            const uint32_t tf = get_varint(p);
+            if (m_docs[doc].live)
+                hits.push_back(std::make_pair(doc, tf));
+        }
+
+        const double df = hits.size();
+        const double idf = std::log(1 + (m_live - df + 0.5) / (df + 0.5));
+        for (size_t i=0 ; i<hits.size() ; ++i)
+        {
+            const double tf = hits[i].second;
+            const double norm = 1 - kB + kB * m_docs[hits[i].first].length / avg_length;
+            scores[hits[i].first] += idf * tf * (kK1 + 1) / (tf + kK1 * norm);
+        }
+    }
+
+    out.reserve(scores.size());
+    boost::unordered_map<uint32_t, double>::const_iterator iter = scores.begin();
+    for (; iter != scores.end() ; ++iter)
+    {
+        Hit h = { m_docs[iter->first].key, iter->second };
+        out.push_back(h);
+    }
+
+    if (out.size() > limit)
+    {
+        std::partial_sort(out.begin(), out.begin() + limit, out.end(), by_score);
+        out.resize(limit);
+    }
+    else
+    {
+        std::sort(out.begin(), out.end(), by_score);
+    }
+    return out;
+}
+
+void TextIndex::clear()
+{
+    m_terms.clear();
+    m_docs.clear();
+    m_doc_of.clear();
+    m_live = 0;
+    m_total_length = 0;
+}
+
+size_t TextIndex::bytes() const
+{
+    size_t out = sizeof(*this) + m_docs.capacity() * sizeof(Doc)
+        + m_doc_of.size() * (sizeof(std::pair<int64_t, uint32_t>) + 2 * sizeof(void*))
+        + (m_terms.bucket_count() + m_doc_of.bucket_count()) * sizeof(void*);
+
+    TermMap::const_iterator iter = m_terms.begin();
+    for (; iter != m_terms.end() ; ++iter)
+    {
+        out += sizeof(TermMap::value_type) + 2 * sizeof(void*) + iter->first.capacity()
+            + iter->second.data.capacity();
+    }
+    return out;
+}
+
+} // namespace bypass
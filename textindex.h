@@ -0,0 +1,98 @@
+#ifndef BYPASS_TEXTINDEX_H
+#define BYPASS_TEXTINDEX_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+
+#include "index.h"
+
+namespace bypass {
+
+/// inverted index over the words in the string members of values
+/// every key set is a new document numbered after all others, so posting
+/// lists only ever grow at the end and are kept as varint (doc delta,
+/// term frequency) pairs. removed documents are only marked dead and
+/// skipped until they outnumber the live ones, then the lists are
+/// rebuilt without them. search ranks the live documents by BM25
+class TextIndex : public StoreIndex
+{
+public:
+    enum Tokenizer
+    {
+        /// runs of ascii letters and digits lowercased, bytes past ascii
+        /// are kept as part of a word
+        SIMPLE,
+
+        /// anything between whitespace as is
+        WHITESPACE
+    };
+
+    struct Hit
+    {
+        int64_t key;
+        double score;
+    };
+
+private:
+    struct Postings
+    {
+        std::vector<uint8_t> data;
+        uint32_t last;
+    };
+
+    struct Doc
+    {
+        int64_t key;
+        uint32_t length;
+        bool live;
+    };
+
+    typedef boost::unordered_map<std::string, Postings> TermMap;
+    typedef std::map<std::string, uint32_t> TermCounts;
+
+    class Collector;
+
+    std::vector<FieldPath> m_paths;
+    Tokenizer m_tokenizer;
+
+    TermMap m_terms;
+    std::vector<Doc> m_docs;
+    boost::unordered_map<int64_t, uint32_t> m_doc_of;
+    uint32_t m_live;
+    uint64_t m_total_length;
+
+    void tokenize(const char* data, size_t length, TermCounts& out, uint32_t& count) const;
+
+    static void append(Postings& list, uint32_t doc, uint32_t tf);
+
+    /// drop dead documents from every list and renumber the live ones
+    void compact();
+
+public:
+    TextIndex(const std::vector<FieldPath>& paths, Tokenizer tokenizer);
+
+    /// parse a tokenizer name, false if unknown
+    static bool tokenizer(const std::string& name, Tokenizer& out);
+
+    /// words of a query string as the index sees them
+    void terms(const std::string& text, std::vector<std::string>& out) const;
+
+    /// up to limit live documents containing any of terms, best first
+    std::vector<Hit> search(const std::vector<std::string>& terms, size_t limit) const;
+
+    uint32_t documents() const { return m_live; }
+
+    virtual void add(int64_t key, const JsValue& val);
+    virtual void remove(int64_t key, const JsValue& val);
+    virtual void clear();
+    virtual size_t bytes() const;
+};
+
+} // namespace bypass
+
+#endif
@@ -0,0 +1,206 @@
+#include <limits>
+#include <cstring>
+
+#include "timeseries.h"
+
+namespace bypass {
+
+/// sequential decoder over the stream
+class JsTimeSeries::Cursor
+{
+    BitReader m_in;
+    uint32_t m_left;
+    bool m_first;
+    int64_t m_ts;
+    int64_t m_delta;
+    uint64_t m_val;
+    unsigned m_lead;
+    unsigned m_trail;
+
+public:
+    Cursor(const JsTimeSeries& series)
+        : m_in(series.m_stream.words())
+        , m_left(series.m_count)
+        , m_first(true)
+        , m_ts(0)
+        , m_delta(0)
+        , m_val(0)
+        , m_lead(0)
+        , m_trail(0)
+    {}
+
+    bool next(int64_t& ts, double& val)
+    {
+        if (m_left == 0)
+            return false;
+        --m_left;
+
+        if (m_first)
+        {
+            m_first = false;
+            m_ts = int64_t(m_in.read(64));
+            m_val = m_in.read(64);
+        }
+        else
+        {
+            int64_t dod;
+            if (m_in.read(1) == 0)
+                dod = 0;
+            else if (m_in.read(1) == 0)
+                dod = int64_t(m_in.read(7)) - 63;
+            else if (m_in.read(1) == 0)
+                dod = int64_t(m_in.read(9)) - 255;
+            else if (m_in.read(1) == 0)
+                dod = int64_t(m_in.read(12)) - 2047;
+            else
+                dod = int64_t(m_in.read(64));
+
+            m_delta += dod;
+            m_ts += m_delta;
+
+            if (m_in.read(1) == 1)
+            {
+                if (m_in.read(1) == 1)
+                {
+                    m_lead = unsigned(m_in.read(5));
+                    const unsigned sig = unsigned(m_in.read(6)) + 1;
+                    m_trail = 64 - m_lead - sig;
+                }
+                const unsigned sig = 64 - m_lead - m_trail;
+                m_val ^= m_in.read(sig) << m_trail;
+            }
+        }
+
+        ts = m_ts;
+        memcpy(&val, &m_val, sizeof(val));
+        return true;
+    }
+};
+
+JsTimeSeries::JsTimeSeries()
+    : m_count(0)
+    , m_last_ts(0)
+    , m_last_delta(0)
+    , m_last_val(0)
+    , m_lead(0)
+    , m_trail(0)
+    , m_window(false)
+{}
+
+void JsTimeSeries::append(int64_t ts, double val)
+{
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+
+    if (m_count++ == 0)
+    {
+        m_stream.write(uint64_t(ts), 64);
+        m_stream.write(bits, 64);
+        m_last_ts = ts;
+        m_last_val = bits;
+        return;
+    }
+
+    const int64_t delta = ts - m_last_ts;
+    const int64_t dod = delta - m_last_delta;
+    if (dod == 0)
+    {
+        m_stream.write(0, 1);
+    }
+    else if (dod >= -63 && dod <= 64)
+    {
+        m_stream.write(2, 2);
+        m_stream.write(uint64_t(dod + 63), 7);
+    }
+    else if (dod >= -255 && dod <= 256)
+    {
+        m_stream.write(6, 3);
+        m_stream.write(uint64_t(dod + 255), 9);
+    }
+    else if (dod >= -2047 && dod <= 2048)
+    {
+        m_stream.write(14, 4);
+        m_stream.write(uint64_t(dod + 2047), 12);
+    }
+    else
+    {
+        m_stream.write(15, 4);
+        m_stream.write(uint64_t(dod), 64);
+    }
+
+    m_last_delta = delta;
+    m_last_ts = ts;
+
+    const uint64_t x = bits ^ m_last_val;
+    m_last_val = bits;
+    if (x == 0)
+    {
+        m_stream.write(0, 1);
+        return;
+    }
+
+    unsigned lead = __builtin_clzll(x);
+    const unsigned trail = __builtin_ctzll(x);
+    if (lead > 31)
+        lead = 31;
+
+    // reuse the previous window when the meaningful bits fit inside it
+    if (m_window && lead >= m_lead && trail >= m_trail)
+    {
+        m_stream.write(2, 2);
+        m_stream.write(x >> m_trail, 64 - m_lead - m_trail);
+        return;
+    }
+
+    const unsigned sig = 64 - lead - trail;
+    m_stream.write(3, 2);
+    m_stream.write(lead, 5);
+    m_stream.write(sig - 1, 6);
+    m_stream.write(x >> trail, sig);
+
+    m_lead = lead;
+    m_trail = trail;
+    m_window = true;
+}
+
+void JsTimeSeries::flatten(ValueSink& out, const std::vector<int64_t>& ts,
+                           const std::vector<double>& vals)
+{
+    const size_t size = ts.size();
+    out.begin_array(size * 2);
+    for (size_t i=0 ; i<size ; ++i)
+        out.number(double(ts[i]));
+    for (size_t i=0 ; i<size ; ++i)
+        out.number(vals[i]);
+    out.end_array();
+}
+
+void JsTimeSeries::range(int64_t from, int64_t to, ValueSink& out) const
+{
+    std::vector<int64_t> ts;
+    std::vector<double> vals;
+
+    Cursor cur(*this);
+    int64_t t;
+    double v;
+    while (cur.next(t, v))
+    {
+        // timestamps never decrease so nothing after this can match
+        if (t > to)
+            break;
+        if (t < from)
+            continue;
+
+        ts.push_back(t);
+        vals.push_back(v);
+    }
+
+    flatten(out, ts, vals);
+}
+
+void JsTimeSeries::emit(ValueSink& out) const
+{
+    range(std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), out);
+}
+
+} // namespace bypass
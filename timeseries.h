@@ -0,0 +1,126 @@
+#ifndef BYPASS_TIMESERIES_H
+#define BYPASS_TIMESERIES_H
+
+#include <vector>
+
+#include <stdint.h>
+
+#include "value.h"
+
+namespace bypass {
+
+/// append-only stream of bits packed msb first into 64 bit words
+class BitWriter
+{
+    std::vector<uint64_t> m_words;
+    uint64_t m_bits;
+
+public:
+    BitWriter()
+        : m_bits(0)
+    {}
+
+    /// write the low n bits of v, 1 <= n <= 64
+    void write(uint64_t v, unsigned n)
+    {
+        if (n < 64)
+            v &= (uint64_t(1) << n) - 1;
+
+        const unsigned used = m_bits & 63;
+        if (used == 0)
+            m_words.push_back(0);
+
+        const unsigned room = 64 - used;
+        if (n <= room)
+        {
+            m_words.back() |= v << (room - n);
+        }
+        else
+        {
+            m_words.back() |= v >> (n - room);
+            m_words.push_back(v << (64 - (n - room)));
+        }
+
+        m_bits += n;
+    }
+
+    uint64_t bits() const { return m_bits; }
+    const std::vector<uint64_t>& words() const { return m_words; }
+};
+
+class BitReader
+{
+    const std::vector<uint64_t>& m_words;
+    uint64_t m_pos;
+
+public:
+    BitReader(const std::vector<uint64_t>& words)
+        : m_words(words)
+        , m_pos(0)
+    {}
+
+    /// read the next n bits, 1 <= n <= 64
+    uint64_t read(unsigned n)
+    {
+        const size_t w = m_pos >> 6;
+        const unsigned used = m_pos & 63;
+        const unsigned room = 64 - used;
+
+        uint64_t out = (m_words[w] << used) >> (64 - n);
+        if (n > room)
+            out |= m_words[w + 1] >> (64 - (n - room));
+
+        m_pos += n;
+        return out;
+    }
+};
+
+/// numeric time series stored gorilla style
+/// timestamps are delta-of-delta encoded and values are xor'ed against
+/// their predecessor, both interleaved in a single bit stream
+/// emits the flat [timestamps..., values...] layout
+class JsTimeSeries : public JsValue
+{
+    BitWriter m_stream;
+    uint32_t m_count;
+
+    // encoder state so appends never touch existing points
+    int64_t m_last_ts;
+    int64_t m_last_delta;
+    uint64_t m_last_val;
+    unsigned m_lead;
+    unsigned m_trail;
+    bool m_window;
+
+    class Cursor;
+
+    static void flatten(ValueSink& out, const std::vector<int64_t>& ts,
+                        const std::vector<double>& vals);
+
+public:
+    virtual Kind kind() const { return KIND_SERIES; }
+
+    JsTimeSeries();
+
+    uint32_t size() const { return m_count; }
+    int64_t last_timestamp() const { return m_last_ts; }
+
+    /// add a point to the end of the series
+    /// caller guarantees ts is not older than last_timestamp()
+    void append(int64_t ts, double val);
+
+    /// decode only the points with from <= ts <= to
+    void range(int64_t from, int64_t to, ValueSink& out) const;
+
+    virtual void emit(ValueSink& out) const;
+
+    virtual void measure(Footprint& out) const
+    {
+        out.bytes += sizeof(*this) + m_stream.words().capacity() * sizeof(uint64_t);
+        ++out.nodes;
+    }
+};
+
+} // namespace bypass
+
+#endif
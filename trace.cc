@@ -0,0 +1,134 @@
+#include <cstring>
+
+#include "trace.h"
+
+namespace bypass {
+
+const char TraceWriter::kMagic[8] = { 'B', 'Y', 'P', 'T', 'R', 'C', '1', '\n' };
+
+TraceWriter::TraceWriter()
+    : m_file(0)
+    , m_buff(64 * 1024)
+    , m_used(0)
+    , m_last(0)
+    , m_records(0)
+{}
+
+TraceWriter::~TraceWriter()
+{
+    close();
+}
+
+bool TraceWriter::open(const std::string& path, uint64_t now_ns)
+{
+    close();
+
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file)
+        return false;
+
+    fwrite(kMagic, 1, sizeof(kMagic), m_file);
+    m_path = path;
+    m_used = 0;
+    m_last = now_ns;
+    m_records = 0;
+    return true;
+}
+
+void TraceWriter::flush()
+{
+    if (m_file && m_used)
+        fwrite(&m_buff[0], 1, m_used, m_file);
+    m_used = 0;
+}
+
+void TraceWriter::close()
+{
+    if (!m_file)
+        return;
+
+    flush();
+    fclose(m_file);
+    m_file = 0;
+}
+
+TraceReader::TraceReader()
+    : m_file(0)
+    , m_time(0)
+{}
+
+TraceReader::~TraceReader()
+{
+    if (m_file)
+        fclose(m_file);
+}
+
+bool TraceReader::open(const std::string& path)
+{
+    m_file = fopen(path.c_str(), "rb");
+    if (!m_file)
+        return false;
+
+    char magic[sizeof(TraceWriter::kMagic)];
+    if (fread(magic, 1, sizeof(magic), m_file) != sizeof(magic)
+        || memcmp(magic, TraceWriter::kMagic, sizeof(magic)) != 0)
+    {
+        fclose(m_file);
+        m_file = 0;
+        return false;
+    }
+
+    m_time = 0;
+    return true;
+}
+
+bool TraceReader::get_varint(uint64_t& v)
+{
+    v = 0;
+    for (unsigned shift=0 ; shift<64 ; shift+=7)
+    {
+        const int c = getc(m_file);
+        if (c == EOF)
+            return false;
+
+        v |= uint64_t(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+bool TraceReader::next(TraceRecord& out)
+{
+    if (!m_file)
+        return false;
+
+    const int op = getc(m_file);
+    if (op == EOF)
+        return false;
+
+    uint64_t delta;
+    if (!get_varint(delta))
+        return false;
+
+    unsigned char key[8];
+    if (fread(key, 1, sizeof(key), m_file) != sizeof(key))
+        return false;
+
+    uint64_t bytes;
+    if (!get_varint(bytes))
+        return false;
+
+    m_time += delta;
+
+    out.op = uint8_t(op);
+    out.key = 0;
+    for (int i=7 ; i>=0 ; --i)
+        out.key = (out.key << 8) | key[i];
+    out.bytes = uint32_t(bytes);
+    out.time = m_time;
+    return true;
+}
+
+} // namespace bypass
@@ -0,0 +1,121 @@
+#ifndef BYPASS_TRACE_H
+#define BYPASS_TRACE_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace bypass {
+
+/// one operation read back from a trace
+struct TraceRecord
+{
+    // a Store::Op
+    uint8_t op;
+
+    // keys are hashed with a bijection so distinct keys stay distinct
+    uint64_t key;
+
+    // footprint of the value involved, 0 for a miss
+    uint32_t bytes;
+
+    // monotonic nanoseconds since the trace started
+    uint64_t time;
+};
+
+/// appends operations to a binary trace file
+/// the file starts with kMagic and each record is the op byte, a varint
+/// time delta in ns, the 8 byte little endian key hash and a varint size,
+/// usually 12 to 16 bytes. records are buffered and written in blocks
+class TraceWriter
+{
+    FILE* m_file;
+    std::string m_path;
+    std::vector<unsigned char> m_buff;
+    size_t m_used;
+    uint64_t m_last;
+    uint64_t m_records;
+
+    void put_varint(uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            m_buff[m_used++] = (unsigned char)(v | 0x80);
+            v >>= 7;
+        }
+        m_buff[m_used++] = (unsigned char)v;
+    }
+
+    void flush();
+
+public:
+    static const char kMagic[8];
+
+    TraceWriter();
+    ~TraceWriter();
+
+    /// false if the file cannot be created
+    bool open(const std::string& path, uint64_t now_ns);
+
+    void record(uint8_t op, int64_t key, size_t bytes, uint64_t now_ns)
+    {
+        // longest record is 1 + 10 + 8 + 10 bytes
+        if (m_used + 29 > m_buff.size())
+            flush();
+
+        m_buff[m_used++] = op;
+        put_varint(now_ns - m_last);
+        m_last = now_ns;
+
+        uint64_t h = hash(key);
+        for (int i=0 ; i<8 ; ++i, h >>= 8)
+            m_buff[m_used++] = (unsigned char)h;
+
+        put_varint(bytes);
+        ++m_records;
+    }
+
+    /// writes out anything buffered and closes the file
+    void close();
+
+    const std::string& path() const { return m_path; }
+    uint64_t records() const { return m_records; }
+
+    /// splitmix64 finalizer, a bijection on 64 bit keys
+    static uint64_t hash(int64_t key)
+    {
+        uint64_t h = uint64_t(key);
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ull;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebull;
+        h ^= h >> 31;
+        return h;
+    }
+};
+
+/// reads a trace written by TraceWriter
+class TraceReader
+{
+    FILE* m_file;
+    uint64_t m_time;
+
+    bool get_varint(uint64_t& v);
+
+public:
+    TraceReader();
+    ~TraceReader();
+
+    /// false if the file cannot be read or is not a trace
+    bool open(const std::string& path);
+
+    /// false at the end of the trace or on a truncated record
+    bool next(TraceRecord& out);
+};
+
+} // namespace bypass
+
+#endif
@@ -0,0 +1,616 @@
+#include <cstring>
+
+#include "value.h"
+
+using namespace boost;
+
+namespace bypass {
+
+const char* JsValue::kind_name(Kind kind)
+{
+    switch (kind)
+    {
+    case KIND_UNDEFINED: return "undefined";
+    case KIND_NUMBER: return "number";
+    case KIND_STRING: return "string";
+    case KIND_ARRAY: return "array";
+    case KIND_OBJECT: return "object";
+    case KIND_RECORD: return "record";
+    case KIND_SERIES: return "series";
+    case KIND_HASH: return "hash";
+    case KIND_ZSET: return "zset";
+    case KIND_BITMAP: return "bitmap";
+    case KIND_HLL: return "hll";
+    case KIND_COUNTMIN: return "countmin";
+    case KIND_COUNT: break;
+    }
+
+    return "unknown";
+}
+
+bool ValueSource::matches(const RecordLayout& layout)
+{
+    const std::vector<RecordLayout::Field>& fields = layout.fields();
+    if (size() != fields.size())
+        return false;
+
+    for (uint32_t i=0 ; i<fields.size() ; ++i)
+    {
+        if (key(i) != fields[i].name)
+            return false;
+    }
+
+    return true;
+}
+
+void ValueSink::key(const RecordLayout& layout, uint32_t field)
+{
+    const std::string& name = layout.fields()[field].name;
+    key(name.data(), name.size());
+}
+
+shared_ptr<JsValue> JsString::encode(ValueSource& in)
+{
+    shared_ptr<JsString> s(new JsString());
+
+    s->m_size = in.string_length();
+    s->m_buff = new char[s->m_size];
+    in.string_write(s->m_buff);
+
+    return s;
+}
+
+shared_ptr<JsValue> JsArray::encode(ValueSource& in)
+{
+    shared_ptr<JsArray> out(new JsArray());
+
+    // elements of an array tend to share a shape
+    shared_ptr<const RecordLayout> hint;
+
+    const uint32_t length = in.size();
+    out->m_vals.reserve(length);
+    for (uint32_t i=0 ; i<length ; ++i)
+    {
+        in.enter(i);
+        out->m_vals.push_back(bypass::encode(in, hint));
+        in.leave();
+    }
+
+    return out;
+}
+
+void JsArray::emit(ValueSink& out) const
+{
+    const size_t size = m_vals.size();
+    out.begin_array(size);
+
+    for (size_t i=0 ; i<size ; ++i)
+    {
+        const shared_ptr<JsValue>& val = m_vals[i];
+        if (val)
+            val->emit(out);
+        else
+            out.undefined();
+    }
+
+    out.end_array();
+}
+
+class JsArray::Members : public JsValue::Walk
+{
+    const JsArray& m_array;
+    size_t m_next;
+
+public:
+    Members(const JsArray& array)
+        : m_array(array)
+        , m_next(0)
+    {}
+
+    virtual bool next(ValueSink& out, const JsValue*& child)
+    {
+        if (m_next == m_array.m_vals.size())
+        {
+            out.end_array();
+            return false;
+        }
+
+        child = m_array.m_vals[m_next++].get();
+        if (!child)
+            out.undefined();
+        return true;
+    }
+};
+
+JsValue::Walk* JsArray::walk(ValueSink& out) const
+{
+    out.begin_array(m_vals.size());
+    return new Members(*this);
+}
+
+void JsArray::measure(Footprint& out) const
+{
+    out.bytes += sizeof(*this) + m_vals.capacity() * sizeof(m_vals[0]);
+    ++out.nodes;
+
+    for (size_t i=0 ; i<m_vals.size() ; ++i)
+    {
+        if (m_vals[i])
+            m_vals[i]->measure(out);
+    }
+}
+
+shared_ptr<JsValue> JsObj::encode(ValueSource& in)
+{
+    shared_ptr<JsObj> out(new JsObj());
+
+    const uint32_t length = in.size();
+    for (uint32_t i=0 ; i<length ; ++i)
+    {
+        const std::string k = in.key(i);
+
+        in.enter(i);
+        out->m_values[k] = bypass::encode(in);
+        in.leave();
+    }
+
+    return out;
+}
+
+void JsObj::emit(ValueSink& out) const
+{
+    out.begin_object(m_values.size());
+
+    MemberMap::const_iterator iter = m_values.begin();
+    for (; iter != m_values.end() ; ++iter)
+    {
+        out.key(iter->first.data(), iter->first.size());
+
+        const shared_ptr<JsValue>& val = iter->second;
+        if (val)
+            val->emit(out);
+        else
+            out.undefined();
+    }
+
+    out.end_object();
+}
+
+class JsObj::Members : public JsValue::Walk
+{
+    const JsObj& m_obj;
+    MemberMap::const_iterator m_iter;
+
+public:
+    Members(const JsObj& obj)
+        : m_obj(obj)
+        , m_iter(obj.m_values.begin())
+    {}
+
+    virtual bool next(ValueSink& out, const JsValue*& child)
+    {
+        if (m_iter == m_obj.m_values.end())
+        {
+            out.end_object();
+            return false;
+        }
+
+        out.key(m_iter->first.data(), m_iter->first.size());
+        child = m_iter->second.get();
+        if (!child)
+            out.undefined();
+        ++m_iter;
+        return true;
+    }
+};
+
+JsValue::Walk* JsObj::walk(ValueSink& out) const
+{
+    out.begin_object(m_values.size());
+    return new Members(*this);
+}
+
+void JsObj::measure(Footprint& out) const
+{
+    out.bytes += sizeof(*this);
+    ++out.nodes;
+
+    MemberMap::const_iterator iter = m_values.begin();
+    for (; iter != m_values.end() ; ++iter)
+    {
+        // tree node plus the key
+        out.bytes += sizeof(*iter) + 4 * sizeof(void*) + iter->first.capacity();
+        if (iter->second)
+            iter->second->measure(out);
+    }
+}
+
+RecordLayout::RecordLayout()
+    : m_fixed(0)
+    , m_children(0)
+{
+    static uint32_t next_id = 0;
+    m_id = next_id++;
+}
+
+shared_ptr<RecordLayout> RecordLayout::create()
+{
+    return shared_ptr<RecordLayout>(new RecordLayout());
+}
+
+shared_ptr<RecordLayout> RecordLayout::compile(ValueSource& in)
+{
+    shared_ptr<RecordLayout> out(new RecordLayout());
+
+    const uint32_t length = in.size();
+    for (uint32_t i=0 ; i<length ; ++i)
+    {
+        const std::string k = in.key(i);
+
+        in.enter(i);
+        out->add(k, kind_of(in.type()));
+        in.leave();
+    }
+
+    return out;
+}
+
+RecordLayout::Kind RecordLayout::kind_of(ValueSource::Type type)
+{
+    if (type == ValueSource::NUMBER || type == ValueSource::INT32)
+        return NUMBER;
+    if (type == ValueSource::STRING)
+        return STRING;
+    return VALUE;
+}
+
+void RecordLayout::add(const std::string& name, Kind kind)
+{
+    Field f;
+    f.name = name;
+    f.kind = kind;
+    if (kind == VALUE)
+    {
+        f.offset = m_children++;
+    }
+    else
+    {
+        f.offset = m_fixed;
+        m_fixed += 8;
+    }
+    m_fields.push_back(f);
+}
+
+shared_ptr<JsValue> RecordLayout::encode(ValueSource& in) const
+{
+    if (in.type() != ValueSource::OBJECT)
+        return shared_ptr<JsValue>();
+
+    // undeclared properties would be lost, leave those to the generic path
+    if (in.size() != m_fields.size())
+        return shared_ptr<JsValue>();
+
+    return encode_fields(in);
+}
+
+shared_ptr<JsValue> RecordLayout::encode_fields(ValueSource& in) const
+{
+    // first pass checks types and sizes the string heap
+    size_t size = m_fixed;
+    for (uint32_t i=0 ; i<m_fields.size() ; ++i)
+    {
+        const Field& f = m_fields[i];
+        if (f.kind == VALUE)
+            continue;
+
+        in.enter(*this, i);
+        const ValueSource::Type type = in.type();
+        if (kind_of(type) != f.kind)
+        {
+            in.leave();
+            return shared_ptr<JsValue>();
+        }
+        if (f.kind == STRING)
+            size += in.string_length();
+        in.leave();
+    }
+
+    char* buff = new char[size];
+    uint32_t heap = m_fixed;
+    std::vector<shared_ptr<JsValue> > children(m_children);
+    for (uint32_t i=0 ; i<m_fields.size() ; ++i)
+    {
+        const Field& f = m_fields[i];
+
+        in.enter(*this, i);
+        if (f.kind == NUMBER)
+        {
+            const double d = in.number();
+            memcpy(buff + f.offset, &d, sizeof(d));
+        }
+        else if (f.kind == STRING)
+        {
+            uint32_t pos[2] = { heap, uint32_t(in.string_length()) };
+            in.string_write(buff + heap);
+            memcpy(buff + f.offset, pos, sizeof(pos));
+            heap += pos[1];
+        }
+        else
+        {
+            children[f.offset] = bypass::encode(in, f.hint);
+        }
+        in.leave();
+    }
+
+    return shared_ptr<JsValue>(new JsRecord(shared_from_this(), buff, children));
+}
+
+void JsRecord::emit(ValueSink& out) const
+{
+    const std::vector<RecordLayout::Field>& fields = m_layout->fields();
+    out.begin_object(fields.size());
+
+    for (uint32_t i=0 ; i<fields.size() ; ++i)
+    {
+        const RecordLayout::Field& f = fields[i];
+        out.key(*m_layout, i);
+
+        if (f.kind == RecordLayout::NUMBER)
+        {
+            double d;
+            memcpy(&d, m_buff + f.offset, sizeof(d));
+            out.number(d);
+        }
+        else if (f.kind == RecordLayout::STRING)
+        {
+            uint32_t pos[2];
+            memcpy(pos, m_buff + f.offset, sizeof(pos));
+            out.string(m_buff + pos[0], pos[1]);
+        }
+        else
+        {
+            const shared_ptr<JsValue>& val = m_children[f.offset];
+            if (val)
+                val->emit(out);
+            else
+                out.undefined();
+        }
+    }
+
+    out.end_object();
+}
+
+class JsRecord::Members : public JsValue::Walk
+{
+    const JsRecord& m_record;
+    uint32_t m_next;
+
+public:
+    Members(const JsRecord& record)
+        : m_record(record)
+        , m_next(0)
+    {}
+
+    virtual bool next(ValueSink& out, const JsValue*& child)
+    {
+        const std::vector<RecordLayout::Field>& fields = m_record.m_layout->fields();
+        if (m_next == fields.size())
+        {
+            out.end_object();
+            return false;
+        }
+
+        const uint32_t i = m_next++;
+        const RecordLayout::Field& f = fields[i];
+        out.key(*m_record.m_layout, i);
+
+        // scalars live in the record itself and are emitted here
+        child = 0;
+        if (f.kind == RecordLayout::NUMBER)
+        {
+            double d;
+            memcpy(&d, m_record.m_buff + f.offset, sizeof(d));
+            out.number(d);
+        }
+        else if (f.kind == RecordLayout::STRING)
+        {
+            uint32_t pos[2];
+            memcpy(pos, m_record.m_buff + f.offset, sizeof(pos));
+            out.string(m_record.m_buff + pos[0], pos[1]);
+        }
+        else
+        {
+            child = m_record.m_children[f.offset].get();
+            if (!child)
+                out.undefined();
+        }
+        return true;
+    }
+};
+
+JsValue::Walk* JsRecord::walk(ValueSink& out) const
+{
+    out.begin_object(m_layout->fields().size());
+    return new Members(*this);
+}
+
+void JsRecord::measure(Footprint& out) const
+{
+    out.bytes += sizeof(*this) + m_layout->fixed_size()
+        + m_children.capacity() * sizeof(m_children[0]);
+    ++out.nodes;
+
+    // the string heap follows the fixed slots
+    const std::vector<RecordLayout::Field>& fields = m_layout->fields();
+    for (size_t i=0 ; i<fields.size() ; ++i)
+    {
+        if (fields[i].kind == RecordLayout::STRING)
+        {
+            uint32_t pos[2];
+            memcpy(pos, m_buff + fields[i].offset, sizeof(pos));
+            out.bytes += pos[1];
+        }
+    }
+
+    for (size_t i=0 ; i<m_children.size() ; ++i)
+    {
+        if (m_children[i])
+            m_children[i]->measure(out);
+    }
+}
+
+DecodeCursor::DecodeCursor(const shared_ptr<JsValue>& root)
+    : m_root(root)
+    , m_started(false)
+{}
+
+DecodeCursor::~DecodeCursor()
+{
+    for (size_t i=0 ; i<m_stack.size() ; ++i)
+        delete m_stack[i];
+}
+
+void DecodeCursor::descend(const JsValue& val, ValueSink& out)
+{
+    if (JsValue::Walk* w = val.walk(out))
+        m_stack.push_back(w);
+    else
+        val.emit(out);
+}
+
+bool DecodeCursor::step(ValueSink& out, size_t steps)
+{
+    if (!m_started && steps > 0)
+    {
+        m_started = true;
+        if (m_root)
+            descend(*m_root, out);
+        else
+            out.undefined();
+        --steps;
+    }
+
+    for (; steps > 0 && !m_stack.empty() ; --steps)
+    {
+        const JsValue* child = 0;
+        if (!m_stack.back()->next(out, child))
+        {
+            delete m_stack.back();
+            m_stack.pop_back();
+        }
+        else if (child)
+        {
+            descend(*child, out);
+        }
+    }
+
+    return m_started && m_stack.empty();
+}
+
+namespace {
+
+/// layouts compiled for object shapes seen by the encoder
+/// shared by all stores and keyed by member names and kinds
+class ShapeCache
+{
+    typedef std::map<std::string, shared_ptr<const RecordLayout> > LayoutMap;
+
+    // objects with more members than this are usually used as dictionaries
+    static const uint32_t kMaxFields = 64;
+
+    // stop compiling new shapes past this, they fall back to JsObj
+    static const size_t kMaxShapes = 1024;
+
+    static LayoutMap& layouts()
+    {
+        static LayoutMap map;
+        return map;
+    }
+
+public:
+    static shared_ptr<JsValue> encode(ValueSource& in, shared_ptr<const RecordLayout>& hint)
+    {
+        if (hint && in.matches(*hint))
+        {
+            shared_ptr<JsValue> out = hint->encode_fields(in);
+            if (out)
+                return out;
+        }
+
+        const uint32_t length = in.size();
+        if (length > kMaxFields)
+            return JsObj::encode(in);
+
+        std::string shape;
+        for (uint32_t i=0 ; i<length ; ++i)
+        {
+            const std::string k = in.key(i);
+
+            in.enter(i);
+            shape += char('0' + RecordLayout::kind_of(in.type()));
+            in.leave();
+
+            // names are length prefixed since they may hold any byte
+            const uint32_t size = uint32_t(k.size());
+            shape.append(reinterpret_cast<const char*>(&size), sizeof(size));
+            shape += k;
+        }
+
+        LayoutMap& map = layouts();
+        LayoutMap::iterator iter = map.find(shape);
+        if (iter == map.end())
+        {
+            if (map.size() >= kMaxShapes)
+                return JsObj::encode(in);
+
+            iter = map.insert(std::make_pair(shape, RecordLayout::compile(in))).first;
+        }
+
+        shared_ptr<JsValue> out = iter->second->encode_fields(in);
+        if (!out)
+            return JsObj::encode(in);
+
+        hint = iter->second;
+        return out;
+    }
+};
+
+} // namespace
+
+/// process the source value and return it wrapped in a JsValue object
+/// generic callout
+shared_ptr<JsValue> encode(ValueSource& in, shared_ptr<const RecordLayout>& hint)
+{
+    const ValueSource::Type type = in.type();
+
+    if (type == ValueSource::INT32)
+    {
+        return shared_ptr<JsValue>(new JsInt32(int32_t(in.number())));
+    }
+    else if (type == ValueSource::NUMBER)
+    {
+        return shared_ptr<JsValue>(new JsNumber(in.number()));
+    }
+    else if (type == ValueSource::STRING)
+    {
+        return JsString::encode(in);
+    }
+    else if (type == ValueSource::ARRAY)
+    {
+        return JsArray::encode(in);
+    }
+    else if (type == ValueSource::OBJECT)
+    {
+        return ShapeCache::encode(in, hint);
+    }
+
+    return shared_ptr<JsValue>(new JsUndefined());
+}
+
+shared_ptr<JsValue> encode(ValueSource& in)
+{
+    shared_ptr<const RecordLayout> hint;
+    return encode(in, hint);
+}
+
+} // namespace bypass
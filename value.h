@@ -0,0 +1,447 @@
+#ifndef BYPASS_VALUE_H
+#define BYPASS_VALUE_H
+
+#include <map>
+#include <vector>
+#include <string>
+
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+
+namespace bypass {
+
+class RecordLayout;
+
+/// where the encoder reads values from
+/// a source walks one value tree, exposing the current value and moving
+/// into its elements or members with enter() and back out with leave()
+class ValueSource
+{
+public:
+    enum Type
+    {
+        UNDEFINED,
+        INT32,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    virtual ~ValueSource() {}
+
+    /// type of the current value
+    virtual Type type() = 0;
+
+    /// value of a NUMBER or INT32
+    virtual double number() = 0;
+
+    /// utf8 length in bytes of a STRING
+    virtual size_t string_length() = 0;
+
+    /// copy string_length() bytes of utf8 into out
+    virtual void string_write(char* out) = 0;
+
+    /// number of elements of an ARRAY or members of an OBJECT
+    virtual uint32_t size() = 0;
+
+    /// name of the i-th member of an OBJECT
+    virtual std::string key(uint32_t i) = 0;
+
+    /// make the i-th element or member the current value
+    virtual void enter(uint32_t i) = 0;
+
+    /// make the member named by field of layout the current value
+    /// a missing member reads as UNDEFINED
+    virtual void enter(const RecordLayout& layout, uint32_t field) = 0;
+
+    /// return to the enclosing array or object
+    virtual void leave() = 0;
+
+    /// guard for compiled layouts
+    /// true if the members are exactly the layout's fields in the same order
+    virtual bool matches(const RecordLayout& layout);
+};
+
+/// where values are decoded to
+/// receives a value tree as a flat sequence of calls, containers are
+/// bracketed by begin/end and object members are preceded by their key
+class ValueSink
+{
+public:
+    virtual ~ValueSink() {}
+
+    virtual void undefined() = 0;
+    virtual void number(double val) = 0;
+    virtual void int32(int32_t val) = 0;
+    virtual void string(const char* data, size_t length) = 0;
+
+    virtual void begin_array(uint32_t size) = 0;
+    virtual void end_array() = 0;
+
+    virtual void begin_object(uint32_t size) = 0;
+    virtual void key(const char* name, size_t length) = 0;
+    virtual void end_object() = 0;
+
+    /// key of a record member, lets sinks cache per layout field
+    virtual void key(const RecordLayout& layout, uint32_t field);
+};
+
+/// memory held by a value tree
+struct Footprint
+{
+    size_t bytes;
+    size_t nodes;
+
+    Footprint()
+        : bytes(0)
+        , nodes(0)
+    {}
+};
+
+class JsValue
+{
+public:
+    /// what a stored value is, for accounting
+    enum Kind
+    {
+        KIND_UNDEFINED,
+        KIND_NUMBER,
+        KIND_STRING,
+        KIND_ARRAY,
+        KIND_OBJECT,
+        KIND_RECORD,
+        KIND_SERIES,
+        KIND_HASH,
+        KIND_ZSET,
+        KIND_BITMAP,
+        KIND_HLL,
+        KIND_COUNTMIN,
+        KIND_COUNT
+    };
+
+    static const char* kind_name(Kind kind);
+
+    virtual Kind kind() const = 0;
+
+    /// write the value to a sink
+    virtual void emit(ValueSink& out) const = 0;
+
+    /// add the memory and node count of this value and its children
+    virtual void measure(Footprint& out) const = 0;
+
+    /// one container being emitted a member at a time
+    class Walk
+    {
+    public:
+        virtual ~Walk() {}
+
+        /// emit the key of the next member if it has one and leave the
+        /// member in child for the caller to emit, or emit it here and
+        /// leave child 0. after the last member emit the end and return false
+        virtual bool next(ValueSink& out, const JsValue*& child) = 0;
+    };
+
+    /// containers emit their start and return a walk over their members,
+    /// anything else returns 0 and is emitted whole with emit()
+    virtual Walk* walk(ValueSink&) const { return 0; }
+
+    virtual ~JsValue() {}
+};
+
+/// emits a value tree a bounded number of values at a time
+/// keeps its own stack of walks so decoding can stop between any two
+/// values and resume later. holds a reference to the root so the tree
+/// stays alive even if its key is deleted or replaced meanwhile
+class DecodeCursor
+{
+    boost::shared_ptr<JsValue> m_root;
+    std::vector<JsValue::Walk*> m_stack;
+    bool m_started;
+
+    void descend(const JsValue& val, ValueSink& out);
+
+public:
+    explicit DecodeCursor(const boost::shared_ptr<JsValue>& root);
+    ~DecodeCursor();
+
+    /// emit up to steps values to out, true once the whole tree is done
+    bool step(ValueSink& out, size_t steps);
+};
+
+/// main processing method for turning a source value into cache
+boost::shared_ptr<JsValue> encode(ValueSource& in);
+
+/// same as above but tries the object layout last seen at this call site
+/// first and updates hint with the layout used
+boost::shared_ptr<JsValue> encode(ValueSource& in, boost::shared_ptr<const RecordLayout>& hint);
+
+/// when the type is not supported
+class JsUndefined : public JsValue
+{
+public:
+    virtual Kind kind() const { return KIND_UNDEFINED; }
+
+    virtual void emit(ValueSink& out) const
+    {
+        out.undefined();
+    }
+
+    virtual void measure(Footprint& out) const
+    {
+        out.bytes += sizeof(*this);
+        ++out.nodes;
+    }
+};
+
+class JsString : public JsValue
+{
+    char* m_buff;
+    size_t m_size;
+
+public:
+    virtual Kind kind() const { return KIND_STRING; }
+
+    static boost::shared_ptr<JsValue> encode(ValueSource& in);
+
+    virtual void emit(ValueSink& out) const
+    {
+        out.string(m_buff, m_size);
+    }
+
+    virtual void measure(Footprint& out) const
+    {
+        out.bytes += sizeof(*this) + m_size;
+        ++out.nodes;
+    }
+
+    JsString()
+        : m_buff(0)
+        , m_size(0)
+    {}
+
+    ~JsString()
+    {
+        if (m_buff)
+            delete[] m_buff;
+    }
+};
+
+/// double
+class JsNumber : public JsValue
+{
+    double m_val;
+
+public:
+    virtual Kind kind() const { return KIND_NUMBER; }
+
+    virtual void emit(ValueSink& out) const
+    {
+        out.number(m_val);
+    }
+
+    virtual void measure(Footprint& out) const
+    {
+        out.bytes += sizeof(*this);
+        ++out.nodes;
+    }
+
+    JsNumber(double val)
+        : m_val(val)
+    {}
+};
+
+/// int32
+class JsInt32 : public JsValue
+{
+    int32_t m_val;
+
+public:
+    virtual Kind kind() const { return KIND_NUMBER; }
+
+    virtual void emit(ValueSink& out) const
+    {
+        out.int32(m_val);
+    }
+
+    virtual void measure(Footprint& out) const
+    {
+        out.bytes += sizeof(*this);
+        ++out.nodes;
+    }
+
+    JsInt32(int32_t val)
+        : m_val(val)
+    {}
+};
+
+/// uint32
+class JsUint32 : public JsValue
+{
+    uint32_t m_val;
+
+public:
+    virtual Kind kind() const { return KIND_NUMBER; }
+
+    virtual void emit(ValueSink& out) const
+    {
+        out.number(m_val);
+    }
+
+    virtual void measure(Footprint& out) const
+    {
+        out.bytes += sizeof(*this);
+        ++out.nodes;
+    }
+
+    JsUint32(uint32_t val)
+        : m_val(val)
+    {}
+};
+
+class JsArray : public JsValue
+{
+    class Members;
+
+    // store other JsValue objects
+    std::vector<boost::shared_ptr<JsValue> > m_vals;
+
+public:
+    virtual Kind kind() const { return KIND_ARRAY; }
+
+    static boost::shared_ptr<JsValue> encode(ValueSource& in);
+
+    const std::vector<boost::shared_ptr<JsValue> >& elements() const { return m_vals; }
+
+    virtual void emit(ValueSink& out) const;
+
+    virtual void measure(Footprint& out) const;
+
+    virtual Walk* walk(ValueSink& out) const;
+};
+
+class JsObj : public JsValue
+{
+    class Members;
+
+    // values of the javascript object
+    typedef std::map<std::string, boost::shared_ptr<JsValue> > MemberMap;
+    MemberMap m_values;
+
+public:
+    virtual Kind kind() const { return KIND_OBJECT; }
+
+    static boost::shared_ptr<JsValue> encode(ValueSource& in);
+
+    virtual void emit(ValueSink& out) const;
+
+    virtual void measure(Footprint& out) const;
+
+    virtual Walk* walk(ValueSink& out) const;
+};
+
+/// fixed byte layout for objects of one shape
+/// built once either from a declared schema or the first time the encoder
+/// sees a new shape. numbers take an 8 byte slot at a fixed offset, strings
+/// an offset/length pair into the record's string heap and any other
+/// member is encoded generically into the record's child list
+class RecordLayout : public boost::enable_shared_from_this<RecordLayout>
+{
+public:
+    enum Kind
+    {
+        NUMBER,
+        STRING,
+        VALUE
+    };
+
+    struct Field
+    {
+        std::string name;
+        Kind kind;
+
+        // byte offset of the slot for NUMBER and STRING fields,
+        // position in the child list for VALUE fields
+        uint32_t offset;
+
+        // last layout seen for an object held in this field
+        mutable boost::shared_ptr<const RecordLayout> hint;
+    };
+
+private:
+    std::vector<Field> m_fields;
+    uint32_t m_fixed;
+    uint32_t m_children;
+    uint32_t m_id;
+
+    RecordLayout();
+
+public:
+    /// empty layout, fields are declared with add()
+    static boost::shared_ptr<RecordLayout> create();
+
+    /// layout for the shape of the current OBJECT of in
+    static boost::shared_ptr<RecordLayout> compile(ValueSource& in);
+
+    static Kind kind_of(ValueSource::Type type);
+
+    void add(const std::string& name, Kind kind);
+
+    const std::vector<Field>& fields() const { return m_fields; }
+
+    /// size of the fixed part of a record
+    uint32_t fixed_size() const { return m_fixed; }
+
+    /// number of generically encoded members
+    uint32_t child_count() const { return m_children; }
+
+    /// unique for the life of the process, lets sinks and sources
+    /// keep their own per layout data
+    uint32_t id() const { return m_id; }
+
+    /// encode the current value of in with a declared schema
+    /// returns an empty pointer when it does not match the schema
+    boost::shared_ptr<JsValue> encode(ValueSource& in) const;
+
+    /// run the field loads and typed writes for this layout
+    /// returns an empty pointer if a member has the wrong type
+    boost::shared_ptr<JsValue> encode_fields(ValueSource& in) const;
+};
+
+/// record stored with a RecordLayout
+class JsRecord : public JsValue
+{
+    class Members;
+
+    boost::shared_ptr<const RecordLayout> m_layout;
+    char* m_buff;
+    std::vector<boost::shared_ptr<JsValue> > m_children;
+
+public:
+    virtual Kind kind() const { return KIND_RECORD; }
+
+    JsRecord(const boost::shared_ptr<const RecordLayout>& layout, char* buff,
+             std::vector<boost::shared_ptr<JsValue> >& children)
+        : m_layout(layout)
+        , m_buff(buff)
+    {
+        m_children.swap(children);
+    }
+
+    ~JsRecord()
+    {
+        delete[] m_buff;
+    }
+
+    virtual void emit(ValueSink& out) const;
+
+    virtual void measure(Footprint& out) const;
+
+    virtual Walk* walk(ValueSink& out) const;
+};
+
+} // namespace bypass
+
+#endif
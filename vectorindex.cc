@@ -0,0 +1,383 @@
+#include <cmath>
+#include <queue>
+#include <algorithm>
+
+#include "vectorindex.h"
+
+// gcc 4.9 and clang can compile single functions for a wider instruction
+// set, the kernels below pick one at startup from what the cpu supports
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define BYPASS_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace bypass {
+
+namespace {
+
+typedef float (*Kernel)(const float* a, const float* b, size_t n);
+
+// four running sums so the loops vectorize without -ffast-math
+float dot_plain(const float* a, const float* b, size_t n)
+{
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n ; i += 4)
+    {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i<n ; ++i)
+        s0 += a[i] * b[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+float l2_plain(const float* a, const float* b, size_t n)
+{
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n ; i += 4)
+    {
+        const float d0 = a[i] - b[i];
+        const float d1 = a[i + 1] - b[i + 1];
+        const float d2 = a[i + 2] - b[i + 2];
+        const float d3 = a[i + 3] - b[i + 3];
+        s0 += d0 * d0;
+        s1 += d1 * d1;
+        s2 += d2 * d2;
+        s3 += d3 * d3;
+    }
+    for (; i<n ; ++i)
+        s0 += (a[i] - b[i]) * (a[i] - b[i]);
+    return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef BYPASS_AVX2
+__attribute__((target("avx2,fma")))
+float sum8(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+__attribute__((target("avx2,fma")))
+float dot_avx2(const float* a, const float* b, size_t n)
+{
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n ; i += 16)
+    {
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), s1);
+    }
+    for (; i + 8 <= n ; i += 8)
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+
+    float out = sum8(_mm256_add_ps(s0, s1));
+    for (; i<n ; ++i)
+        out += a[i] * b[i];
+    return out;
+}
+
+__attribute__((target("avx2,fma")))
+float l2_avx2(const float* a, const float* b, size_t n)
+{
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n ; i += 16)
+    {
+        const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        const __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        s0 = _mm256_fmadd_ps(d0, d0, s0);
+        s1 = _mm256_fmadd_ps(d1, d1, s1);
+    }
+    for (; i + 8 <= n ; i += 8)
+    {
+        const __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        s0 = _mm256_fmadd_ps(d, d, s0);
+    }
+
+    float out = sum8(_mm256_add_ps(s0, s1));
+    for (; i<n ; ++i)
+        out += (a[i] - b[i]) * (a[i] - b[i]);
+    return out;
+}
+#endif
+
+/// kernels for this cpu, picked once at load
+struct Kernels
+{
+    Kernel dot;
+    Kernel l2;
+
+    Kernels()
+        : dot(dot_plain)
+        , l2(l2_plain)
+    {
+#ifdef BYPASS_AVX2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            dot = dot_avx2;
+            l2 = l2_avx2;
+        }
+#endif
+    }
+};
+
+const Kernels g_kernels;
+
+void normalize(float* v, size_t n)
+{
+    const float len = std::sqrt(g_kernels.dot(v, v, n));
+    if (len > 0)
+    {
+        for (size_t i=0 ; i<n ; ++i)
+            v[i] /= len;
+    }
+}
+
+bool nearer(const VectorIndex::Hit& a, const VectorIndex::Hit& b)
+{
+    return a.score < b.score || (a.score == b.score && a.key < b.key);
+}
+
+} // namespace
+
+/// the numbers at the indexed path
+class VectorIndex::Collector : public PathSink
+{
+public:
+    std::vector<float> values;
+
+    Collector(const VectorIndex& index)
+        : PathSink(index.m_paths)
+    {}
+
+protected:
+    virtual void found(size_t, double val)
+    {
+        values.push_back(float(val));
+    }
+};
+
+VectorIndex::VectorIndex(const FieldPath& path, uint32_t dims, Metric metric,
+                         uint32_t graph_m, uint32_t ef_construction)
+    : m_paths(1, path)
+    , m_dims(dims)
+    , m_metric(metric)
+    , m_graph_m(graph_m)
+    , m_ef_construction(ef_construction)
+    , m_count(0)
+{
+    if (graph_m)
+        m_graph.reset(new Hnsw(*this, graph_m, ef_construction));
+}
+
+bool VectorIndex::metric(const std::string& name, Metric& out)
+{
+    if (name == "dot")
+        out = DOT;
+    else if (name == "l2")
+        out = L2;
+    else if (name == "cosine")
+        out = COSINE;
+    else
+        return false;
+    return true;
+}
+
+float VectorIndex::distance(const float* a, const float* b) const
+{
+    if (m_metric == L2)
+        return g_kernels.l2(a, b, m_dims);
+    return -g_kernels.dot(a, b, m_dims);
+}
+
+float VectorIndex::score(float distance) const
+{
+    if (m_metric == L2)
+        return std::sqrt(distance);
+    return -distance;
+}
+
+void VectorIndex::add(int64_t key, const JsValue& val)
+{
+    Collector numbers(*this);
+    val.emit(numbers);
+    if (numbers.values.size() != m_dims || !m_dims)
+        return;
+
+    if (m_metric == COSINE)
+        normalize(&numbers.values[0], m_dims);
+
+    uint32_t slot;
+    if (!m_free.empty())
+    {
+        slot = m_free.back();
+        m_free.pop_back();
+        m_keys[slot] = key;
+        m_live[slot] = true;
+        std::copy(numbers.values.begin(), numbers.values.end(), m_data.begin() + size_t(slot) * m_dims);
+    }
+    else
+    {
+        slot = m_keys.size();
+        m_keys.push_back(key);
+        m_live.push_back(true);
+        m_data.insert(m_data.end(), numbers.values.begin(), numbers.values.end());
+    }
+
+    m_slot_of[key] = slot;
+    ++m_count;
+
+    if (m_graph)
+        m_graph->insert(slot);
+}
+
+void VectorIndex::remove(int64_t key, const JsValue&)
+{
+    boost::unordered_map<int64_t, uint32_t>::iterator iter = m_slot_of.find(key);
+    if (iter == m_slot_of.end())
+        return;
+
+    const uint32_t slot = iter->second;
+    m_live[slot] = false;
+    m_slot_of.erase(iter);
+    --m_count;
+
+    if (!m_graph)
+    {
+        m_free.push_back(slot);
+        return;
+    }
+
+    const size_t dead = m_keys.size() - m_count;
+    if (!m_count)
+        clear();
+    else if (dead > 1024 && dead > m_count)
+        rebuild();
+}
+
+void VectorIndex::rebuild()
+{
+    std::vector<float> data;
+    std::vector<int64_t> keys;
+    data.reserve(size_t(m_count) * m_dims);
+    keys.reserve(m_count);
+
+    for (uint32_t i=0 ; i<m_keys.size() ; ++i)
+    {
+        if (!m_live[i])
+            continue;
+        m_slot_of[m_keys[i]] = keys.size();
+        keys.push_back(m_keys[i]);
+        data.insert(data.end(), m_data.begin() + size_t(i) * m_dims,
+                    m_data.begin() + size_t(i + 1) * m_dims);
+    }
+
+    m_data.swap(data);
+    m_keys.swap(keys);
+    m_live.assign(m_keys.size(), true);
+    m_free.clear();
+
+    m_graph.reset(new Hnsw(*this, m_graph_m, m_ef_construction));
+    for (uint32_t i=0 ; i<m_keys.size() ; ++i)
+        m_graph->insert(i);
+}
+
+void VectorIndex::clear()
+{
+    std::vector<float>().swap(m_data);
+    std::vector<int64_t>().swap(m_keys);
+    std::vector<bool>().swap(m_live);
+    std::vector<uint32_t>().swap(m_free);
+    m_slot_of.clear();
+    m_count = 0;
+    if (m_graph)
+        m_graph->clear();
+}
+
+std::vector<VectorIndex::Hit> VectorIndex::nearest(const float* query, size_t k, bool exact, size_t ef) const
+{
+    std::vector<Hit> out;
+    if (!k || !m_count)
+        return out;
+
+    std::vector<float> scaled;
+    if (m_metric == COSINE)
+    {
+        scaled.assign(query, query + m_dims);
+        normalize(&scaled[0], m_dims);
+        query = &scaled[0];
+    }
+
+    if (m_graph && !exact)
+    {
+        // widen the search by the share of dead nodes it will pass over
+        size_t want = std::max(ef, k);
+        want = want * m_keys.size() / m_count;
+
+        std::vector<Hnsw::Candidate> found;
+        m_graph->search(query, want, found);
+        for (size_t i=0 ; i<found.size() && out.size()<k ; ++i)
+        {
+            if (!m_live[found[i].second])
+                continue;
+            Hit h = { m_keys[found[i].second], score(found[i].first) };
+            out.push_back(h);
+        }
+        return out;
+    }
+
+    // keep the k nearest by distance in a heap with the farthest on top
+    std::vector<Hit> heap;
+    heap.reserve(k + 1);
+    for (uint32_t i=0 ; i<m_keys.size() ; ++i)
+    {
+        if (!m_live[i])
+            continue;
+
+        Hit h = { m_keys[i], distance(query, vector(i)) };
+        if (heap.size() < k)
+        {
+            heap.push_back(h);
+            std::push_heap(heap.begin(), heap.end(), nearer);
+        }
+        else if (nearer(h, heap.front()))
+        {
+            std::pop_heap(heap.begin(), heap.end(), nearer);
+            heap.back() = h;
+            std::push_heap(heap.begin(), heap.end(), nearer);
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end(), nearer);
+    for (size_t i=0 ; i<heap.size() ; ++i)
+        heap[i].score = score(heap[i].score);
+    out.swap(heap);
+    return out;
+}
+
+size_t VectorIndex::bytes() const
+{
+    size_t out = sizeof(*this)
+        + m_data.capacity() * sizeof(float)
+        + m_keys.capacity() * sizeof(int64_t)
+        + m_live.capacity() / 8
+        + m_free.capacity() * sizeof(uint32_t)
+        + m_slot_of.bucket_count() * sizeof(void*)
+        + m_slot_of.size() * (sizeof(int64_t) + sizeof(uint32_t) + 2 * sizeof(void*));
+    if (m_graph)
+        out += m_graph->bytes();
+    return out;
+}
+
+} // namespace bypass
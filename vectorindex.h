@@ -0,0 +1,99 @@
+#ifndef BYPASS_VECTORINDEX_H
+#define BYPASS_VECTORINDEX_H
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "index.h"
+#include "hnsw.h"
+
+namespace bypass {
+
+/// nearest neighbour index over fixed length number arrays at one path
+/// vectors are copied as floats into one contiguous block, a slot each.
+/// values without exactly dimensions numbers at the path are not indexed.
+/// queries scan every live slot, or with a graph walk an hnsw graph over
+/// the slots. removed slots are reused by the scan only index, the graph
+/// keeps them as dead nodes until they outnumber the live ones and then
+/// is rebuilt without them
+class VectorIndex : public StoreIndex, private Hnsw::Space
+{
+public:
+    enum Metric
+    {
+        /// inner product, larger is nearer
+        DOT,
+
+        /// euclidean distance, smaller is nearer
+        L2,
+
+        /// inner product of the vectors scaled to unit length
+        COSINE
+    };
+
+    struct Hit
+    {
+        int64_t key;
+        float score;
+    };
+
+private:
+    class Collector;
+
+    std::vector<FieldPath> m_paths;
+    uint32_t m_dims;
+    Metric m_metric;
+
+    // hnsw parameters, m of 0 for scan only
+    uint32_t m_graph_m;
+    uint32_t m_ef_construction;
+
+    std::vector<float> m_data;
+    std::vector<int64_t> m_keys;
+    std::vector<bool> m_live;
+    std::vector<uint32_t> m_free;
+    boost::unordered_map<int64_t, uint32_t> m_slot_of;
+    uint32_t m_count;
+
+    boost::scoped_ptr<Hnsw> m_graph;
+
+    virtual const float* vector(uint32_t slot) const { return &m_data[size_t(slot) * m_dims]; }
+    virtual float distance(const float* a, const float* b) const;
+
+    /// drop dead slots and build the graph again over the live ones
+    void rebuild();
+
+    /// score reported to callers from an internal distance
+    float score(float distance) const;
+
+public:
+    /// a graph_m of 0 leaves out the graph
+    VectorIndex(const FieldPath& path, uint32_t dims, Metric metric,
+                uint32_t graph_m, uint32_t ef_construction);
+
+    /// parse a metric name, false if unknown
+    static bool metric(const std::string& name, Metric& out);
+
+    uint32_t dimensions() const { return m_dims; }
+    uint32_t vectors() const { return m_count; }
+    bool has_graph() const { return m_graph.get() != 0; }
+
+    /// up to k live vectors nearest to query, nearest first
+    /// the graph is searched with ef candidates when there is one and exact
+    /// is false, otherwise every vector is compared
+    std::vector<Hit> nearest(const float* query, size_t k, bool exact, size_t ef) const;
+
+    virtual void add(int64_t key, const JsValue& val);
+    virtual void remove(int64_t key, const JsValue& val);
+    virtual void clear();
+    virtual size_t bytes() const;
+};
+
+} // namespace bypass
+
+#endif
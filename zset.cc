@@ -0,0 +1,324 @@
+#include <new>
+
+#include "zset.h"
+
+namespace bypass {
+
+namespace {
+
+/// true if a node with score a and member am orders before b, bm
+inline bool before(double a, const std::string& am, double b, const std::string& bm)
+{
+    return a < b || (a == b && am < bm);
+}
+
+} // namespace
+
+JsSortedSet::Node* JsSortedSet::create(uint32_t height, double score, const std::string& member)
+{
+    void* mem = operator new(sizeof(Node) + (height - 1) * sizeof(Level));
+    Node* node = new (mem) Node();
+    node->member = member;
+    node->score = score;
+    node->backward = 0;
+    node->height = height;
+    for (uint32_t i=0 ; i<height ; ++i)
+    {
+        node->levels[i].forward = 0;
+        node->levels[i].span = 0;
+    }
+    return node;
+}
+
+void JsSortedSet::destroy(Node* node)
+{
+    node->~Node();
+    operator delete(node);
+}
+
+size_t JsSortedSet::node_bytes(const Node* node)
+{
+    return sizeof(Node) + (node->height - 1) * sizeof(Level) + node->member.capacity();
+}
+
+size_t JsSortedSet::entry_bytes(const std::string& member)
+{
+    // bucket chain link and hash alongside the pair
+    return sizeof(ScoreMap::value_type) + 2 * sizeof(void*) + member.capacity();
+}
+
+JsSortedSet::JsSortedSet()
+    : m_head(create(kMaxHeight, 0, std::string()))
+    , m_tail(0)
+    , m_height(1)
+    , m_length(0)
+    , m_bytes(0)
+    , m_seed(0x9e3779b97f4a7c15ull)
+{}
+
+JsSortedSet::JsSortedSet(const JsSortedSet& other)
+    : JsValue()
+    , m_head(create(kMaxHeight, 0, std::string()))
+    , m_tail(0)
+    , m_height(1)
+    , m_length(0)
+    , m_bytes(0)
+    , m_seed(other.m_seed)
+{
+    for (const Node* n = other.m_head->levels[0].forward ; n ; n = n->levels[0].forward)
+        add(n->member, n->score);
+}
+
+JsSortedSet::~JsSortedSet()
+{
+    Node* n = m_head;
+    while (n)
+    {
+        Node* next = n->levels[0].forward;
+        destroy(n);
+        n = next;
+    }
+}
+
+uint32_t JsSortedSet::random_height()
+{
+    // xorshift, each level is kept with probability 1/4
+    uint32_t height = 1;
+    for (;;)
+    {
+        m_seed ^= m_seed << 13;
+        m_seed ^= m_seed >> 7;
+        m_seed ^= m_seed << 17;
+        if ((m_seed & 3) != 0 || height == kMaxHeight)
+            return height;
+        ++height;
+    }
+}
+
+void JsSortedSet::insert(double score, const std::string& member)
+{
+    Node* update[kMaxHeight];
+    uint32_t rank[kMaxHeight];
+
+    Node* x = m_head;
+    for (int i=m_height - 1 ; i>=0 ; --i)
+    {
+        rank[i] = (i == int(m_height) - 1) ? 0 : rank[i + 1];
+        while (x->levels[i].forward &&
+               before(x->levels[i].forward->score, x->levels[i].forward->member, score, member))
+        {
+            rank[i] += x->levels[i].span;
+            x = x->levels[i].forward;
+        }
+        update[i] = x;
+    }
+
+    const uint32_t height = random_height();
+    if (height > m_height)
+    {
+        for (uint32_t i=m_height ; i<height ; ++i)
+        {
+            rank[i] = 0;
+            update[i] = m_head;
+            update[i]->levels[i].span = m_length;
+        }
+        m_height = height;
+    }
+
+    x = create(height, score, member);
+    for (uint32_t i=0 ; i<height ; ++i)
+    {
+        x->levels[i].forward = update[i]->levels[i].forward;
+        update[i]->levels[i].forward = x;
+
+        x->levels[i].span = update[i]->levels[i].span - (rank[0] - rank[i]);
+        update[i]->levels[i].span = (rank[0] - rank[i]) + 1;
+    }
+
+    // links above the new node now skip one more
+    for (uint32_t i=height ; i<m_height ; ++i)
+        ++update[i]->levels[i].span;
+
+    x->backward = (update[0] == m_head) ? 0 : update[0];
+    if (x->levels[0].forward)
+        x->levels[0].forward->backward = x;
+    else
+        m_tail = x;
+
+    ++m_length;
+    m_bytes += node_bytes(x);
+}
+
+void JsSortedSet::remove(double score, const std::string& member)
+{
+    Node* update[kMaxHeight];
+
+    Node* x = m_head;
+    for (int i=m_height - 1 ; i>=0 ; --i)
+    {
+        while (x->levels[i].forward &&
+               before(x->levels[i].forward->score, x->levels[i].forward->member, score, member))
+            x = x->levels[i].forward;
+        update[i] = x;
+    }
+
+    // the score map guarantees the node is there
+    x = x->levels[0].forward;
+
+    for (uint32_t i=0 ; i<m_height ; ++i)
+    {
+        if (update[i]->levels[i].forward == x)
+        {
+            update[i]->levels[i].span += x->levels[i].span - 1;
+            update[i]->levels[i].forward = x->levels[i].forward;
+        }
+        else
+        {
+            --update[i]->levels[i].span;
+        }
+    }
+
+    if (x->levels[0].forward)
+        x->levels[0].forward->backward = x->backward;
+    else
+        m_tail = x->backward;
+
+    while (m_height > 1 && !m_head->levels[m_height - 1].forward)
+        --m_height;
+
+    --m_length;
+    m_bytes -= node_bytes(x);
+    destroy(x);
+}
+
+const JsSortedSet::Node* JsSortedSet::node_at(uint32_t rank) const
+{
+    const Node* x = m_head;
+    uint32_t traversed = 0;
+    for (int i=m_height - 1 ; i>=0 ; --i)
+    {
+        while (x->levels[i].forward && traversed + x->levels[i].span <= rank)
+        {
+            traversed += x->levels[i].span;
+            x = x->levels[i].forward;
+        }
+        if (traversed == rank)
+            return x;
+    }
+    return 0;
+}
+
+bool JsSortedSet::add(const std::string& member, double score)
+{
+    ScoreMap::iterator iter = m_scores.find(member);
+    if (iter == m_scores.end())
+    {
+        m_scores.insert(std::make_pair(member, score));
+        m_bytes += entry_bytes(member);
+        insert(score, member);
+        return true;
+    }
+
+    if (iter->second != score)
+    {
+        remove(iter->second, member);
+        insert(score, member);
+        iter->second = score;
+    }
+    return false;
+}
+
+bool JsSortedSet::remove(const std::string& member)
+{
+    ScoreMap::iterator iter = m_scores.find(member);
+    if (iter == m_scores.end())
+        return false;
+
+    remove(iter->second, member);
+    m_bytes -= entry_bytes(member);
+    m_scores.erase(iter);
+    return true;
+}
+
+bool JsSortedSet::score(const std::string& member, double& out) const
+{
+    ScoreMap::const_iterator iter = m_scores.find(member);
+    if (iter == m_scores.end())
+        return false;
+
+    out = iter->second;
+    return true;
+}
+
+bool JsSortedSet::rank(const std::string& member, uint32_t& out) const
+{
+    ScoreMap::const_iterator iter = m_scores.find(member);
+    if (iter == m_scores.end())
+        return false;
+
+    const double score = iter->second;
+    const Node* x = m_head;
+    uint32_t rank = 0;
+    for (int i=m_height - 1 ; i>=0 ; --i)
+    {
+        while (x->levels[i].forward &&
+               !before(score, member, x->levels[i].forward->score, x->levels[i].forward->member))
+        {
+            rank += x->levels[i].span;
+            x = x->levels[i].forward;
+        }
+        if (x != m_head && x->member == member)
+        {
+            out = rank - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+void JsSortedSet::range(int64_t start, int64_t stop, bool with_scores, ValueSink& out) const
+{
+    const int64_t length = m_length;
+    if (start < 0)
+        start += length;
+    if (stop < 0)
+        stop += length;
+    if (start < 0)
+        start = 0;
+    if (stop >= length)
+        stop = length - 1;
+
+    if (start > stop)
+    {
+        out.begin_array(0);
+        out.end_array();
+        return;
+    }
+
+    const uint32_t count = uint32_t(stop - start + 1);
+    out.begin_array(with_scores ? 2 * count : count);
+
+    const Node* x = node_at(uint32_t(start) + 1);
+    for (uint32_t i=0 ; i<count ; ++i, x = x->levels[0].forward)
+    {
+        out.string(x->member.data(), x->member.size());
+        if (with_scores)
+            out.number(x->score);
+    }
+
+    out.end_array();
+}
+
+void JsSortedSet::emit(ValueSink& out) const
+{
+    range(0, -1, true, out);
+}
+
+void JsSortedSet::measure(Footprint& out) const
+{
+    out.bytes += sizeof(*this) + node_bytes(m_head) + m_bytes
+        + m_scores.bucket_count() * sizeof(void*);
+    out.nodes += 1 + m_length;
+}
+
+} // namespace bypass
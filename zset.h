@@ -0,0 +1,103 @@
+#ifndef BYPASS_ZSET_H
+#define BYPASS_ZSET_H
+
+#include <string>
+
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+
+#include "value.h"
+
+namespace bypass {
+
+/// string members ordered by a score, as redis sorted sets
+/// a skiplist keeps the members in (score, member) order with the span of
+/// every link so ranks are found in O(log n), and a hash table maps each
+/// member to its score for O(1) score lookups and to find the node to
+/// remove. emits as a flat [member, score, ...] array in score order
+class JsSortedSet : public JsValue
+{
+    struct Node;
+
+    struct Level
+    {
+        Node* forward;
+
+        // number of nodes the link skips, used to compute ranks
+        uint32_t span;
+    };
+
+    struct Node
+    {
+        std::string member;
+        double score;
+        Node* backward;
+        uint32_t height;
+
+        // height levels are allocated in place
+        Level levels[1];
+    };
+
+    static const uint32_t kMaxHeight = 32;
+
+    typedef boost::unordered_map<std::string, double> ScoreMap;
+
+    Node* m_head;
+    Node* m_tail;
+    uint32_t m_height;
+    uint32_t m_length;
+    ScoreMap m_scores;
+
+    // nodes and score map entries, the buckets are added by measure()
+    size_t m_bytes;
+
+    uint64_t m_seed;
+
+    static Node* create(uint32_t height, double score, const std::string& member);
+    static void destroy(Node* node);
+    static size_t node_bytes(const Node* node);
+    static size_t entry_bytes(const std::string& member);
+
+    uint32_t random_height();
+    void insert(double score, const std::string& member);
+    void remove(double score, const std::string& member);
+
+    /// node at a 1 based rank, 0 past the end
+    const Node* node_at(uint32_t rank) const;
+
+    JsSortedSet& operator=(const JsSortedSet&);
+
+public:
+    virtual Kind kind() const { return KIND_ZSET; }
+
+    JsSortedSet();
+    JsSortedSet(const JsSortedSet& other);
+    ~JsSortedSet();
+
+    uint32_t size() const { return m_length; }
+
+    /// add member or change its score, true if it was not there before
+    bool add(const std::string& member, double score);
+
+    /// true if member was there
+    bool remove(const std::string& member);
+
+    /// false if member is not there
+    bool score(const std::string& member, double& out) const;
+
+    /// 0 based position in score order, false if member is not there
+    bool rank(const std::string& member, uint32_t& out) const;
+
+    /// members from rank start to stop inclusive, negative ranks count
+    /// from the end. with scores each member is followed by its score
+    void range(int64_t start, int64_t stop, bool with_scores, ValueSink& out) const;
+
+    virtual void emit(ValueSink& out) const;
+
+    virtual void measure(Footprint& out) const;
+};
+
+} // namespace bypass
+
+#endif